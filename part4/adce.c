@@ -0,0 +1,220 @@
+/*
+*   Purpose: This file implements aggressive dead code elimination with control dependence (Cytron et al.).
+*   Unconditional branches are never live on their own, so a block is only live when it holds a live
+*   instruction, and only then do the branches it is control dependent on become live. A loop whose body
+*   is all dead thus loses its exit test and with it the whole loop.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#include <stdio.h>
+#include <unordered_set>
+#include <vector>
+#include "adce.h"
+
+bool removeUnreachableBlocks(AnalysisManager& analyses, blockWorklist& dirty) {
+    LLVMValueRef function = analyses.function();
+    const std::vector<LLVMBasicBlockRef>& rpo = analyses.reversePostorder();
+    std::unordered_set<LLVMBasicBlockRef> reachable(rpo.begin(), rpo.end());
+
+    std::vector<LLVMBasicBlockRef> unreachable;
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(function); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        if (!reachable.count(bb)) {
+            unreachable.push_back(bb);
+        }
+    }
+    if (unreachable.empty()) {
+        return false;
+    }
+
+    // The edges into reachable blocks go away with their source
+    for (LLVMBasicBlockRef bb : unreachable) {
+        std::unordered_set<LLVMBasicBlockRef> done;
+        for (LLVMBasicBlockRef successor : analyses.successors().at(bb)) {
+            if (reachable.count(successor) && done.insert(successor).second) {
+                removePhiEntries(successor, bb);
+                dirty.push(successor);
+            }
+        }
+    }
+    // Values of unreachable blocks can only be used in unreachable blocks now
+    for (LLVMBasicBlockRef bb : unreachable) {
+        for (LLVMValueRef instr = LLVMGetFirstInstruction(bb); instr != NULL; instr = LLVMGetNextInstruction(instr)) {
+            if (LLVMGetFirstUse(instr) != NULL) {
+                LLVMReplaceAllUsesWith(instr, LLVMGetUndef(LLVMTypeOf(instr)));
+            }
+        }
+    }
+    for (LLVMBasicBlockRef bb : unreachable) {
+        dirty.remove(bb);
+        LLVMDeleteBasicBlock(bb);
+    }
+
+    printf("Removed %zu unreachable blocks\n", unreachable.size());
+    analyses.invalidate(CHANGED_CFG);
+    return true;
+}
+
+// Function to check if an alloca is never read, so the stores to it are dead
+static bool isWriteOnly(LLVMValueRef address) {
+    if (!LLVMIsAAllocaInst(address)) {
+        return false;
+    }
+    for (LLVMUseRef use = LLVMGetFirstUse(address); use != NULL; use = LLVMGetNextUse(use)) {
+        LLVMValueRef user = LLVMGetUser(use);
+        if (LLVMGetInstructionOpcode(user) != LLVMStore || LLVMGetOperand(user, 1) != address || LLVMGetOperand(user, 0) == address) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Function to check if a conditional branch has to stay whatever the liveness of the blocks it decides on:
+// dropping it could skip a loop that never ends, or there is no single block both of its sides reach
+static bool isAlwaysLiveBranch(AnalysisManager& analyses, LLVMBasicBlockRef bb) {
+    if (!analyses.reachesExit(bb) || analyses.immediatePostDominator(bb) == NULL) {
+        return true;
+    }
+    for (LLVMBasicBlockRef successor : analyses.successors().at(bb)) {
+        if (!analyses.reachesExit(successor)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+unsigned eliminateDeadCode(AnalysisManager& analyses, blockWorklist& dirty) {
+    unsigned changes = removeUnreachableBlocks(analyses, dirty) ? CHANGED_CFG | CHANGED_VALUES : CHANGED_NOTHING;
+    const std::vector<LLVMBasicBlockRef>& rpo = analyses.reversePostorder();
+
+    std::unordered_set<LLVMValueRef> live;
+    std::unordered_set<LLVMBasicBlockRef> liveBlocks;
+    std::vector<LLVMValueRef> worklist;
+    auto markLive = [&](LLVMValueRef instr) {
+        if (live.insert(instr).second) {
+            worklist.push_back(instr);
+        }
+    };
+
+    // Roots
+    for (LLVMBasicBlockRef bb : rpo) {
+        for (LLVMValueRef instr = LLVMGetFirstInstruction(bb); instr != NULL; instr = LLVMGetNextInstruction(instr)) {
+            LLVMOpcode opcode = LLVMGetInstructionOpcode(instr);
+            if (opcode == LLVMBr) {
+                if (LLVMIsConditional(instr) && isAlwaysLiveBranch(analyses, bb)) {
+                    markLive(instr);
+                }
+            } else if (opcode == LLVMStore) {
+                if (!isWriteOnly(LLVMGetOperand(instr, 1))) {
+                    markLive(instr);
+                }
+            } else if (hasSideEffects(instr) || LLVMIsATerminatorInst(instr)) {
+                markLive(instr);
+            }
+        }
+    }
+
+    bool addedBranch = true;
+    while (addedBranch) {
+        // Propagation through operands, phi edges and control dependence
+        while (!worklist.empty()) {
+            LLVMValueRef instr = worklist.back();
+            worklist.pop_back();
+            LLVMBasicBlockRef bb = LLVMGetInstructionParent(instr);
+            if (liveBlocks.insert(bb).second) {
+                for (LLVMBasicBlockRef branch : analyses.controlDependences(bb)) {
+                    markLive(LLVMGetBasicBlockTerminator(branch));
+                }
+            }
+            for (int i = 0; i < LLVMGetNumOperands(instr); i++) {
+                LLVMValueRef operand = LLVMGetOperand(instr, i);
+                if (LLVMIsAInstruction(operand)) {
+                    markLive(operand);
+                }
+            }
+            if (LLVMIsAPHINode(instr)) {
+                // the value depends on the edge taken, so on the branches leading there
+                for (unsigned i = 0; i < LLVMCountIncoming(instr); i++) {
+                    markLive(LLVMGetBasicBlockTerminator(LLVMGetIncomingBlock(instr, i)));
+                }
+            }
+        }
+
+        // A dead branch becomes a jump to its immediate post-dominator, which must not need a phi entry for it
+        addedBranch = false;
+        for (LLVMBasicBlockRef bb : rpo) {
+            LLVMValueRef terminator = LLVMGetBasicBlockTerminator(bb);
+            if (live.count(terminator) || LLVMGetInstructionOpcode(terminator) != LLVMBr || !LLVMIsConditional(terminator)) {
+                continue;
+            }
+            LLVMBasicBlockRef target = analyses.immediatePostDominator(bb);
+            for (LLVMValueRef phi = LLVMGetFirstInstruction(target); phi != NULL && LLVMIsAPHINode(phi); phi = LLVMGetNextInstruction(phi)) {
+                bool hasEntry = false;
+                for (unsigned i = 0; i < LLVMCountIncoming(phi); i++) {
+                    hasEntry = hasEntry || LLVMGetIncomingBlock(phi, i) == bb;
+                }
+                if (live.count(phi) && !hasEntry) {
+                    markLive(terminator);
+                    addedBranch = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    // Sweep the instructions
+    std::vector<LLVMValueRef> dead;
+    for (LLVMBasicBlockRef bb : rpo) {
+        for (LLVMValueRef instr = LLVMGetFirstInstruction(bb); instr != NULL; instr = LLVMGetNextInstruction(instr)) {
+            if (!live.count(instr) && !LLVMIsATerminatorInst(instr)) {
+                dead.push_back(instr);
+            }
+        }
+    }
+    for (LLVMValueRef instr : dead) {
+        if (LLVMGetFirstUse(instr) != NULL) {
+            LLVMReplaceAllUsesWith(instr, LLVMGetUndef(LLVMTypeOf(instr)));     // only dead instructions use it
+        }
+    }
+    for (LLVMValueRef instr : dead) {
+        LLVMOpcode opcode = LLVMGetInstructionOpcode(instr);
+        changes |= (opcode == LLVMStore || opcode == LLVMAlloca) ? CHANGED_MEMORY : CHANGED_VALUES;
+        dirty.push(LLVMGetInstructionParent(instr));
+        LLVMInstructionEraseFromParent(instr);
+    }
+
+    // Sweep the branches
+    LLVMValueRef function = analyses.function();
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(LLVMGetModuleContext(LLVMGetGlobalParent(function)));
+    unsigned deadBranches = 0;
+    for (LLVMBasicBlockRef bb : rpo) {
+        LLVMValueRef terminator = LLVMGetBasicBlockTerminator(bb);
+        if (live.count(terminator) || LLVMGetInstructionOpcode(terminator) != LLVMBr || !LLVMIsConditional(terminator)) {
+            continue;
+        }
+        LLVMBasicBlockRef target = analyses.immediatePostDominator(bb);
+        std::unordered_set<LLVMBasicBlockRef> done;
+        for (unsigned i = 0; i < LLVMGetNumSuccessors(terminator); i++) {
+            LLVMBasicBlockRef successor = LLVMGetSuccessor(terminator, i);
+            if (successor != target && done.insert(successor).second) {
+                removePhiEntries(successor, bb);
+                dirty.push(successor);
+            }
+        }
+        LLVMPositionBuilderBefore(builder, terminator);
+        LLVMBuildBr(builder, target);
+        LLVMInstructionEraseFromParent(terminator);
+        dirty.push(bb);
+        dirty.push(target);
+        deadBranches++;
+    }
+    LLVMDisposeBuilder(builder);
+
+    printf("ADCE: %zu live instructions, removed %zu instructions and %u branches\n", live.size(), dead.size(), deadBranches);
+    if (deadBranches > 0) {
+        changes |= CHANGED_CFG;
+        analyses.invalidate(CHANGED_CFG);
+        removeUnreachableBlocks(analyses, dirty);   // what only the dead branches led to
+    }
+    return changes;
+}
@@ -0,0 +1,33 @@
+/*
+*   Purpose: This is the .h file for aggressive dead code elimination. Instead of deleting what has no uses,
+*   it assumes everything is dead and marks live only what a side effect needs, through operands and through
+*   the branches deciding whether a live instruction runs. Dead chains, dead cycles of phis and whole loops
+*   that compute nothing go in one run. The blocks no path from the entry reaches, like the after_ret blocks
+*   the llvm builder puts after every return, are deleted as well.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#ifndef ADCE_H
+#define ADCE_H
+
+#include <llvm-c/Core.h>
+#include "llvm_parser.h"
+
+// Function to delete the blocks that cannot be reached from the entry, and their entries in the phis of
+// the blocks that can. Returns true if a block was deleted; the manager has been told already.
+bool removeUnreachableBlocks(AnalysisManager& analyses, blockWorklist& dirty);
+
+/**
+ *
+ * Mark and sweep over the function the manager is for. Returns, calls, stores to memory that is read
+ * somewhere, and the branches of blocks that may never reach a return are live; an instruction is live
+ * when a live instruction uses it, and a conditional branch is live when a live block is control dependent
+ * on it. Dead conditional branches become a jump to their immediate post-dominator, and the blocks that
+ * leaves unreachable are deleted.
+ *
+ * returns: the irChange kinds made
+ */
+unsigned eliminateDeadCode(AnalysisManager& analyses, blockWorklist& dirty);
+
+#endif // ADCE_H
@@ -0,0 +1,373 @@
+/*
+*   Purpose: This file implements the analysis manager of the optimizer. Every analysis is computed on first
+*   use and cached; invalidate() drops only what the reported change can affect, so a round of local
+*   optimizations that never touches a store or a branch keeps the reaching definitions and the CFG.
+*   Dominators use the iterative algorithm of Cooper, Harvey and Kennedy over the reverse postorder;
+*   post-dominators are the same algorithm on the reversed CFG.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#include <stdio.h>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "analysis_manager.h"
+#include "llvm_parser.h"
+
+AnalysisManager::AnalysisManager(LLVMValueRef function) : func(function) {}
+
+// Function to find successors, predecessors and the reverse postorder in one go
+void AnalysisManager::computeCFG() {
+    preds = buildPredMap(func);
+    succs.clear();
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(func); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        std::vector<LLVMBasicBlockRef>& out = succs[bb];
+        LLVMValueRef terminator = LLVMGetBasicBlockTerminator(bb);
+        unsigned numSuccessors = terminator ? LLVMGetNumSuccessors(terminator) : 0;
+        for (unsigned i = 0; i < numSuccessors; i++) {
+            out.push_back(LLVMGetSuccessor(terminator, i));
+        }
+    }
+    rpo = ::reversePostorder(func);
+    cfg_valid = true;
+    cfg_runs++;
+}
+
+const predMap& AnalysisManager::predecessors() {
+    if (!cfg_valid) {
+        computeCFG();
+    }
+    return preds;
+}
+
+const succMap& AnalysisManager::successors() {
+    if (!cfg_valid) {
+        computeCFG();
+    }
+    return succs;
+}
+
+const std::vector<LLVMBasicBlockRef>& AnalysisManager::reversePostorder() {
+    if (!cfg_valid) {
+        computeCFG();
+    }
+    return rpo;
+}
+
+// Function to build the dominator tree of the reachable blocks
+void AnalysisManager::computeDominators() {
+    const std::vector<LLVMBasicBlockRef>& order = reversePostorder();
+    idom.clear();
+    dom_children.clear();
+    dom_range.clear();
+    dom_frontier.clear();
+    if (order.empty()) {
+        dom_valid = true;
+        dom_runs++;
+        return;
+    }
+
+    std::unordered_map<LLVMBasicBlockRef, uint32_t> position;
+    for (uint32_t i = 0; i < order.size(); i++) {
+        position[order[i]] = i;
+    }
+
+    // doms[i] is the immediate dominator of order[i] as a position, -1 while unknown
+    std::vector<int32_t> doms(order.size(), -1);
+    doms[0] = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (uint32_t i = 1; i < order.size(); i++) {
+            int32_t newIdom = -1;
+            for (LLVMBasicBlockRef pred : preds.at(order[i])) {
+                auto p = position.find(pred);
+                if (p == position.end() || doms[p->second] == -1) {
+                    continue;   // unreachable, or not processed yet
+                }
+                if (newIdom == -1) {
+                    newIdom = (int32_t)p->second;
+                    continue;
+                }
+                // walk both fingers up the tree until they meet
+                int32_t a = (int32_t)p->second;
+                int32_t b = newIdom;
+                while (a != b) {
+                    while (a > b) {
+                        a = doms[a];
+                    }
+                    while (b > a) {
+                        b = doms[b];
+                    }
+                }
+                newIdom = a;
+            }
+            if (doms[i] != newIdom) {
+                doms[i] = newIdom;
+                changed = true;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < order.size(); i++) {
+        idom[order[i]] = order[doms[i]];
+        dom_children[order[i]];
+        if (i != 0) {
+            dom_children[order[doms[i]]].push_back(order[i]);
+        }
+    }
+
+    // Number the tree in preorder so a dominance query is two compares
+    uint32_t counter = 0;
+    std::vector<std::pair<LLVMBasicBlockRef, size_t>> stack;
+    stack.push_back({order[0], 0});
+    dom_range[order[0]].first = counter++;
+    while (!stack.empty()) {
+        LLVMBasicBlockRef bb = stack.back().first;
+        const std::vector<LLVMBasicBlockRef>& children = dom_children[bb];
+        if (stack.back().second < children.size()) {
+            LLVMBasicBlockRef child = children[stack.back().second++];
+            dom_range[child].first = counter++;
+            stack.push_back({child, 0});
+        } else {
+            dom_range[bb].second = counter;
+            stack.pop_back();
+        }
+    }
+
+    // Frontiers: walk up from each predecessor of a join block until its immediate dominator
+    for (uint32_t i = 1; i < order.size(); i++) {
+        LLVMBasicBlockRef join = order[i];
+        if (preds.at(join).size() < 2) {
+            continue;
+        }
+        for (LLVMBasicBlockRef pred : preds.at(join)) {
+            if (position.find(pred) == position.end()) {
+                continue;   // unreachable
+            }
+            LLVMBasicBlockRef runner = pred;
+            while (runner != idom[join]) {
+                std::vector<LLVMBasicBlockRef>& frontier = dom_frontier[runner];
+                if (frontier.empty() || frontier.back() != join) {
+                    frontier.push_back(join);
+                }
+                runner = idom[runner];
+            }
+        }
+    }
+
+    dom_valid = true;
+    dom_runs++;
+}
+
+LLVMBasicBlockRef AnalysisManager::immediateDominator(LLVMBasicBlockRef bb) {
+    if (!dom_valid) {
+        computeDominators();
+    }
+    auto it = idom.find(bb);
+    if (it == idom.end() || it->second == bb) {
+        return NULL;    // the entry, or unreachable
+    }
+    return it->second;
+}
+
+const std::vector<LLVMBasicBlockRef>& AnalysisManager::dominatorChildren(LLVMBasicBlockRef bb) {
+    static const std::vector<LLVMBasicBlockRef> none;
+    if (!dom_valid) {
+        computeDominators();
+    }
+    auto it = dom_children.find(bb);
+    return it == dom_children.end() ? none : it->second;
+}
+
+bool AnalysisManager::dominates(LLVMBasicBlockRef a, LLVMBasicBlockRef b) {
+    if (!dom_valid) {
+        computeDominators();
+    }
+    auto ra = dom_range.find(a);
+    auto rb = dom_range.find(b);
+    if (ra == dom_range.end() || rb == dom_range.end()) {
+        return false;
+    }
+    return ra->second.first <= rb->second.first && rb->second.first < ra->second.second;
+}
+
+const std::vector<LLVMBasicBlockRef>& AnalysisManager::dominanceFrontier(LLVMBasicBlockRef bb) {
+    static const std::vector<LLVMBasicBlockRef> none;
+    if (!dom_valid) {
+        computeDominators();
+    }
+    auto it = dom_frontier.find(bb);
+    return it == dom_frontier.end() ? none : it->second;
+}
+
+// Function to build the post-dominator tree and the control dependences of the blocks that reach an exit.
+// The reversed CFG gets a virtual exit, written NULL, with an edge to every block without successors.
+void AnalysisManager::computePostDominators() {
+    const std::vector<LLVMBasicBlockRef>& forward = reversePostorder();
+    ipdom.clear();
+    control_deps.clear();
+
+    // Reverse postorder of the reversed CFG, from the virtual exit along predecessor edges
+    std::vector<LLVMBasicBlockRef> order;
+    std::unordered_map<LLVMBasicBlockRef, uint32_t> position;
+    std::unordered_set<LLVMBasicBlockRef> reachable(forward.begin(), forward.end());
+    std::unordered_set<LLVMBasicBlockRef> visited;
+    std::vector<std::pair<LLVMBasicBlockRef, size_t>> stack;
+    for (LLVMBasicBlockRef bb : forward) {
+        if (succs.at(bb).empty() && visited.insert(bb).second) {
+            stack.push_back({bb, 0});
+            while (!stack.empty()) {
+                const std::vector<LLVMBasicBlockRef>& next = preds.at(stack.back().first);
+                if (stack.back().second < next.size()) {
+                    LLVMBasicBlockRef pred = next[stack.back().second++];
+                    if (reachable.count(pred) && visited.insert(pred).second) {
+                        stack.push_back({pred, 0});
+                    }
+                } else {
+                    order.push_back(stack.back().first);
+                    stack.pop_back();
+                }
+            }
+        }
+    }
+    order.push_back(NULL);
+    std::reverse(order.begin(), order.end());
+    for (uint32_t i = 0; i < order.size(); i++) {
+        position[order[i]] = i;
+    }
+
+    // successors are the predecessors in the reversed CFG
+    auto reversedPreds = [&](LLVMBasicBlockRef bb) -> std::vector<LLVMBasicBlockRef> {
+        const std::vector<LLVMBasicBlockRef>& out = succs.at(bb);
+        return out.empty() ? std::vector<LLVMBasicBlockRef>{NULL} : out;
+    };
+
+    std::vector<int32_t> doms(order.size(), -1);
+    doms[0] = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (uint32_t i = 1; i < order.size(); i++) {
+            int32_t newIdom = -1;
+            for (LLVMBasicBlockRef succ : reversedPreds(order[i])) {
+                auto p = position.find(succ);
+                if (p == position.end() || doms[p->second] == -1) {
+                    continue;   // cannot reach an exit, or not processed yet
+                }
+                if (newIdom == -1) {
+                    newIdom = (int32_t)p->second;
+                    continue;
+                }
+                int32_t a = (int32_t)p->second;
+                int32_t b = newIdom;
+                while (a != b) {
+                    while (a > b) {
+                        a = doms[a];
+                    }
+                    while (b > a) {
+                        b = doms[b];
+                    }
+                }
+                newIdom = a;
+            }
+            if (doms[i] != newIdom) {
+                doms[i] = newIdom;
+                changed = true;
+            }
+        }
+    }
+    for (uint32_t i = 1; i < order.size(); i++) {
+        ipdom[order[i]] = order[doms[i]];
+    }
+
+    // Control dependences: walk up the tree from each successor of a branch until its immediate post-dominator
+    for (uint32_t i = 1; i < order.size(); i++) {
+        LLVMBasicBlockRef branch = order[i];
+        if (succs.at(branch).size() < 2) {
+            continue;
+        }
+        for (LLVMBasicBlockRef succ : succs.at(branch)) {
+            if (position.find(succ) == position.end()) {
+                continue;
+            }
+            LLVMBasicBlockRef runner = succ;
+            while (runner != NULL && runner != ipdom[branch]) {
+                std::vector<LLVMBasicBlockRef>& deps = control_deps[runner];
+                if (deps.empty() || deps.back() != branch) {
+                    deps.push_back(branch);
+                }
+                runner = ipdom[runner];
+            }
+        }
+    }
+
+    pdom_valid = true;
+    pdom_runs++;
+}
+
+bool AnalysisManager::reachesExit(LLVMBasicBlockRef bb) {
+    if (!pdom_valid) {
+        computePostDominators();
+    }
+    return ipdom.find(bb) != ipdom.end();
+}
+
+LLVMBasicBlockRef AnalysisManager::immediatePostDominator(LLVMBasicBlockRef bb) {
+    if (!pdom_valid) {
+        computePostDominators();
+    }
+    auto it = ipdom.find(bb);
+    return it == ipdom.end() ? NULL : it->second;
+}
+
+const std::vector<LLVMBasicBlockRef>& AnalysisManager::controlDependences(LLVMBasicBlockRef bb) {
+    static const std::vector<LLVMBasicBlockRef> none;
+    if (!pdom_valid) {
+        computePostDominators();
+    }
+    auto it = control_deps.find(bb);
+    return it == control_deps.end() ? none : it->second;
+}
+
+const std::vector<naturalLoop>& AnalysisManager::loops() {
+    if (!loops_valid) {
+        loop_list = findLoops(*this);
+        loops_valid = true;
+        loop_runs++;
+    }
+    return loop_list;
+}
+
+const reachingDefs& AnalysisManager::reachingDefinitions() {
+    if (!reaching_valid) {
+        reaching.numbering = numberStores(func);
+        reaching.gen = getGenMap(func, reaching.numbering);
+        reaching.kill = getKillMap(func, reaching.numbering, reaching.gen);
+        reaching.in = getInMap(func, reaching.gen, reaching.kill, predecessors(), reversePostorder());
+        reaching_valid = true;
+        reaching_runs++;
+    }
+    return reaching;
+}
+
+void AnalysisManager::invalidate(unsigned changes) {
+    if (changes & CHANGED_CFG) {
+        cfg_valid = false;
+        dom_valid = false;
+        pdom_valid = false;
+        loops_valid = false;
+        reaching_valid = false;     // GEN, KILL and IN are kept per block
+    }
+    if (changes & CHANGED_MEMORY) {
+        reaching_valid = false;
+    }
+    // CHANGED_VALUES leaves every cached analysis valid
+}
+
+void AnalysisManager::printStatistics() const {
+    printf("Analyses computed: CFG %u, dominators %u, post-dominators %u, loops %u, reaching definitions %u\n",
+           cfg_runs, dom_runs, pdom_runs, loop_runs, reaching_runs);
+}
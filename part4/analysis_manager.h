@@ -0,0 +1,120 @@
+/*
+*   Purpose: This is the .h file for the analysis manager of the optimizer. It computes the analyses of one
+*   function (successors and predecessors, reverse postorder, dominators, post-dominators, loops, reaching
+*   definitions) the first time a pass asks for them and keeps them until a pass reports a change that makes
+*   them stale.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#ifndef ANALYSIS_MANAGER_H
+#define ANALYSIS_MANAGER_H
+
+#include <llvm-c/Core.h>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "dataflow.h"
+#include "loops.h"
+
+using succMap = std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMBasicBlockRef>>;
+
+// What a pass changed. Passes return these or'ed together; 0 means the function is untouched.
+enum irChange : unsigned {
+    CHANGED_NOTHING = 0,
+    CHANGED_VALUES = 1,     // instructions without memory effects were replaced or erased (this includes loads)
+    CHANGED_MEMORY = 2,     // stores or allocas were added, erased or rewritten
+    CHANGED_CFG = 4         // blocks, branches or edges were added or erased
+};
+
+// Dense numbering of the store instructions of one function, with the stores grouped by address
+struct storeNumbering {
+    std::vector<LLVMValueRef> stores;                           // store number -> instruction
+    std::unordered_map<LLVMValueRef, uint32_t> ids;             // instruction -> store number
+    std::unordered_map<LLVMValueRef, uint32_t> address_ids;     // address -> address number
+    std::vector<uint32_t> address_of;                           // store number -> address number
+    std::vector<std::vector<uint32_t>> address_stores;          // address number -> its store numbers
+};
+
+// Reaching definitions of the stores of a function
+typedef struct {
+    storeNumbering numbering;
+    bbBits gen;
+    bbBits kill;
+    bbBits in;      // stores that may reach the top of each block
+} reachingDefs;
+
+class AnalysisManager {
+public:
+    explicit AnalysisManager(LLVMValueRef function);
+
+    LLVMValueRef function() const { return func; }
+
+    // Control flow graph
+    const predMap& predecessors();
+    const succMap& successors();
+    const std::vector<LLVMBasicBlockRef>& reversePostorder();
+
+    // Dominator tree. Blocks that cannot be reached from the entry are in neither direction.
+    LLVMBasicBlockRef immediateDominator(LLVMBasicBlockRef bb);
+    const std::vector<LLVMBasicBlockRef>& dominatorChildren(LLVMBasicBlockRef bb);
+    bool dominates(LLVMBasicBlockRef a, LLVMBasicBlockRef b);
+
+    // Blocks where the dominance of bb ends: bb dominates one of their predecessors but not them
+    const std::vector<LLVMBasicBlockRef>& dominanceFrontier(LLVMBasicBlockRef bb);
+
+    // Post-dominator tree, rooted at a virtual exit every returning block branches to. Blocks that cannot
+    // reach a return (or are unreachable) are not in it.
+    bool reachesExit(LLVMBasicBlockRef bb);
+    LLVMBasicBlockRef immediatePostDominator(LLVMBasicBlockRef bb);     // NULL for the virtual exit
+
+    // Blocks whose branch decides whether bb runs: the post-dominance frontier of bb
+    const std::vector<LLVMBasicBlockRef>& controlDependences(LLVMBasicBlockRef bb);
+
+    // Natural loops, innermost first
+    const std::vector<naturalLoop>& loops();
+
+    const reachingDefs& reachingDefinitions();
+
+    // Drops every result that a change of kind changes (an or of irChange values) can make stale
+    void invalidate(unsigned changes);
+
+    // Prints how often each analysis had to be computed
+    void printStatistics() const;
+
+private:
+    void computeCFG();
+    void computeDominators();
+    void computePostDominators();
+
+    LLVMValueRef func;
+
+    bool cfg_valid = false;
+    predMap preds;
+    succMap succs;
+    std::vector<LLVMBasicBlockRef> rpo;
+
+    bool dom_valid = false;
+    std::unordered_map<LLVMBasicBlockRef, LLVMBasicBlockRef> idom;      // the entry maps to itself
+    std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMBasicBlockRef>> dom_children;
+    std::unordered_map<LLVMBasicBlockRef, std::pair<uint32_t, uint32_t>> dom_range;     // preorder entry and exit numbers
+    std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMBasicBlockRef>> dom_frontier;
+
+    bool pdom_valid = false;
+    std::unordered_map<LLVMBasicBlockRef, LLVMBasicBlockRef> ipdom;     // NULL stands for the virtual exit
+    std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMBasicBlockRef>> control_deps;
+
+    bool loops_valid = false;
+    std::vector<naturalLoop> loop_list;
+
+    bool reaching_valid = false;
+    reachingDefs reaching;
+
+    unsigned cfg_runs = 0;
+    unsigned dom_runs = 0;
+    unsigned pdom_runs = 0;
+    unsigned loop_runs = 0;
+    unsigned reaching_runs = 0;
+};
+
+#endif // ANALYSIS_MANAGER_H
@@ -0,0 +1,72 @@
+/*
+*   Purpose: This file implements the bump-pointer arena used to allocate the AST. Chunks grow
+*   geometrically, so releasing a tree of any size only walks a handful of chunks.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ARENA_FIRST_CHUNK 65536
+#define ARENA_MAX_CHUNK (16 * 1024 * 1024)
+#define ARENA_ALIGN alignof(max_align_t)
+
+struct arenaChunk {
+    arenaChunk* next;
+    size_t size;
+};
+
+// Chunk headers are padded so the first allocation is aligned
+static const size_t chunkHeader = (sizeof(arenaChunk) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+void arenaInit(arena* a) {
+    a->chunks = NULL;
+    a->pos = NULL;
+    a->left = 0;
+    a->nextSize = ARENA_FIRST_CHUNK;
+}
+
+// Starts a new chunk big enough for at least size bytes
+static void arenaGrow(arena* a, size_t size) {
+    size_t chunkSize = a->nextSize;
+    while (chunkSize - chunkHeader < size) {
+        chunkSize *= 2;
+    }
+    arenaChunk* chunk = (arenaChunk*)calloc(1, chunkSize);
+    if (chunk == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    chunk->next = a->chunks;
+    chunk->size = chunkSize;
+    a->chunks = chunk;
+    a->pos = (char*)chunk + chunkHeader;
+    a->left = chunkSize - chunkHeader;
+    if (a->nextSize < ARENA_MAX_CHUNK) {
+        a->nextSize *= 2;
+    }
+}
+
+void* arenaAlloc(arena* a, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    if (size > a->left) {
+        arenaGrow(a, size);
+    }
+    // Chunks come from calloc, so the memory is already zeroed
+    void* ptr = a->pos;
+    a->pos += size;
+    a->left -= size;
+    return ptr;
+}
+
+void arenaRelease(arena* a) {
+    arenaChunk* chunk = a->chunks;
+    while (chunk != NULL) {
+        arenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arenaInit(a);
+}
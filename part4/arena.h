@@ -0,0 +1,31 @@
+/*
+*   Purpose: This is the .h file for a simple bump-pointer arena. Memory is handed out from large
+*   chunks and only given back all at once when the arena is released.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+
+struct arenaChunk;
+
+typedef struct {
+    arenaChunk* chunks;  // most recent chunk first
+    char* pos;           // next free byte in the current chunk
+    size_t left;         // bytes left in the current chunk
+    size_t nextSize;     // size of the next chunk to allocate
+} arena;
+
+// Sets up an empty arena; no memory is allocated until the first arenaAlloc
+void arenaInit(arena* a);
+
+// Returns size zeroed bytes aligned for any type. Never returns NULL (exits on allocation failure).
+void* arenaAlloc(arena* a, size_t size);
+
+// Frees every chunk at once. The arena can be reused afterwards.
+void arenaRelease(arena* a);
+
+#endif // ARENA_H
@@ -1,157 +1,444 @@
 /*
-*   Purpose:  This file generates the assembly code from our optimized LLVM code after part 3. It makes use of four helper functions: 
+*   Purpose:  This file generates the assembly code from our optimized LLVM code after part 3. It makes use of four helper functions:
 *   createBBLabels, printDirectives, printFunctionEnd, getOffsetMap. It uses algorithms as described on Canvas.
+*   Values live where the register allocator put them: instructions use register operands, and only values
+*   spilled in a block are read from and written to their stack slot there. Phis and the places where a value
+*   changes location between two blocks become moves on the CFG edge.
+*   The code is x86-64 for the System V ABI: the argument comes in %rdi, the result goes out in %rax, and
+*   the stack is 16-byte aligned at every call. An i64 value uses a whole register, i32 and i1 the low half.
 *   Author: Carly Retterer
 *   Date: 30 May 2024
 */
 
-#include <iostream>
-#include <vector>
-#include <map>
-#include <cstdarg>
-#include <llvm-c/Core.h>
-#include <llvm-c/Analysis.h>
-#include <llvm-c/BitWriter.h>
-#include <llvm-c/Transforms/PassManagerBuilder.h>
-
-// Function declarations
-void createBBLabels(LLVMModuleRef module, std::map<LLVMBasicBlockRef, std::string>& bb_labels);
-void printDirectives(LLVMValueRef function);
-void printFunctionEnd();
-void getOffsetMap(LLVMModuleRef module, LLVMValueRef function, int& localMem, std::map<LLVMValueRef, int>& offset_map);
-void emit(const char *format, ...);
-
-void generateAssembly(LLVMModuleRef module) {
+#include <stdio.h>
+#include "assembly_code_gen.h"
+
+// Registers the allocator hands out, by number, as 64 and 32-bit names; %rax is kept free as the scratch register
+static const char* register_names[NUM_REGISTERS][2] = {
+    {"%rcx", "%ecx"}, {"%rdx", "%edx"}, {"%rsi", "%esi"}, {"%rdi", "%edi"}, {"%r8", "%r8d"}, {"%r9", "%r9d"},
+    {"%r10", "%r10d"}, {"%r11", "%r11d"}, {"%rbx", "%ebx"}, {"%r12", "%r12d"}, {"%r13", "%r13d"}, {"%r14", "%r14d"},
+    {"%r15", "%r15d"}};
+
+// Registers the arguments of a call go in
+static const char* argument_registers[6] = {"%rdi", "%rsi", "%rdx", "%rcx", "%r8", "%r9"};
+
+// What generating the code of one function needs to know
+struct functionCode {
+    const functionAllocation& allocation;
+    std::map<LLVMBasicBlockRef, std::string>& bb_labels;
+    std::map<LLVMValueRef, int> offset_map;
+    std::vector<std::pair<std::string, std::pair<LLVMBasicBlockRef, LLVMBasicBlockRef>>> stubs;    // label and edge
+    std::vector<int> saved;     // callee-saved registers the function uses
+    int labels = 0;
+};
+
+// Function to give the instruction suffix for a value: q for an i64, l for everything narrower
+static char suffixOf(LLVMValueRef value) {
+    LLVMTypeRef type = LLVMTypeOf(value);
+    return LLVMGetTypeKind(type) == LLVMIntegerTypeKind && LLVMGetIntTypeWidth(type) == 64 ? 'q' : 'l';
+}
+
+static std::string scratch(char suffix) {
+    return suffix == 'q' ? "%rax" : "%eax";
+}
+
+// Function to give the operand for value as used in bb: an immediate, its register or its stack slot.
+// A value kept nowhere (its result is never read) goes to the scratch register.
+static std::string operandOf(functionCode& code, LLVMValueRef value, LLVMBasicBlockRef bb, char suffix) {
+    if (LLVMIsUndef(value)) {
+        return "$0";
+    }
+    if (LLVMIsAConstantInt(value)) {
+        long long constant = LLVMGetIntTypeWidth(LLVMTypeOf(value)) == 1 ? (long long)LLVMConstIntGetZExtValue(value)
+                                                                          : LLVMConstIntGetSExtValue(value);
+        return "$" + std::to_string(constant);
+    }
+    std::map<LLVMValueRef, std::map<LLVMBasicBlockRef, int>>::const_iterator it = code.allocation.location.find(value);
+    if (it == code.allocation.location.end() || it->second.count(bb) == 0) {
+        return scratch(suffix);
+    }
+    int reg = it->second.at(bb);
+    if (reg != SPILLED) {
+        return register_names[reg][suffix == 'q' ? 0 : 1];
+    }
+    return std::to_string(code.offset_map[value]) + "(%rbp)";
+}
+
+// Same, in the width of the value
+static std::string operandOf(functionCode& code, LLVMValueRef value, LLVMBasicBlockRef bb) {
+    return operandOf(code, value, bb, suffixOf(value));
+}
+
+static bool isImmediate(const std::string& operand) {
+    return operand[0] == '$';
+}
+
+static bool isMemory(const std::string& operand) {
+    return operand.find('(') != std::string::npos;
+}
+
+// Function to emit a move; memory to memory goes through the stack so no register is needed
+static void emitMove(FILE* out, const std::string& src, const std::string& dst, char suffix) {
+    if (src == dst) {
+        return;
+    }
+    if (isMemory(src) && isMemory(dst)) {
+        emit(out, "pushq %s", src.c_str());
+        emit(out, "popq %s", dst.c_str());
+    } else {
+        emit(out, "mov%c %s, %s", suffix, src.c_str(), dst.c_str());
+    }
+}
+
+// Function to emit moves that all happen at once, as the phis of a block do. A move waits until no other
+// move reads its destination; when only cycles are left, one destination is saved to %rax first. The
+// moves copy whole registers and slots, so the operands must be the 64-bit ones.
+static void emitParallelMoves(FILE* out, std::vector<std::pair<std::string, std::string>> moves) {
+    while (!moves.empty()) {
+        bool emitted = false;
+        for (size_t i = 0; i < moves.size() && !emitted; i++) {
+            bool read = false;
+            for (size_t j = 0; j < moves.size(); j++) {
+                read = read || (j != i && moves[j].second == moves[i].first);
+            }
+            if (!read) {
+                emitMove(out, moves[i].second, moves[i].first, 'q');
+                moves.erase(moves.begin() + i);
+                emitted = true;
+            }
+        }
+        if (!emitted) {
+            std::string saved = moves[0].first;
+            emitMove(out, saved, "%rax", 'q');
+            for (std::pair<std::string, std::string>& move : moves) {
+                if (move.second == saved) {
+                    move.second = "%rax";
+                }
+            }
+        }
+    }
+}
+
+// Function to collect the moves the edge from -> to needs: the phis of to, and the values live into to
+// that the allocator put somewhere else in the two blocks
+static std::vector<std::pair<std::string, std::string>> edgeMoves(functionCode& code, LLVMBasicBlockRef from, LLVMBasicBlockRef to) {
+    std::vector<std::pair<std::string, std::string>> moves;
+    for (LLVMValueRef phi = LLVMGetFirstInstruction(to); phi && LLVMIsAPHINode(phi); phi = LLVMGetNextInstruction(phi)) {
+        for (unsigned i = 0; i < LLVMCountIncoming(phi); i++) {
+            if (LLVMGetIncomingBlock(phi, i) == from && !LLVMIsUndef(LLVMGetIncomingValue(phi, i))) {
+                moves.push_back({operandOf(code, phi, to, 'q'), operandOf(code, LLVMGetIncomingValue(phi, i), from, 'q')});
+                break;
+            }
+        }
+    }
+    for (const auto& value : code.allocation.location) {
+        // a value is live into a block it has a location in unless the block defines it
+        if (value.second.count(to) == 0 || (LLVMIsAInstruction(value.first) && LLVMGetInstructionParent(value.first) == to)) {
+            continue;
+        }
+        moves.push_back({operandOf(code, value.first, to, 'q'), operandOf(code, value.first, from, 'q')});
+    }
+    for (size_t i = 0; i < moves.size();) {
+        if (moves[i].first == moves[i].second) {
+            moves.erase(moves.begin() + i);
+        } else {
+            i++;
+        }
+    }
+    return moves;
+}
+
+// Function to give the condition code an icmp predicate is true for
+static const char* conditionCode(LLVMIntPredicate predicate) {
+    switch (predicate) {
+        case LLVMIntEQ: return "e";
+        case LLVMIntNE: return "ne";
+        case LLVMIntSGT: return "g";
+        case LLVMIntSGE: return "ge";
+        case LLVMIntSLT: return "l";
+        case LLVMIntSLE: return "le";
+        case LLVMIntUGT: return "a";
+        case LLVMIntUGE: return "ae";
+        case LLVMIntULT: return "b";
+        default: return "be";
+    }
+}
+
+// Function to emit cmp b, a; a cannot be an immediate and at most one side can be in memory
+static void emitCompare(FILE* out, const std::string& a, const std::string& b, char suffix) {
+    if (isImmediate(a) || (isMemory(a) && isMemory(b))) {
+        emitMove(out, a, scratch(suffix), suffix);
+        emit(out, "cmp%c %s, %s", suffix, b.c_str(), scratch(suffix).c_str());
+    } else {
+        emit(out, "cmp%c %s, %s", suffix, b.c_str(), a.c_str());
+    }
+}
+
+// Function to tell if an icmp only decides the branch right after it, so the flags can be used directly
+static bool isFusedCompare(LLVMValueRef instr) {
+    LLVMValueRef next = LLVMGetNextInstruction(instr);
+    return LLVMGetInstructionOpcode(instr) == LLVMICmp && next && LLVMGetInstructionOpcode(next) == LLVMBr &&
+           LLVMIsConditional(next) && LLVMGetCondition(next) == instr && LLVMGetFirstUse(instr) &&
+           LLVMGetNextUse(LLVMGetFirstUse(instr)) == NULL;
+}
+
+// Function to emit dst = a op b
+static void emitBinary(FILE* out, const char* op, char suffix, bool commutative, const std::string& a, const std::string& b, const std::string& dst) {
+    std::string temp = scratch(suffix);
+    if (!isMemory(dst) && dst != temp && dst != b) {
+        emitMove(out, a, dst, suffix);
+        emit(out, "%s%c %s, %s", op, suffix, b.c_str(), dst.c_str());
+    } else if (!isMemory(dst) && dst != temp && commutative) {
+        emit(out, "%s%c %s, %s", op, suffix, a.c_str(), dst.c_str());
+    } else {
+        // the destination is in memory or is the register b is read from
+        emitMove(out, a, temp, suffix);
+        emit(out, "%s%c %s, %s", op, suffix, b.c_str(), temp.c_str());
+        emitMove(out, temp, dst, suffix);
+    }
+}
+
+// Function to emit a signed division; idiv divides %rdx:%rax, so %rdx is saved around it
+static void emitDivision(FILE* out, bool remainder, char suffix, const std::string& a, const std::string& b, const std::string& dst) {
+    std::string temp = scratch(suffix);
+    emit(out, "pushq %%rdx");
+    std::string divisor = b;
+    if (isImmediate(b)) {
+        emit(out, "pushq %s", b.c_str());
+        divisor = "(%rsp)";
+    } else if (b == "%rdx" || b == "%edx") {
+        divisor = "(%rsp)";
+    }
+    emitMove(out, a, temp, suffix);
+    emit(out, suffix == 'q' ? "cqto" : "cltd");
+    emit(out, "idiv%c %s", suffix, divisor.c_str());
+    if (isImmediate(b)) {
+        emit(out, "addq $8, %%rsp");
+    }
+    if (remainder) {
+        emitMove(out, suffix == 'q' ? "%rdx" : "%edx", temp, suffix);
+    }
+    emit(out, "popq %%rdx");
+    emitMove(out, temp, dst, suffix);
+}
+
+// Function to emit the branch ending bb. Moves for an edge go right before the jump, or to a stub at the
+// end of the function when the jump is conditional.
+static void emitBranch(FILE* out, functionCode& code, LLVMValueRef Instr, LLVMBasicBlockRef BB, LLVMBasicBlockRef next) {
+    LLVMBasicBlockRef target = LLVMGetSuccessor(Instr, 0);
+    if (LLVMIsConditional(Instr)) {
+        LLVMValueRef cond = LLVMGetCondition(Instr);
+        LLVMBasicBlockRef other = LLVMGetSuccessor(Instr, 1);
+        if (LLVMIsAConstantInt(cond)) {
+            target = LLVMConstIntGetZExtValue(cond) ? target : other;
+        } else {
+            const char* cc = "ne";
+            if (LLVMIsAInstruction(cond) && isFusedCompare(cond)) {
+                LLVMValueRef a = LLVMGetOperand(cond, 0);
+                emitCompare(out, operandOf(code, a, BB), operandOf(code, LLVMGetOperand(cond, 1), BB), suffixOf(a));
+                cc = conditionCode(LLVMGetICmpPredicate(cond));
+            } else {
+                emitCompare(out, operandOf(code, cond, BB), "$0", 'l');
+            }
+            std::string label = code.bb_labels[target];
+            if (!edgeMoves(code, BB, target).empty()) {
+                label = code.bb_labels[BB] + "_" + std::to_string(code.labels++);
+                code.stubs.push_back({label, {BB, target}});
+            }
+            emit(out, "j%s %s", cc, label.c_str());
+            target = other;
+        }
+    }
+    emitParallelMoves(out, edgeMoves(code, BB, target));
+    if (target != next) {
+        emit(out, "jmp %s", code.bb_labels[target].c_str());
+    }
+}
+
+void generateAssembly(LLVMModuleRef module, const moduleAllocation& allocations, FILE* out) {
+    std::map<LLVMBasicBlockRef, std::string> bb_labels;
+    createBBLabels(module, bb_labels);
+
     // Iterate through each function in the module
     for (LLVMValueRef function = LLVMGetFirstFunction(module); function; function = LLVMGetNextFunction(function)) {
+        if (LLVMCountBasicBlocks(function) == 0) {
+            continue;   // print and read come from the runtime
+        }
         // Initialize local variables
-        std::map<LLVMBasicBlockRef, std::string> bb_labels;
-        int localMem = 4;
-        std::map<LLVMValueRef, int> offset_map;
-        
+        functionCode code = {allocations.at(function), bb_labels};
+        int localMem = 0;
+
         // Call helper functions
-        createBBLabels(module, bb_labels);
-        printDirectives(function);
-        getOffsetMap(module, function, localMem, offset_map);
-        
+        printDirectives(out, function);
+        getOffsetMap(function, code.allocation, localMem, code.offset_map);
+
+        // The callee-saved registers the allocation uses are saved below the slots
+        for (int reg = FIRST_CALLEE_SAVED; reg < NUM_REGISTERS; reg++) {
+            for (const auto& value : code.allocation.location) {
+                bool used = false;
+                for (const auto& block : value.second) {
+                    used = used || block.second == reg;
+                }
+                if (used) {
+                    code.saved.push_back(reg);
+                    break;
+                }
+            }
+        }
+        // %rsp is 16-byte aligned after pushing %rbp, and has to be again after the frame and the saves
+        int savedBytes = 8 * code.saved.size();
+        localMem = (localMem + savedBytes + 15) / 16 * 16 - savedBytes;
+
         // Emit function prologue
-        emit("pushl %%ebp");
-        emit("movl %%esp, %%ebp");
-        emit("subl $%d, %%esp", localMem);
-        emit("pushl %%ebx");
-        
-        // Iterate through each basic block
-        for (LLVMBasicBlockRef BB = LLVMGetFirstBasicBlock(function); BB; BB = LLVMGetNextBasicBlock(BB)) {
+        emit(out, "pushq %%rbp");
+        emit(out, "movq %%rsp, %%rbp");
+        if (localMem > 0) {
+            emit(out, "subq $%d, %%rsp", localMem);
+        }
+        for (int reg : code.saved) {
+            emit(out, "pushq %s", register_names[reg][0]);
+        }
+
+        // The parameter comes in %rdi
+        std::vector<LLVMBasicBlockRef> order = reversePostorder(function);
+        std::vector<std::pair<std::string, std::string>> params;
+        for (unsigned i = 0; i < LLVMCountParams(function) && i < 6; i++) {
+            params.push_back({operandOf(code, LLVMGetParam(function, i), order[0], 'q'), argument_registers[i]});
+        }
+        emitParallelMoves(out, params);
+
+        // Iterate through each basic block, in the order the allocator numbered them
+        for (size_t i = 0; i < order.size(); i++) {
+            LLVMBasicBlockRef BB = order[i];
+            LLVMBasicBlockRef next = i + 1 < order.size() ? order[i + 1] : NULL;
             // Print the basic block label
-            emit("%s:", bb_labels[BB].c_str());
-            
+            emit(out, "%s:", bb_labels[BB].c_str());
+
             // Iterate through each instruction
             for (LLVMValueRef Instr = LLVMGetFirstInstruction(BB); Instr; Instr = LLVMGetNextInstruction(Instr)) {
+                char suffix = suffixOf(Instr);
+                std::string dst = operandOf(code, Instr, BB);
+                auto operand = [&](unsigned k) { return operandOf(code, LLVMGetOperand(Instr, k), BB); };
+
                 // Handle different types of instructions (return, load, store, call, branch, arithmetic, compare)
                 switch (LLVMGetInstructionOpcode(Instr)) {
                     case LLVMRet: {
-                        LLVMValueRef A = LLVMGetOperand(Instr, 0);
-                        //const instruc
-                        if (LLVMIsConstant(A)) {
-                            emit("movl $%d, %%eax", LLVMConstIntGetZExtValue(A));
-                        } else {
-                            int offset = offset_map[A];
-                            emit("movl %d(%%ebp), %%eax", offset);
+                        if (LLVMGetNumOperands(Instr) > 0) {
+                            LLVMValueRef A = LLVMGetOperand(Instr, 0);
+                            emitMove(out, operand(0), scratch(suffixOf(A)), suffixOf(A));
+                        }
+                        for (std::vector<int>::reverse_iterator reg = code.saved.rbegin(); reg != code.saved.rend(); ++reg) {
+                            emit(out, "popq %s", register_names[*reg][0]);
                         }
-                        emit("popl %%ebx");
-                        printFunctionEnd();
+                        printFunctionEnd(out);
                         break;
                     }
                     // load instruc
                     case LLVMLoad: {
-                        LLVMValueRef b = LLVMGetOperand(Instr, 0);
-                        if (b) {
-                            int offset = offset_map[b];
-                            emit("movl %d(%%ebp), %%eax", offset); // Replace %%eax with %exx if assigned
-                        }
+                        emitMove(out, std::to_string(code.offset_map[LLVMGetOperand(Instr, 0)]) + "(%rbp)", dst, suffix);
                         break;
                     }
                     // store instruc
                     case LLVMStore: {
                         LLVMValueRef A = LLVMGetOperand(Instr, 0);
-                        LLVMValueRef b = LLVMGetOperand(Instr, 1);
-                        int offset_b = offset_map[b];
-                        if (LLVMIsConstant(A)) {
-                            emit("movl $%d, %d(%%ebp)", LLVMConstIntGetZExtValue(A), offset_b);
-                        } else {
-                            int offset_a = offset_map[A];
-                            emit("movl %d(%%ebp), %%eax", offset_a); // Assume %a has been assigned a physical register %exx
-                            emit("movl %%eax, %d(%%ebp)", offset_b);
-                        }
+                        emitMove(out, operand(0), std::to_string(code.offset_map[LLVMGetOperand(Instr, 1)]) + "(%rbp)", suffixOf(A));
                         break;
                     }
-                    // call instruc
+                    // call instruc: values live across it are in callee-saved registers, so nothing is saved here
                     case LLVMCall: {
                         LLVMValueRef func = LLVMGetCalledValue(Instr);
-                        emit("pushl %%ecx");
-                        emit("pushl %%edx");
-                        unsigned numOperands = LLVMGetNumOperands(Instr);
-                        for (unsigned i = 0; i < numOperands - 1; i++) {
-                            LLVMValueRef param = LLVMGetOperand(Instr, i);
-                            if (LLVMIsConstant(param)) {
-                                emit("pushl $%d", LLVMConstIntGetZExtValue(param));
-                            } else {
-                                int offset = offset_map[param];
-                                emit("pushl %d(%%ebp)", offset);
-                            }
+                        std::vector<std::pair<std::string, std::string>> arguments;
+                        for (int k = 0; k < LLVMGetNumOperands(Instr) - 1 && k < 6; k++) {
+                            arguments.push_back({argument_registers[k], operandOf(code, LLVMGetOperand(Instr, k), BB, 'q')});
                         }
-                        emit("call %s", LLVMGetValueName(func));
-                        for (unsigned i = 0; i < numOperands - 1; i++) {
-                            emit("addl $4, %%esp");
+                        emitParallelMoves(out, arguments);
+                        emit(out, "call %s", LLVMGetValueName(func));
+                        if (LLVMGetTypeKind(LLVMTypeOf(Instr)) != LLVMVoidTypeKind) {
+                            emitMove(out, scratch(suffix), dst, suffix);
                         }
-                        emit("popl %%edx");
-                        emit("popl %%ecx");
                         break;
                     }
-                    // branch instruc 
+                    // branch instruc
                     case LLVMBr: {
-                        if (LLVMIsConditional(Instr)) {
-                            LLVMValueRef cond = LLVMGetOperand(Instr, 0);
-                            int offset_cond = offset_map[cond];
-                            LLVMValueRef label_true = LLVMGetOperand(Instr, 1);
-                            LLVMValueRef label_false = LLVMGetOperand(Instr, 2);
-                            emit("cmpl $0, %d(%%ebp)", offset_cond);
-                            emit("jne %s", bb_labels[LLVMValueAsBasicBlock(label_true)].c_str());
-                            emit("jmp %s", bb_labels[LLVMValueAsBasicBlock(label_false)].c_str());
-                        } else {
-                            LLVMValueRef label = LLVMGetOperand(Instr, 0);
-                            emit("jmp %s", bb_labels[LLVMValueAsBasicBlock(label)].c_str());
-                        }
+                        emitBranch(out, code, Instr, BB, next);
                         break;
                     }
-                    // arithmetic instruc 
+                    // arithmetic instruc
                     case LLVMAdd:
+                        emitBinary(out, "add", suffix, true, operand(0), operand(1), dst);
+                        break;
                     case LLVMMul:
-                    case LLVMSub: {
-                        LLVMValueRef a = LLVMGetOperand(Instr, 0);
-                        LLVMValueRef b = LLVMGetOperand(Instr, 1);
-                        int offset_a = offset_map[a];
-                        int offset_b = offset_map[b];
-                        emit("movl %d(%%ebp), %%eax", offset_a);
-                        if (LLVMIsConstant(b)) {
-                            emit("addl $%d, %%eax", LLVMConstIntGetZExtValue(b)); // Replace addl by subl or imull based on opcode
-                        } else {
-                            emit("addl %d(%%ebp), %%eax", offset_b); // Replace addl by subl or imull based on opcode
+                        emitBinary(out, "imul", suffix, true, operand(0), operand(1), dst);
+                        break;
+                    case LLVMSub:
+                        emitBinary(out, "sub", suffix, false, operand(0), operand(1), dst);
+                        break;
+                    case LLVMAnd:
+                        emitBinary(out, "and", suffix, true, operand(0), operand(1), dst);
+                        break;
+                    case LLVMOr:
+                        emitBinary(out, "or", suffix, true, operand(0), operand(1), dst);
+                        break;
+                    case LLVMXor:
+                        emitBinary(out, "xor", suffix, true, operand(0), operand(1), dst);
+                        break;
+                    case LLVMSDiv:
+                    case LLVMSRem:
+                        emitDivision(out, LLVMGetInstructionOpcode(Instr) == LLVMSRem, suffix, operand(0), operand(1), dst);
+                        break;
+                    // comparing instruc
+                    case LLVMICmp: {
+                        if (isFusedCompare(Instr)) {
+                            break;  // the branch does the compare
                         }
-                        emit("movl %%eax, %d(%%ebp)", offset_map[Instr]);
+                        emitCompare(out, operand(0), operand(1), suffixOf(LLVMGetOperand(Instr, 0)));
+                        emit(out, "set%s %%al", conditionCode(LLVMGetICmpPredicate(Instr)));
+                        emit(out, "movzbl %%al, %%eax");
+                        emitMove(out, "%eax", dst, 'l');
                         break;
                     }
-                    // comparing instruc 
-                    case LLVMICmp: {
-                        LLVMValueRef a = LLVMGetOperand(Instr, 0);
-                        LLVMValueRef b = LLVMGetOperand(Instr, 1);
-                        int offset_a = offset_map[a];
-                        int offset_b = offset_map[b];
-                        emit("movl %d(%%ebp), %%eax", offset_a);
-                        if (LLVMIsConstant(b)) {
-                            emit("cmpl $%d, %%eax", LLVMConstIntGetZExtValue(b));
+                    case LLVMSelect: {
+                        LLVMValueRef cond = LLVMGetOperand(Instr, 0);
+                        if (LLVMIsAConstantInt(cond)) {
+                            emitMove(out, operand(LLVMConstIntGetZExtValue(cond) ? 1 : 2), dst, suffix);
+                            break;
+                        }
+                        std::string label = bb_labels[BB] + "_" + std::to_string(code.labels++);
+                        emitMove(out, operand(1), scratch(suffix), suffix);
+                        emitCompare(out, operand(0), "$0", 'l');
+                        emit(out, "jne %s", label.c_str());
+                        emitMove(out, operand(2), scratch(suffix), suffix);
+                        emit(out, "%s:", label.c_str());
+                        emitMove(out, scratch(suffix), dst, suffix);
+                        break;
+                    }
+                    // conversions: an i1 is kept as 0 or 1, and a narrow value in the low half of its register
+                    case LLVMSExt:
+                    case LLVMZExt:
+                    case LLVMTrunc: {
+                        LLVMValueRef A = LLVMGetOperand(Instr, 0);
+                        unsigned from = LLVMGetIntTypeWidth(LLVMTypeOf(A));
+                        LLVMOpcode opcode = LLVMGetInstructionOpcode(Instr);
+                        if (opcode == LLVMTrunc) {
+                            emitMove(out, operandOf(code, A, BB, suffix), dst, suffix);
+                            if (LLVMGetIntTypeWidth(LLVMTypeOf(Instr)) == 1) {
+                                emitBinary(out, "and", suffix, true, dst, "$1", dst);
+                            }
+                        } else if (opcode == LLVMSExt && from == 1) {
+                            emitMove(out, operand(0), "%eax", 'l');
+                            emit(out, "neg%c %s", suffix, scratch(suffix).c_str());
+                            emitMove(out, scratch(suffix), dst, suffix);
+                        } else if (opcode == LLVMSExt && suffix == 'q') {
+                            if (isImmediate(operand(0))) {
+                                emitMove(out, operand(0), dst, 'q');     // already sign extended
+                            } else {
+                                emit(out, "movslq %s, %%rax", operand(0).c_str());
+                                emitMove(out, "%rax", dst, 'q');
+                            }
                         } else {
-                            emit("cmpl %d(%%ebp), %%eax", offset_b);
+                            // the upper half of a 32-bit move is zero
+                            emitMove(out, operand(0), "%eax", 'l');
+                            emitMove(out, scratch(suffix), dst, suffix);
                         }
                         break;
                     }
@@ -160,9 +447,19 @@ void generateAssembly(LLVMModuleRef module) {
                 }
             }
         }
+
+        // Stubs holding the moves of conditional edges
+        for (const auto& stub : code.stubs) {
+            emit(out, "%s:", stub.first.c_str());
+            emitParallelMoves(out, edgeMoves(code, stub.second.first, stub.second.second));
+            emit(out, "jmp %s", bb_labels[stub.second.second].c_str());
+        }
     }
+
+    // The stack does not need to be executable
+    emit(out, ".section .note.GNU-stack,\"\",@progbits");
 }
-// helper function to populates a map where the key is an 
+// helper function to populates a map where the key is an
 // LLVMBasicBlockRef and the associated value is a char *, which you can use as a label when generating code.
 void createBBLabels(LLVMModuleRef module, std::map<LLVMBasicBlockRef, std::string>& bb_labels) {
     // Populate bb_labels map
@@ -175,69 +472,55 @@ void createBBLabels(LLVMModuleRef module, std::map<LLVMBasicBlockRef, std::strin
 }
 
 // helper function to emit the required directives for your function.
-void printDirectives(LLVMValueRef function) {
-    emit(".text");
-    emit(".globl %s", LLVMGetValueName(function));
-    emit(".type %s, @function", LLVMGetValueName(function));
-    emit("%s:", LLVMGetValueName(function));
+void printDirectives(FILE* out, LLVMValueRef function) {
+    emit(out, ".text");
+    emit(out, ".globl %s", LLVMGetValueName(function));
+    emit(out, ".type %s, @function", LLVMGetValueName(function));
+    emit(out, "%s:", LLVMGetValueName(function));
 }
 
-// helper function to emits the assembly instructions to restore the value of 
-// %esp and %ebp (you can do this by using the leave instruction instead of explicit moves), and the ret instruction. 
-void printFunctionEnd() {
-    emit("leave");
-    emit("ret");
+// helper function to emits the assembly instructions to restore the value of
+// %rsp and %rbp (you can do this by using the leave instruction instead of explicit moves), and the ret instruction.
+void printFunctionEnd(FILE* out) {
+    emit(out, "leave");
+    emit(out, "ret");
 }
 
 
-// helper function to populate a map offset_map. This map 
-// associates each value(instruction) to the memory offset of that value from %ebp. 
-// The keys in this map are LLVMValueRef and values are integers. This function 
-// will also initialize an integer variable localMem that indicates the number of bytes required to store the local values. 
-void getOffsetMap(LLVMModuleRef module, LLVMValueRef function, int& localMem, std::map<LLVMValueRef, int>& offset_map) {
-    localMem = 4;
-
-    // If the function has a parameter
-    if (LLVMCountParams(function) > 0) {
-        LLVMValueRef param = LLVMGetParam(function, 0);
-        offset_map[param] = 8;
-    }
+// helper function to populate a map offset_map. This map
+// associates each value(instruction) to the memory offset of that value from %rbp.
+// The keys in this map are LLVMValueRef and values are integers. This function
+// will also initialize an integer variable localMem that indicates the number of bytes required to store the local values.
+// Only allocas and the values the allocator spilled in some block get a slot, 8 bytes each.
+void getOffsetMap(LLVMValueRef function, const functionAllocation& allocation, int& localMem, std::map<LLVMValueRef, int>& offset_map) {
+    localMem = 0;
 
     for (LLVMBasicBlockRef BB = LLVMGetFirstBasicBlock(function); BB; BB = LLVMGetNextBasicBlock(BB)) {
         for (LLVMValueRef instr = LLVMGetFirstInstruction(BB); instr; instr = LLVMGetNextInstruction(instr)) {
             // If instr is an alloc instruction
             if (LLVMGetInstructionOpcode(instr) == LLVMAlloca) {
-                localMem += 4;
+                localMem += 8;
                 offset_map[instr] = -localMem;
             }
-            // If instr is a store instruction
-            else if (LLVMGetInstructionOpcode(instr) == LLVMStore) {
-                LLVMValueRef first_operand = LLVMGetOperand(instr, 0);
-                LLVMValueRef second_operand = LLVMGetOperand(instr, 1);
-                
-                if (first_operand == LLVMGetParam(function, 0)) {
-                    int x = offset_map[first_operand];
-                    offset_map[second_operand] = x;
-                } else {
-                    int x = offset_map[second_operand];
-                    offset_map[first_operand] = x;
-                }
-            }
-            // If instr is a load instruction
-            else if (LLVMGetInstructionOpcode(instr) == LLVMLoad) {
-                LLVMValueRef first_operand = LLVMGetOperand(instr, 0);
-                int x = offset_map[first_operand];
-                offset_map[instr] = x;
+        }
+    }
+
+    for (const auto& value : allocation.location) {
+        for (const auto& block : value.second) {
+            if (block.second == SPILLED) {
+                localMem += 8;
+                offset_map[value.first] = -localMem;
+                break;
             }
         }
     }
 }
 
-// utility function to format and print strings 
-void emit(const char *format, ...) {
+// utility function to format and print strings
+void emit(FILE* out, const char *format, ...) {
     va_list args;
     va_start(args, format);
-    vprintf(format, args);
-    printf("\n");
+    vfprintf(out, format, args);
+    fprintf(out, "\n");
     va_end(args);
 }
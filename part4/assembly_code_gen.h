@@ -11,18 +11,21 @@
 #include <vector>
 #include <map>
 #include <cstdarg>
+#include <cstdio>
 #include <llvm-c/Core.h>
 #include <llvm-c/Analysis.h>
 #include <llvm-c/BitWriter.h>
 #include <llvm-c/Transforms/PassManagerBuilder.h>
+#include "register_alloc.h"
 
 // Function declarations
 void createBBLabels(LLVMModuleRef module, std::map<LLVMBasicBlockRef, std::string>& bb_labels);
-void printDirectives(LLVMValueRef function);
-void printFunctionEnd();
-void getOffsetMap(LLVMModuleRef module, LLVMValueRef function, int& localMem, std::map<LLVMValueRef, int>& offset_map);
-void emit(const char *format, ...);
+void printDirectives(FILE* out, LLVMValueRef function);
+void printFunctionEnd(FILE* out);
+void getOffsetMap(LLVMValueRef function, const functionAllocation& allocation, int& localMem, std::map<LLVMValueRef, int>& offset_map);
+void emit(FILE* out, const char *format, ...);
 
-void generateAssembly(LLVMModuleRef module);
+// Writes the assembly of every function with a body to out
+void generateAssembly(LLVMModuleRef module, const moduleAllocation& allocations, FILE* out);
 
 #endif // GENERATE_ASSEMBLY_H
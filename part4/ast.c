@@ -1,4 +1,5 @@
 #include"ast.h"
+#include"compilation_context.h"
 #include<stdio.h>
 #include<stdlib.h>
 #include<assert.h>
@@ -12,10 +13,52 @@ char * get_indent_str(int n){
 	return ret;
 }
 
+/* arena the create* functions allocate from while astArenaBegin is in effect;
+   it belongs to the compilation running on this thread */
+arena* currentAstArena(){
+	CompilationContext *ctx = currentCompilation();
+	return ctx != NULL ? ctx->node_arena : NULL;
+}
+
+void astArenaBegin(){
+	CompilationContext *ctx = currentCompilation();
+	assert(ctx != NULL && ctx->node_arena == NULL);
+	ctx->node_arena = &ctx->tree_arena;
+}
+
+void astArenaEnd(){
+	CompilationContext *ctx = currentCompilation();
+	assert(ctx != NULL && ctx->node_arena == &ctx->tree_arena);
+	ctx->node_arena = NULL;
+	arenaRelease(&ctx->tree_arena);
+}
+
+/* zeroed memory for one node, from the arena if one is active */
+astNode* alloc_node(){
+	arena *node_arena = currentAstArena();
+	if (node_arena != NULL)
+		return (astNode *) arenaAlloc(node_arena, sizeof(astNode));
+	return (astNode *) calloc(1, sizeof(astNode));
+}
+
+stmtList* newStmtList(){
+	arena *node_arena = currentAstArena();
+	if (node_arena != NULL)
+		return new (arenaAlloc(node_arena, sizeof(stmtList))) stmtList();
+	return new stmtList();
+}
+
+void deleteStmtList(stmtList *slist){
+	// arena lists (and their storage) go away with the arena
+	if (slist->get_allocator().owner != NULL)
+		return;
+	delete slist;
+}
+
 /* create and free functions for ast_prog type astNode */
 astNode* createProg(astNode *ext1, astNode	*ext2, astNode	*func){
 	astNode	*node;
-	node = (astNode *)calloc(1, sizeof(astNode));
+	node = alloc_node();
 	node->type = ast_prog;
 
 	node->prog.ext1 = ext1;
@@ -26,6 +69,8 @@ astNode* createProg(astNode *ext1, astNode	*ext2, astNode	*func){
 }
 
 void freeProg(astNode *node){
+	if (currentAstArena() != NULL)
+		return; // released together with the arena
 	assert(node != NULL && node->type == ast_prog);
 	
 	freeExtern(node->prog.ext1);
@@ -39,11 +84,24 @@ void freeProg(astNode *node){
 /*create and free functions for ast_func type astNode */
 astNode* createFunc(const char *name, astNode *param, astNode* body){
 	astNode *node;
-	node = (astNode*)calloc(1, sizeof(astNode));
+	node = alloc_node();
+	node->type = ast_func;
+
+	node->func.name = internName(name);
+
+	node->func.param = param;
+	node->func.body = body;
+
+	return node;
+}
+
+/* Same as above, but interns the name straight from a lexer view of the source */
+astNode* createFunc(strView name, astNode *param, astNode* body){
+	astNode *node;
+	node = alloc_node();
 	node->type = ast_func;
 
-	node->func.name = (char *) calloc(1, sizeof(char) * (strlen(name)+1));
-	strcpy(node->func.name, name);
+	node->func.name = internName(name.ptr, name.len);
 
 	node->func.param = param;
 	node->func.body = body;
@@ -52,9 +110,10 @@ astNode* createFunc(const char *name, astNode *param, astNode* body){
 }
 
 void freeFunc(astNode *node){
+	if (currentAstArena() != NULL)
+		return; // released together with the arena
 	assert(node != NULL && node->type == ast_func);
 	
-	free(node->func.name);
 	if (node->func.param != NULL)
 		freeVar(node->func.param);
 
@@ -68,19 +127,19 @@ void freeFunc(astNode *node){
 
 astNode* createExtern(const char *name){
 	astNode *node;
-	node = (astNode*)calloc(1, sizeof(astNode));
+	node = alloc_node();
 	node->type = ast_extern;
 	
-	node->ext.name = (char *) calloc(1, sizeof(char) * (strlen(name)+1));
-	strcpy(node->ext.name, name);
+	node->ext.name = internName(name);
 
 	return(node);
 }
 
 void freeExtern(astNode *node){
+	if (currentAstArena() != NULL)
+		return; // released together with the arena
 	assert(node != NULL && node->type == ast_extern);
 	
-	free(node->ext.name);
 	free(node);
 
 	return;
@@ -90,20 +149,32 @@ void freeExtern(astNode *node){
 
 astNode* createVar(const char *name){
 	astNode *node;
-	node = (astNode*)calloc(1, sizeof(astNode));
+	node = alloc_node();
+	node->type = ast_var;
+	
+	node->var.name = internName(name);
+	node->var.slot = NO_SLOT;
+	
+	return(node);
+}
+
+astNode* createVar(strView name){
+	astNode *node;
+	node = alloc_node();
 	node->type = ast_var;
 	
-	node->var.name = (char *) calloc(1, sizeof(char) * (strlen(name)+1));
-	strcpy(node->var.name, name);
+	node->var.name = internName(name.ptr, name.len);
+	node->var.slot = NO_SLOT;
 	
 	return(node);
 }
 
 void freeVar(astNode *node){
+	if (currentAstArena() != NULL)
+		return; // released together with the arena
 
 	assert(node != NULL && node->type == ast_var);
 	
-	free(node->var.name);
 	free(node);
 
 	return;
@@ -112,7 +183,7 @@ void freeVar(astNode *node){
 /*create and free functions for ast_cnst type of node*/
 astNode* createCnst(int value){
 	astNode *node;
-	node = (astNode*)calloc(1, sizeof(astNode));
+	node = alloc_node();
 	node->type = ast_cnst;
 
 	node->cnst.value = value;
@@ -120,6 +191,8 @@ astNode* createCnst(int value){
 }
 
 void freeCnst(astNode *node){
+	if (currentAstArena() != NULL)
+		return; // released together with the arena
 	assert(node != NULL);
 	free(node);
 
@@ -129,7 +202,7 @@ void freeCnst(astNode *node){
 /*create and free functions for ast_rexpr type of node*/
 astNode* createRExpr(astNode *lhs, astNode *rhs, rop_type op){
 	astNode *node;
-	node = (astNode*)calloc(1, sizeof(astNode));
+	node = alloc_node();
 	node->type = ast_rexpr;
 	
 	node->rexpr.lhs = lhs;
@@ -140,6 +213,8 @@ astNode* createRExpr(astNode *lhs, astNode *rhs, rop_type op){
 }
 
 void freeRExpr(astNode *node){
+	if (currentAstArena() != NULL)
+		return; // released together with the arena
 	assert(node != NULL && node->type == ast_rexpr);
 	
 	// We call freeNode as we don't know the type of nodes for lhs and rhs
@@ -154,7 +229,7 @@ void freeRExpr(astNode *node){
 /*create and free functions for ast_bexpr type of node*/
 astNode* createBExpr(astNode *lhs, astNode *rhs, op_type op){
 	astNode *node;
-	node = (astNode*)calloc(1, sizeof(astNode));
+	node = alloc_node();
 	node->type = ast_bexpr;
 	
 	node->bexpr.lhs = lhs;
@@ -165,6 +240,8 @@ astNode* createBExpr(astNode *lhs, astNode *rhs, op_type op){
 }
 
 void freeBExpr(astNode *node){
+	if (currentAstArena() != NULL)
+		return; // released together with the arena
 	assert(node != NULL && node->type == ast_bexpr);
 	
 	//We call freeNode as we don't know the type of nodes for rhs and lhs
@@ -179,7 +256,7 @@ void freeBExpr(astNode *node){
 /* create and free functions for ast_uexpr type of node */
 astNode* createUExpr(astNode *expr, op_type op){
 	astNode *node;
-	node = (astNode*)calloc(1, sizeof(astNode));
+	node = alloc_node();
 	node->type = ast_uexpr;
 	
 	node->uexpr.expr = expr;
@@ -189,6 +266,8 @@ astNode* createUExpr(astNode *expr, op_type op){
 }
 
 void freeUExpr(astNode *node){
+	if (currentAstArena() != NULL)
+		return; // released together with the arena
 	assert(node != NULL && node->type == ast_uexpr);
 	
 	freeNode(node->uexpr.expr);
@@ -200,12 +279,11 @@ void freeUExpr(astNode *node){
 /* create and free functions for a statement of type ast_call */
 astNode* createCall(const char *name, astNode *param){
 	astNode *node;
-	node = (astNode*) calloc(1, sizeof(astNode));
+	node = alloc_node();
 	node->type = ast_stmt;
 	node->stmt.type = ast_call;
 	
-	node->stmt.call.name = (char *) calloc(strlen(name) + 1, sizeof(char));
-	strcpy(node->stmt.call.name, name);
+	node->stmt.call.name = internName(name);
 	
 	node->stmt.call.param = param;
 
@@ -213,10 +291,11 @@ astNode* createCall(const char *name, astNode *param){
 }
 
 void freeCall(astNode *node){
+	if (currentAstArena() != NULL)
+		return; // released together with the arena
 	assert(node != NULL && node->type == ast_stmt);
 	assert(node->stmt.type == ast_call);
 	
-	free(node->stmt.call.name);
 	if (node->stmt.call.param != NULL)
 		freeNode(node->stmt.call.param);
 
@@ -227,7 +306,7 @@ void freeCall(astNode *node){
 /*create and free functions for a stmt of type ast_ret*/
 astNode* createRet(astNode	*expr){
 	astNode *node;
-	node = (astNode*) calloc(1, sizeof(astNode));
+	node = alloc_node();
 	node->type = ast_stmt;
 	node->stmt.type = ast_ret;
 	
@@ -235,7 +314,9 @@ astNode* createRet(astNode	*expr){
 	return(node);
 }
 
-void freeRet(astNode *node){	
+void freeRet(astNode *node){
+	if (currentAstArena() != NULL)
+		return; // released together with the arena
 	assert(node != NULL && node->type == ast_stmt);
 	assert(node->stmt.type == ast_ret);
 
@@ -245,9 +326,8 @@ void freeRet(astNode *node){
 }
 
 /*create and free functions for a stmt of type ast_block*/
-astNode* createBlock(vector<astNode*> *stmt_list){
-	vector<astNode*> slist;
-	astNode* node = (astNode *)calloc(1, sizeof(astNode));
+astNode* createBlock(stmtList *stmt_list){
+	astNode* node = alloc_node();
 	node->type = ast_stmt;
 	node->stmt.type = ast_block;
 	
@@ -257,25 +337,27 @@ astNode* createBlock(vector<astNode*> *stmt_list){
 }
 
 void freeBlock(astNode *node){
+	if (currentAstArena() != NULL)
+		return; // released together with the arena
 	assert(node != NULL && node->type == ast_stmt);
 	assert(node->stmt.type == ast_block);
 
-	vector<astNode *> slist = *(node->stmt.block.stmt_list);
-	vector<astNode*>::iterator it = slist.begin();
+	stmtList &slist = *(node->stmt.block.stmt_list);
+	stmtList::iterator it = slist.begin();
 
 	while (it != slist.end()){
 		freeNode(*it);
 		it++;	
 	}
 	
-	delete(node->stmt.block.stmt_list);
+	deleteStmtList(node->stmt.block.stmt_list);
 	free(node);
 	return;
 }
 
 /* create and free functions for stmt of type while*/
 astNode* createWhile(astNode *cond, astNode *body){
-	astNode* node = (astNode *)calloc(1, sizeof(astNode));
+	astNode* node = alloc_node();
 	node->type = ast_stmt;
 	node->stmt.type = ast_while;
 	
@@ -286,6 +368,8 @@ astNode* createWhile(astNode *cond, astNode *body){
 }
 
 void freeWhile(astNode *node){
+	if (currentAstArena() != NULL)
+		return; // released together with the arena
 	assert(node != NULL && node->type == ast_stmt);
 	assert(node->stmt.type == ast_while);
 
@@ -298,7 +382,7 @@ void freeWhile(astNode *node){
 
 /*create and free functions for stmt of type if*/
 astNode* createIf(astNode *cond, astNode *ifbody, astNode *elsebody){
-	astNode* node = (astNode *)calloc(1, sizeof(astNode));
+	astNode* node = alloc_node();
 	node->type = ast_stmt;
 	node->stmt.type = ast_if;
 
@@ -310,6 +394,8 @@ astNode* createIf(astNode *cond, astNode *ifbody, astNode *elsebody){
 }
 
 void freeIf(astNode *node){
+	if (currentAstArena() != NULL)
+		return; // released together with the arena
 	assert(node != NULL && node->type == ast_stmt);
 	assert(node->stmt.type == ast_if);
 	
@@ -325,27 +411,39 @@ void freeIf(astNode *node){
 
 /* create and free functions of stmt type ast_decl */
 astNode* createDecl(const char *name){
-	astNode* node = (astNode *)calloc(1, sizeof(astNode));
+	astNode* node = alloc_node();
+	node->type = ast_stmt;
+	node->stmt.type = ast_decl;
+
+	node->stmt.decl.name = internName(name);
+	node->stmt.decl.slot = NO_SLOT;
+
+	return(node);
+}
+
+astNode* createDecl(strView name){
+	astNode* node = alloc_node();
 	node->type = ast_stmt;
 	node->stmt.type = ast_decl;
 
-	node->stmt.decl.name = (char *)calloc(strlen(name)+1, sizeof(char));
-	strcpy(node->stmt.decl.name, name);
+	node->stmt.decl.name = internName(name.ptr, name.len);
+	node->stmt.decl.slot = NO_SLOT;
 
 	return(node);
 }
 
 void freeDecl(astNode *node){
+	if (currentAstArena() != NULL)
+		return; // released together with the arena
 	assert(node != NULL && node->type == ast_stmt);
 	assert(node->stmt.type == ast_decl);
 	
-	free(node->stmt.decl.name);
 	free(node);
 }
 
 /* create and free functions of stmt type ast_assign */
 astNode* createAsgn(astNode *lhs, astNode *rhs){
-	astNode* node = (astNode *)calloc(1, sizeof(astNode));
+	astNode* node = alloc_node();
 	node->type = ast_stmt;
 	node->stmt.type = ast_asgn;
 
@@ -356,6 +454,8 @@ astNode* createAsgn(astNode *lhs, astNode *rhs){
 }
 
 void freeAsgn(astNode *node){
+	if (currentAstArena() != NULL)
+		return; // released together with the arena
 	assert(node != NULL && node->type == ast_stmt);
 	assert(node->stmt.type == ast_asgn);
 	freeVar(node->stmt.asgn.lhs);
@@ -370,6 +470,8 @@ on the type. This function is called by other free* functions when
 the type of a child node is not obvious from the context */
 
 void freeNode(astNode *node){
+	if (currentAstArena() != NULL)
+		return; // released together with the arena
 	assert(node != NULL);
 
 	switch(node->type){
@@ -419,6 +521,8 @@ void freeNode(astNode *node){
 /* free function to stmt. To be called when stmt type is not obvious
 from the context */
 void freeStmt(astNode *node){
+	if (currentAstArena() != NULL)
+		return; // released together with the arena
 	assert(node != NULL && node->type == ast_stmt);
 	
 	switch(node->stmt.type){
@@ -461,7 +565,7 @@ void printNode(astNode *node, int n){
 						break;
 					  }
 		case ast_func:{
-						printf("%sFunc: %s\n",indent, node->func.name);
+						printf("%sFunc: %s\n",indent, symbolName(node->func.name));
 						if (node->func.param != NULL)
 							printNode(node->func.param, n+1);
 
@@ -475,11 +579,11 @@ void printNode(astNode *node, int n){
 						break;
 					  }
 		case ast_extern:{
-						printf("%sExtern: %s\n", indent, node->ext.name);
+						printf("%sExtern: %s\n", indent, symbolName(node->ext.name));
 						break;
 					  }
 		case ast_var: {	
-						printf("%sVar: %s\n", indent, node->var.name);
+						printf("%sVar: %s\n", indent, symbolName(node->var.name));
 						break;
 					  }
 		case ast_cnst: {
@@ -517,7 +621,7 @@ void printStmt(astStmt *stmt, int n){
 
 	switch(stmt->type){
 		case ast_call: { 
-							printf("%sCall: name %s\n", indent, stmt->call.name);
+							printf("%sCall: name %s\n", indent, symbolName(stmt->call.name));
 							if (stmt->call.param != NULL){
 								printf("%sCall: param\n", indent);
 								printNode(stmt->call.param, n+1);
@@ -531,8 +635,8 @@ void printStmt(astStmt *stmt, int n){
 						}
 		case ast_block: {
 							printf("%sBlock:\n", indent);
-							vector<astNode*> slist = *(stmt->block.stmt_list);
-							vector<astNode*>::iterator it = slist.begin();
+							stmtList &slist = *(stmt->block.stmt_list);
+							stmtList::iterator it = slist.begin();
 							while (it != slist.end()){
 								printNode(*it, n+1);
 								it++;
@@ -566,7 +670,7 @@ void printStmt(astStmt *stmt, int n){
 							break;
 						}
 		case ast_decl:	{
-							printf("%sDecl: %s\n", indent, stmt->decl.name);
+							printf("%sDecl: %s\n", indent, symbolName(stmt->decl.name));
 							break;
 						}
 		default: {
@@ -3,6 +3,9 @@
 
 #include <cstddef>
 #include<vector>
+#include <new>
+#include "intern.h"
+#include "arena.h"
 using namespace std;
 
 struct ast_Node;
@@ -11,6 +14,46 @@ typedef struct ast_Node astNode;
 struct ast_Stmt;
 typedef struct ast_Stmt astStmt;
 
+/* The arena create* allocates from, or NULL when nodes are calloc'd one by one.
+See astArenaBegin below. */
+arena* currentAstArena();
+
+/* Allocator for statement lists: takes memory from the arena that was current
+when the list was constructed, and falls back to the heap otherwise. */
+template <typename T>
+struct astAllocator {
+		typedef T value_type;
+		arena* owner;
+
+		astAllocator() : owner(currentAstArena()) {}
+		template <typename U>
+		astAllocator(const astAllocator<U>& other) : owner(other.owner) {}
+
+		T* allocate(size_t n){
+			if (owner != NULL)
+				return (T*) arenaAlloc(owner, n * sizeof(T));
+			return (T*) ::operator new(n * sizeof(T));
+		}
+		void deallocate(T* p, size_t){
+			if (owner == NULL)
+				::operator delete(p);
+		}
+	};
+
+template <typename T, typename U>
+bool operator==(const astAllocator<T>& a, const astAllocator<U>& b){ return a.owner == b.owner; }
+template <typename T, typename U>
+bool operator!=(const astAllocator<T>& a, const astAllocator<U>& b){ return a.owner != b.owner; }
+
+typedef vector<astNode*, astAllocator<astNode*> > stmtList;
+
+/* A (pointer, length) view of an identifier in the source buffer, as produced
+by the lexer. It is not NUL-terminated and is only valid while the source is open. */
+typedef struct {
+		const char* ptr;
+		int len;
+	} strView;
+
 //enum to identify node type
 typedef enum {
 		ast_prog,
@@ -62,17 +105,22 @@ typedef struct {
 	} astProg; 
 
 typedef struct {
-		char* name; // name of the function
+		symbolId name; // name of the function
 		astNode* param; // parameter, possibly NULL if the function doesn't take a param
 		astNode* body; //function body
+		uint32_t num_slots; // number of variable slots, set by name resolution
 	} astFunc;
 
 typedef struct {
-		char* name; // For extern functions defined we will only save function names
+		symbolId name; // For extern functions defined we will only save function names
 	} astExtern;
 
+// Slot of a variable or declaration name resolution has not bound, never a valid slot
+#define NO_SLOT ((uint32_t)0xffffffff)
+
 typedef struct {
-		char* name;
+		symbolId name;
+		uint32_t slot; // slot of the declaration this use refers to, set by name resolution
 	} astVar; 
 
 typedef struct {
@@ -98,7 +146,7 @@ typedef struct {
 
 /* structs for different statement types */
 typedef struct {
-		char* name;
+		symbolId name;
 		astNode* param; // For read function this field will be NULL
 	} astCall;
 
@@ -107,7 +155,7 @@ typedef struct {
 	} astRet;
 
 typedef struct {
-		vector<astNode*> *stmt_list;
+		stmtList *stmt_list;
 	} astBlock;
 
 typedef struct {
@@ -122,7 +170,8 @@ typedef struct {
 	} astIf;
 
 typedef struct {
-		char* name;
+		symbolId name;
+		uint32_t slot; // dense per-function variable number, set by name resolution
 	} astDecl;
 
 typedef struct {
@@ -166,8 +215,10 @@ defined above. All the create* functions return a astNode*.
 
 astNode* createProg(astNode* extern1, astNode* extern2, astNode* func);
 astNode* createFunc(const char* name, astNode* param, astNode* body);
+astNode* createFunc(strView name, astNode* param, astNode* body);
 astNode* createExtern(const char *name);
 astNode* createVar(const char *name);
+astNode* createVar(strView name);
 astNode* createCnst(int value);
 astNode* createRExpr(astNode* lhs, astNode* rhs, rop_type op);
 astNode* createBExpr(astNode* lhs, astNode* rhs, op_type op);
@@ -182,12 +233,28 @@ a astNode*.
 
 astNode* createCall(const char *name, astNode *param=NULL);
 astNode* createRet(astNode* expr);
-astNode* createBlock(vector<astNode*> *stmt_list);
+astNode* createBlock(stmtList *stmt_list);
 astNode* createWhile(astNode* cond, astNode* body);
 astNode* createIf(astNode* cond, astNode* if_body, astNode* else_body=NULL);
 astNode* createDecl(const char* decl);
+astNode* createDecl(strView decl);
 astNode* createAsgn(astNode* lhs, astNode* rhs);
 
+/* Statement lists are created and destroyed through these so they can live in the arena */
+stmtList* newStmtList();
+void deleteStmtList(stmtList*);
+
+/*
+Arena mode. Between astArenaBegin and astArenaEnd every create* function and
+newStmtList allocate from one arena, and the free* functions return
+immediately. astArenaEnd then releases the whole tree at once instead of
+walking it. Interned names are not part of the arena; the intern table
+already stores each one exactly once. The arena is the one of the current
+compilation context (compilation_context.h), so it is per thread.
+*/
+void astArenaBegin();
+void astArenaEnd();
+
 /* 
 Declarations for all free* functions. All these functions take a astNode* as parameter
 as free the memory allocated by corresponding create functions.
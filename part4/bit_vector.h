@@ -0,0 +1,115 @@
+/*
+*   Purpose: This is the .h file for a packed bit vector used by the dataflow analyses. Sets of
+*   densely numbered items (store instructions, values) are kept as 64-bit words, so union, kill and
+*   compare work on a whole word at a time; the loops are simple enough for the compiler to vectorize.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#ifndef BIT_VECTOR_H
+#define BIT_VECTOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class bitVector {
+public:
+    bitVector() : bits(0) {}
+    explicit bitVector(size_t n) : words((n + 63) / 64, 0), bits(n) {}
+
+    // Number of items the vector can hold
+    size_t size() const { return bits; }
+
+    bool test(size_t i) const { return (words[i >> 6] >> (i & 63)) & 1; }
+    void set(size_t i) { words[i >> 6] |= (uint64_t)1 << (i & 63); }
+    void reset(size_t i) { words[i >> 6] &= ~((uint64_t)1 << (i & 63)); }
+
+    void clear() {
+        for (uint64_t& w : words) {
+            w = 0;
+        }
+    }
+
+    // this |= other. Returns true if a bit was added.
+    bool unionWith(const bitVector& other) {
+        uint64_t changed = 0;
+        uint64_t* w = words.data();
+        const uint64_t* o = other.words.data();
+        for (size_t k = 0; k < words.size(); k++) {
+            uint64_t merged = w[k] | o[k];
+            changed |= merged ^ w[k];
+            w[k] = merged;
+        }
+        return changed != 0;
+    }
+
+    // Sets every bit, the top element for an intersection problem
+    void setAll() {
+        for (uint64_t& w : words) {
+            w = ~(uint64_t)0;
+        }
+        // keep the bits past size() clear so compares and forEach never see them
+        if ((bits & 63) != 0) {
+            words.back() &= ((uint64_t)1 << (bits & 63)) - 1;
+        }
+    }
+
+    // this &= other. Returns true if a bit was removed.
+    bool intersectWith(const bitVector& other) {
+        uint64_t changed = 0;
+        uint64_t* w = words.data();
+        const uint64_t* o = other.words.data();
+        for (size_t k = 0; k < words.size(); k++) {
+            uint64_t met = w[k] & o[k];
+            changed |= met ^ w[k];
+            w[k] = met;
+        }
+        return changed != 0;
+    }
+
+    // this &= ~other
+    void subtract(const bitVector& other) {
+        uint64_t* w = words.data();
+        const uint64_t* o = other.words.data();
+        for (size_t k = 0; k < words.size(); k++) {
+            w[k] &= ~o[k];
+        }
+    }
+
+    // this = gen | (in & ~kill), the transfer function of a gen/kill problem. Returns true if this changed.
+    bool assignTransfer(const bitVector& gen, const bitVector& in, const bitVector& kill) {
+        uint64_t changed = 0;
+        uint64_t* w = words.data();
+        const uint64_t* g = gen.words.data();
+        const uint64_t* i = in.words.data();
+        const uint64_t* k = kill.words.data();
+        for (size_t n = 0; n < words.size(); n++) {
+            uint64_t result = g[n] | (i[n] & ~k[n]);
+            changed |= result ^ w[n];
+            w[n] = result;
+        }
+        return changed != 0;
+    }
+
+    bool operator==(const bitVector& other) const { return words == other.words; }
+    bool operator!=(const bitVector& other) const { return words != other.words; }
+
+    // Calls f(i) for every set bit i in increasing order
+    template <typename F>
+    void forEach(F f) const {
+        for (size_t k = 0; k < words.size(); k++) {
+            uint64_t w = words[k];
+            while (w != 0) {
+                f(k * 64 + (size_t)__builtin_ctzll(w));
+                w &= w - 1;
+            }
+        }
+    }
+
+private:
+    std::vector<uint64_t> words;
+    size_t bits;
+};
+
+#endif // BIT_VECTOR_H
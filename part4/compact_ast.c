@@ -0,0 +1,253 @@
+/*
+*   Purpose: This file builds and prints the compact (index-based, struct-of-arrays) AST from the
+*   pointer AST produced by the parser.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#include "compact_ast.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+// Appends an empty node of the given kind and returns its index
+static nodeIndex addNode(compactAst& ast, node_type kind) {
+    nodeIndex i = (nodeIndex)ast.kind.size();
+    ast.kind.push_back((uint8_t)kind);
+    ast.stmt.push_back(0);
+    ast.op.push_back(0);
+    ast.a.push_back(NO_NODE);
+    ast.b.push_back(NO_NODE);
+    ast.c.push_back(NO_NODE);
+    ast.end.push_back(i + 1);
+    return i;
+}
+
+// Flattens node and its subtree in preorder and returns the index of node
+static nodeIndex flattenNode(astNode* node, compactAst& ast) {
+    if (node == NULL) {
+        return NO_NODE;
+    }
+    nodeIndex i = addNode(ast, node->type);
+
+    switch (node->type) {
+        case ast_prog: {
+            nodeIndex ext1 = flattenNode(node->prog.ext1, ast);
+            nodeIndex ext2 = flattenNode(node->prog.ext2, ast);
+            nodeIndex func = flattenNode(node->prog.func, ast);
+            ast.a[i] = ext1;
+            ast.b[i] = ext2;
+            ast.c[i] = func;
+            break;
+        }
+        case ast_func: {
+            ast.a[i] = node->func.name;
+            nodeIndex param = flattenNode(node->func.param, ast);
+            nodeIndex body = flattenNode(node->func.body, ast);
+            ast.b[i] = param;
+            ast.c[i] = body;
+            break;
+        }
+        case ast_extern:
+            ast.a[i] = node->ext.name;
+            break;
+        case ast_var:
+            ast.a[i] = node->var.name;
+            break;
+        case ast_cnst:
+            ast.a[i] = (uint32_t)node->cnst.value;
+            break;
+        case ast_rexpr: {
+            ast.op[i] = (uint8_t)node->rexpr.op;
+            nodeIndex lhs = flattenNode(node->rexpr.lhs, ast);
+            nodeIndex rhs = flattenNode(node->rexpr.rhs, ast);
+            ast.a[i] = lhs;
+            ast.b[i] = rhs;
+            break;
+        }
+        case ast_bexpr: {
+            ast.op[i] = (uint8_t)node->bexpr.op;
+            nodeIndex lhs = flattenNode(node->bexpr.lhs, ast);
+            nodeIndex rhs = flattenNode(node->bexpr.rhs, ast);
+            ast.a[i] = lhs;
+            ast.b[i] = rhs;
+            break;
+        }
+        case ast_uexpr: {
+            ast.op[i] = (uint8_t)node->uexpr.op;
+            nodeIndex expr = flattenNode(node->uexpr.expr, ast);
+            ast.a[i] = expr;
+            break;
+        }
+        case ast_stmt: {
+            ast.stmt[i] = (uint8_t)node->stmt.type;
+            switch (node->stmt.type) {
+                case ast_call: {
+                    ast.a[i] = node->stmt.call.name;
+                    nodeIndex param = flattenNode(node->stmt.call.param, ast);
+                    ast.b[i] = param;
+                    break;
+                }
+                case ast_ret: {
+                    nodeIndex expr = flattenNode(node->stmt.ret.expr, ast);
+                    ast.a[i] = expr;
+                    break;
+                }
+                case ast_block: {
+                    // Reserve the block's range first so nested blocks land after it
+                    stmtList& slist = *(node->stmt.block.stmt_list);
+                    uint32_t first = (uint32_t)ast.stmts.size();
+                    ast.stmts.resize(first + slist.size());
+                    for (size_t k = 0; k < slist.size(); k++) {
+                        nodeIndex s = flattenNode(slist[k], ast);
+                        ast.stmts[first + k] = s;
+                    }
+                    ast.a[i] = first;
+                    ast.b[i] = (uint32_t)slist.size();
+                    break;
+                }
+                case ast_while: {
+                    nodeIndex cond = flattenNode(node->stmt.whilen.cond, ast);
+                    nodeIndex body = flattenNode(node->stmt.whilen.body, ast);
+                    ast.a[i] = cond;
+                    ast.b[i] = body;
+                    break;
+                }
+                case ast_if: {
+                    nodeIndex cond = flattenNode(node->stmt.ifn.cond, ast);
+                    nodeIndex ifBody = flattenNode(node->stmt.ifn.if_body, ast);
+                    nodeIndex elseBody = flattenNode(node->stmt.ifn.else_body, ast);
+                    ast.a[i] = cond;
+                    ast.b[i] = ifBody;
+                    ast.c[i] = elseBody;
+                    break;
+                }
+                case ast_decl:
+                    ast.a[i] = node->stmt.decl.name;
+                    break;
+                case ast_asgn: {
+                    nodeIndex lhs = flattenNode(node->stmt.asgn.lhs, ast);
+                    nodeIndex rhs = flattenNode(node->stmt.asgn.rhs, ast);
+                    ast.a[i] = lhs;
+                    ast.b[i] = rhs;
+                    break;
+                }
+            }
+            break;
+        }
+        default:
+            fprintf(stderr, "Incorrect node type\n");
+            exit(1);
+    }
+
+    ast.end[i] = (nodeIndex)ast.kind.size();
+    return i;
+}
+
+void flattenAst(astNode* root, compactAst& ast) {
+    ast.kind.clear();
+    ast.stmt.clear();
+    ast.op.clear();
+    ast.a.clear();
+    ast.b.clear();
+    ast.c.clear();
+    ast.end.clear();
+    ast.stmts.clear();
+    flattenNode(root, ast);
+}
+
+void printCompactAst(const compactAst& ast, nodeIndex i, int n) {
+    if (i == NO_NODE) {
+        return;
+    }
+    std::string pad(n, ' ');
+    const char* indent = pad.c_str();
+
+    switch (ast.kind[i]) {
+        case ast_prog:
+            printf("%sProg:\n", indent);
+            printCompactAst(ast, ast.c[i], n + 1);
+            break;
+        case ast_func:
+            printf("%sFunc: %s\n", indent, symbolName(ast.a[i]));
+            printCompactAst(ast, ast.b[i], n + 1);
+            printCompactAst(ast, ast.c[i], n + 1);
+            break;
+        case ast_extern:
+            printf("%sExtern: %s\n", indent, symbolName(ast.a[i]));
+            break;
+        case ast_var:
+            printf("%sVar: %s\n", indent, symbolName(ast.a[i]));
+            break;
+        case ast_cnst:
+            printf("%sConst: %d\n", indent, (int)ast.a[i]);
+            break;
+        case ast_rexpr:
+            printf("%sRExpr: \n", indent);
+            printCompactAst(ast, ast.a[i], n + 1);
+            printCompactAst(ast, ast.b[i], n + 1);
+            break;
+        case ast_bexpr:
+            printf("%sBExpr: \n", indent);
+            printCompactAst(ast, ast.a[i], n + 1);
+            printCompactAst(ast, ast.b[i], n + 1);
+            break;
+        case ast_uexpr:
+            printf("%sUExpr: \n", indent);
+            printCompactAst(ast, ast.a[i], n + 1);
+            break;
+        case ast_stmt: {
+            printf("%sStmt: \n", indent);
+            std::string stmtPad(n + 1, ' ');
+            const char* sindent = stmtPad.c_str();
+            switch (ast.stmt[i]) {
+                case ast_call:
+                    printf("%sCall: name %s\n", sindent, symbolName(ast.a[i]));
+                    if (ast.b[i] != NO_NODE) {
+                        printf("%sCall: param\n", sindent);
+                        printCompactAst(ast, ast.b[i], n + 2);
+                    }
+                    break;
+                case ast_ret:
+                    printf("%sRet:\n", sindent);
+                    printCompactAst(ast, ast.a[i], n + 2);
+                    break;
+                case ast_block:
+                    printf("%sBlock:\n", sindent);
+                    for (uint32_t k = 0; k < ast.b[i]; k++) {
+                        printCompactAst(ast, ast.stmts[ast.a[i] + k], n + 2);
+                    }
+                    break;
+                case ast_while:
+                    printf("%sWhile: cond \n", sindent);
+                    printCompactAst(ast, ast.a[i], n + 2);
+                    printf("%sWhile: body \n", sindent);
+                    printCompactAst(ast, ast.b[i], n + 2);
+                    break;
+                case ast_if:
+                    printf("%sIf: cond\n", sindent);
+                    printCompactAst(ast, ast.a[i], n + 2);
+                    printf("%sIf: body\n", sindent);
+                    printCompactAst(ast, ast.b[i], n + 2);
+                    if (ast.c[i] != NO_NODE) {
+                        printf("%sElse: body\n", sindent);
+                        printCompactAst(ast, ast.c[i], n + 2);
+                    }
+                    break;
+                case ast_asgn:
+                    printf("%sAsgn: lhs\n", sindent);
+                    printCompactAst(ast, ast.a[i], n + 2);
+                    printf("%sAsgn: rhs\n", sindent);
+                    printCompactAst(ast, ast.b[i], n + 2);
+                    break;
+                case ast_decl:
+                    printf("%sDecl: %s\n", sindent, symbolName(ast.a[i]));
+                    break;
+            }
+            break;
+        }
+        default:
+            fprintf(stderr, "Incorrect node type\n");
+            exit(1);
+    }
+}
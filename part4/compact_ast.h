@@ -0,0 +1,67 @@
+/*
+*   Purpose: This is the .h file for the compact AST. It is an alternative layout of the tree built by
+*   the parser: nodes live in parallel typed arrays, children are 32-bit indices instead of pointers,
+*   and the statements of a block are a contiguous range of one shared list.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#ifndef COMPACT_AST_H
+#define COMPACT_AST_H
+
+#include <cstdint>
+#include <vector>
+#include "ast.h"
+
+typedef uint32_t nodeIndex;
+
+#define NO_NODE ((nodeIndex)0xffffffff)
+
+/*
+* Nodes are stored in preorder, so the subtree rooted at i is exactly the
+* index range [i, end[i]) and a linear sweep over the arrays visits the tree
+* in source order. Node 0 is the ast_prog node.
+*
+* What a, b and c hold depends on the node:
+*   prog    a = extern 1,  b = extern 2,  c = func
+*   func    a = name,      b = param var (or NO_NODE), c = body block
+*   extern  a = name
+*   var     a = name,  b = slot (after name resolution)
+*   cnst    a = value (as uint32_t)
+*   rexpr   a = lhs,  b = rhs,  op = rop_type
+*   bexpr   a = lhs,  b = rhs,  op = op_type
+*   uexpr   a = expr, op = op_type
+*   call    a = name, b = param (or NO_NODE)
+*   ret     a = expr (or NO_NODE)
+*   block   a = first index into stmts, b = number of statements
+*   while   a = cond, b = body
+*   if      a = cond, b = if body, c = else body (or NO_NODE)
+*   decl    a = name,  b = slot (after name resolution)
+*   asgn    a = lhs var, b = rhs
+*/
+typedef struct {
+    std::vector<uint8_t> kind;      // node_type
+    std::vector<uint8_t> stmt;      // stmt_type, only meaningful for ast_stmt nodes
+    std::vector<uint8_t> op;        // rop_type or op_type for expression nodes
+    std::vector<uint32_t> a;
+    std::vector<uint32_t> b;
+    std::vector<uint32_t> c;
+    std::vector<nodeIndex> end;     // one past the last node of the subtree
+    std::vector<nodeIndex> stmts;   // statement lists of all blocks, back to back
+} compactAst;
+
+// Copies the pointer AST rooted at a prog node into the compact layout
+void flattenAst(astNode* root, compactAst& ast);
+
+// Number of nodes in the tree
+inline size_t compactSize(const compactAst& ast) { return ast.kind.size(); }
+
+// True if node i is a statement of the given type
+inline bool isCompactStmt(const compactAst& ast, nodeIndex i, stmt_type type) {
+    return ast.kind[i] == ast_stmt && ast.stmt[i] == type;
+}
+
+// Prints the tree in the same format as printNode
+void printCompactAst(const compactAst& ast, nodeIndex i = 0, int indent = 0);
+
+#endif // COMPACT_AST_H
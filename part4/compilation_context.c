@@ -0,0 +1,35 @@
+/*
+*   Purpose: This file creates and tears down the per-compilation state and tracks which context
+*   each thread is compiling in.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#include "compilation_context.h"
+
+static thread_local CompilationContext* current_compilation = NULL;
+
+CompilationContext::CompilationContext()
+    : llvm(LLVMContextCreate()), names(newInternTable()), node_arena(NULL), rootNode(NULL),
+      locals(), ret_slot(0), retBB(NULL) {
+    arenaInit(&tree_arena);
+}
+
+CompilationContext::~CompilationContext() {
+    if (current_compilation == this) {
+        current_compilation = NULL;
+    }
+    disposeLocals(locals);
+    arenaRelease(&tree_arena);
+    deleteInternTable(names);
+    // modules created in llvm must have been disposed by now
+    LLVMContextDispose(llvm);
+}
+
+void setCurrentCompilation(CompilationContext* ctx) {
+    current_compilation = ctx;
+}
+
+CompilationContext* currentCompilation() {
+    return current_compilation;
+}
@@ -0,0 +1,63 @@
+/*
+*   Purpose: This is the .h file for the compilation context. It owns everything one compile of a
+*   translation unit changes: its own LLVM context, the identifier table, the AST arena and tree, and
+*   the IR builder's state. Nothing else in the compiler keeps mutable globals, so separate files can
+*   be compiled on separate threads of one process, each with its own context.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#ifndef COMPILATION_CONTEXT_H
+#define COMPILATION_CONTEXT_H
+
+#include <llvm-c/Core.h>
+#include <cstdint>
+#include "arena.h"
+#include "intern.h"
+#include "ssa_builder.h"
+
+typedef struct ast_Node astNode;
+
+class CompilationContext {
+public:
+    CompilationContext();
+    ~CompilationContext();
+
+    // A context is tied to the modules and trees created in it
+    CompilationContext(const CompilationContext&) = delete;
+    CompilationContext& operator=(const CompilationContext&) = delete;
+
+    LLVMContextRef llvm;        // types, constants and modules of this compile
+    internTable* names;         // identifiers of this translation unit
+
+    arena tree_arena;           // the create* functions allocate from it between astArenaBegin and astArenaEnd
+    arena* node_arena;          // &tree_arena while that is in effect, NULL otherwise
+    astNode* rootNode;          // set by the parser
+
+    // IR builder state for the function being lowered
+    localVars locals;
+    uint32_t ret_slot;          // slot holding the return value
+    LLVMBasicBlockRef retBB;
+};
+
+/*
+* The context the calling thread is compiling in. The interning table and
+* the AST create* functions are called from too many places (the parser's
+* actions among them) to take a context argument, so they use this instead.
+* Set it before parsing; each thread has its own.
+*/
+void setCurrentCompilation(CompilationContext* ctx);
+CompilationContext* currentCompilation();
+
+// Makes ctx the current compilation while it is in scope, and clears it again however the scope is left,
+// so the thread never keeps a pointer to a context that is gone
+class CompilationScope {
+public:
+    explicit CompilationScope(CompilationContext* ctx) { setCurrentCompilation(ctx); }
+    ~CompilationScope() { setCurrentCompilation(NULL); }
+
+    CompilationScope(const CompilationScope&) = delete;
+    CompilationScope& operator=(const CompilationScope&) = delete;
+};
+
+#endif // COMPILATION_CONTEXT_H
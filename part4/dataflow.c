@@ -0,0 +1,138 @@
+/*
+*   Purpose: This file implements the generic dataflow solver used by the optimizer. Blocks wait on a worklist
+*   ordered by their position in reverse postorder (postorder for backward problems), so a block is normally
+*   visited after everything flowing into it, and a block is only queued again when an input set changed.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#include <stdio.h>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "dataflow.h"
+
+// Function to order the blocks reachable from the entry in reverse postorder
+std::vector<LLVMBasicBlockRef> reversePostorder(LLVMValueRef function) {
+    std::vector<LLVMBasicBlockRef> postorder;
+    if (LLVMCountBasicBlocks(function) == 0) {
+        return postorder;
+    }
+
+    // Iterative depth first search: each stack entry is a block and the next successor to look at
+    std::unordered_set<LLVMBasicBlockRef> visited;
+    std::vector<std::pair<LLVMBasicBlockRef, unsigned>> stack;
+    LLVMBasicBlockRef entry = LLVMGetEntryBasicBlock(function);
+    visited.insert(entry);
+    stack.push_back({entry, 0});
+
+    while (!stack.empty()) {
+        LLVMBasicBlockRef bb = stack.back().first;
+        LLVMValueRef terminator = LLVMGetBasicBlockTerminator(bb);
+        unsigned numSuccessors = terminator ? LLVMGetNumSuccessors(terminator) : 0;
+
+        if (stack.back().second < numSuccessors) {
+            LLVMBasicBlockRef successor = LLVMGetSuccessor(terminator, stack.back().second++);
+            if (visited.insert(successor).second) {
+                stack.push_back({successor, 0});
+            }
+        } else {
+            // all successors are done
+            postorder.push_back(bb);
+            stack.pop_back();
+        }
+    }
+
+    return std::vector<LLVMBasicBlockRef>(postorder.rbegin(), postorder.rend());
+}
+
+dataflowResult solveDataflow(LLVMValueRef function, const dataflowProblem& problem, const predMap& predecessors) {
+    return solveDataflow(function, problem, predecessors, reversePostorder(function));
+}
+
+dataflowResult solveDataflow(LLVMValueRef function, const dataflowProblem& problem, const predMap& predecessors,
+                             const std::vector<LLVMBasicBlockRef>& rpo) {
+    dataflowResult result;
+    result.block_visits = 0;
+    bool forward = problem.direction == DATAFLOW_FORWARD;
+
+    // Every block starts with an empty input and the output its transfer gives for it. For an
+    // intersection the output starts full instead, so the first meet is not stuck at empty.
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(function); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        result.in[bb] = bitVector(problem.num_bits);
+        result.out[bb] = bitVector(problem.num_bits);
+    }
+    bbBits& inputs = forward ? result.in : result.out;
+    bbBits& outputs = forward ? result.out : result.in;
+
+    // Visiting order: reverse postorder for forward problems, postorder for backward ones
+    std::vector<LLVMBasicBlockRef> order(rpo);
+    if (!forward) {
+        order.assign(rpo.rbegin(), rpo.rend());
+    }
+    std::unordered_map<LLVMBasicBlockRef, uint32_t> position;
+    for (uint32_t i = 0; i < order.size(); i++) {
+        position[order[i]] = i;
+        if (problem.meet == MEET_INTERSECT) {
+            outputs[order[i]].setAll();
+        } else {
+            outputs[order[i]] = problem.gen.at(order[i]);
+        }
+    }
+
+    // Blocks flowing into a block and the blocks it flows into; only reachable blocks take part
+    std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMBasicBlockRef>> sources;
+    std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMBasicBlockRef>> targets;
+    for (LLVMBasicBlockRef bb : order) {
+        for (LLVMBasicBlockRef pred : predecessors.at(bb)) {
+            if (position.count(pred) == 0) {
+                continue;
+            }
+            if (forward) {
+                sources[bb].push_back(pred);
+                targets[pred].push_back(bb);
+            } else {
+                sources[pred].push_back(bb);
+                targets[bb].push_back(pred);
+            }
+        }
+    }
+
+    // The worklist holds positions in the visiting order, so the lowest pending block is taken first
+    std::set<uint32_t> worklist;
+    for (uint32_t i = 0; i < order.size(); i++) {
+        worklist.insert(i);
+    }
+
+    while (!worklist.empty()) {
+        LLVMBasicBlockRef bb = order[*worklist.begin()];
+        worklist.erase(worklist.begin());
+        result.block_visits++;
+
+        // meet over the blocks flowing in; a block with none (entry or exit) keeps the empty boundary set
+        bitVector& input = inputs[bb];
+        const std::vector<LLVMBasicBlockRef>& from = sources[bb];
+        if (problem.meet == MEET_INTERSECT && !from.empty()) {
+            input.setAll();
+            for (LLVMBasicBlockRef source : from) {
+                input.intersectWith(outputs[source]);
+            }
+        } else {
+            input.clear();
+            for (LLVMBasicBlockRef source : from) {
+                input.unionWith(outputs[source]);
+            }
+        }
+
+        // a changed output is a changed input for every block it flows into
+        if (outputs[bb].assignTransfer(problem.gen.at(bb), input, problem.kill.at(bb))) {
+            for (LLVMBasicBlockRef target : targets[bb]) {
+                worklist.insert(position[target]);
+            }
+        }
+    }
+
+    printf("Dataflow solved with %u block visits over %zu reachable blocks\n", result.block_visits, order.size());
+    return result;
+}
@@ -0,0 +1,57 @@
+/*
+*   Purpose: This is the .h file for the generic dataflow solver used by the optimizer. A problem is given as
+*   GEN and KILL bit vectors per basic block, a direction and a meet operator; the solver finds the IN and OUT
+*   sets with a worklist that starts in reverse postorder (postorder for backward problems) and only revisits
+*   a block when one of the sets flowing into it changed.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#ifndef DATAFLOW_H
+#define DATAFLOW_H
+
+#include <llvm-c/Core.h>
+#include <unordered_map>
+#include <vector>
+#include "bit_vector.h"
+
+using predMap = std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMBasicBlockRef>>;
+
+// Sets per basic block, as bit vectors indexed by a dense numbering chosen by the problem
+using bbBits = std::unordered_map<LLVMBasicBlockRef, bitVector>;
+
+enum dataflowDirection {
+    DATAFLOW_FORWARD,   // IN(B) = meet of OUT(P) over predecessors, OUT(B) = GEN(B) | (IN(B) & ~KILL(B))
+    DATAFLOW_BACKWARD   // OUT(B) = meet of IN(S) over successors, IN(B) = GEN(B) | (OUT(B) & ~KILL(B))
+};
+
+enum dataflowMeet {
+    MEET_UNION,         // may problems: reaching definitions, liveness
+    MEET_INTERSECT      // must problems: available expressions
+};
+
+typedef struct {
+    dataflowDirection direction;
+    dataflowMeet meet;
+    size_t num_bits;    // size of every set
+    bbBits gen;
+    bbBits kill;
+} dataflowProblem;
+
+typedef struct {
+    bbBits in;
+    bbBits out;
+    unsigned block_visits;  // transfer functions evaluated until the fixpoint
+} dataflowResult;
+
+// Function to order the blocks reachable from the entry in reverse postorder
+std::vector<LLVMBasicBlockRef> reversePostorder(LLVMValueRef function);
+
+// Function to solve problem over function. Blocks that cannot be reached from the entry get empty sets.
+dataflowResult solveDataflow(LLVMValueRef function, const dataflowProblem& problem, const predMap& predecessors);
+
+// Same, with the reverse postorder already known
+dataflowResult solveDataflow(LLVMValueRef function, const dataflowProblem& problem, const predMap& predecessors,
+                             const std::vector<LLVMBasicBlockRef>& rpo);
+
+#endif // DATAFLOW_H
@@ -0,0 +1,260 @@
+/*
+*   Purpose: This file is the graph coloring register allocator, the slower alternative to linear scan.
+*   Build makes the interference graph from the live intervals, and each phi with one of its incoming
+*   values is a move to coalesce. The graph is then taken apart one node at a time: simplify removes a
+*   node with fewer neighbours than registers, coalesce merges the two ends of a move when the merged node
+*   has fewer neighbours of high degree than registers (Briggs), freeze gives up the moves of a node so it
+*   can be simplified, and spill removes the node that is cheapest to keep in memory. Select puts the
+*   nodes back in reverse order and colors them; a potential spill often still finds a color there.
+*   Spilled values need no rewrite of the code: the code generator reads and writes them in their stack
+*   slots through %rax, so one round of coloring is enough.
+*   Author: Carly Retterer
+*   Date:  30 May 2024
+*/
+
+#include <stdio.h>
+#include <climits>
+#include <numeric>
+#include <set>
+#include "graph_coloring.h"
+
+functionAllocation graphColoring(const functionLiveness& liveness, int numRegisters) {
+    functionAllocation allocation;
+    const std::vector<liveInterval>& intervals = liveness.intervals;
+    size_t numValues = intervals.size();
+
+    // The nodes, by start, so only the intervals starting before one ends can overlap it
+    std::vector<int> nodes;
+    for (size_t id = 0; id < numValues; id++) {
+        if (!intervals[id].ranges.empty()) {
+            nodes.push_back(id);
+        }
+    }
+    std::sort(nodes.begin(), nodes.end(), [&](int a, int b) { return intervals[a].start() < intervals[b].start(); });
+
+    // Build
+    std::vector<std::set<int>> adjacent(numValues);     // the graph that is left
+    for (size_t i = 0; i < nodes.size(); i++) {
+        for (size_t j = i + 1; j < nodes.size() && intervals[nodes[j]].start() < intervals[nodes[i]].end(); j++) {
+            if (firstIntersection(intervals[nodes[i]], intervals[nodes[j]]) >= 0) {
+                adjacent[nodes[i]].insert(nodes[j]);
+                adjacent[nodes[j]].insert(nodes[i]);
+            }
+        }
+    }
+    std::vector<std::set<int>> interference = adjacent; // every edge, for select
+
+    // A value live across a call can only have a callee-saved register
+    std::vector<bool> crossesCall(numValues, false);
+    for (int node : nodes) {
+        crossesCall[node] = intervals[node].firstCallCrossed(liveness.calls) != INT_MAX;
+    }
+    auto colors = [&](int node) {
+        return crossesCall[node] ? std::max(numRegisters - FIRST_CALLEE_SAVED, 0) : numRegisters;
+    };
+
+    // Spill cost: the definition and the uses, ten times more for every loop they are in
+    std::vector<double> cost(numValues, 0);
+    auto weight = [&](int position) {
+        std::map<LLVMBasicBlockRef, unsigned>::const_iterator it = liveness.loop_depth.find(liveness.blockAt(position));
+        double w = 1;
+        for (unsigned depth = it == liveness.loop_depth.end() ? 0 : it->second; depth > 0; depth--) {
+            w *= 10;
+        }
+        return w;
+    };
+    for (int node : nodes) {
+        cost[node] = weight(intervals[node].start());
+        for (int use : intervals[node].uses) {
+            cost[node] += weight(use);
+        }
+    }
+
+    // Moves: a phi and each of its incoming values. A move is done once it is coalesced, frozen or
+    // its ends interfere.
+    std::vector<std::pair<int, int>> moves;
+    std::vector<bool> done;
+    std::vector<std::vector<size_t>> moveList(numValues);
+    for (int node : nodes) {
+        LLVMValueRef phi = liveness.values[node];
+        if (!LLVMIsAPHINode(phi)) {
+            continue;
+        }
+        for (unsigned i = 0; i < LLVMCountIncoming(phi); i++) {
+            std::map<LLVMValueRef, int>::const_iterator it = liveness.value_ids.find(LLVMGetIncomingValue(phi, i));
+            if (it == liveness.value_ids.end() || it->second == node || intervals[it->second].ranges.empty()) {
+                continue;
+            }
+            moveList[node].push_back(moves.size());
+            moveList[it->second].push_back(moves.size());
+            moves.push_back({node, it->second});
+            done.push_back(false);
+        }
+    }
+
+    // A coalesced node points at the node it was merged into
+    std::vector<int> alias(numValues);
+    std::iota(alias.begin(), alias.end(), 0);
+    auto find = [&](int node) {
+        while (alias[node] != node) {
+            node = alias[node];
+        }
+        return node;
+    };
+    auto moveRelated = [&](int node) {
+        for (size_t m : moveList[node]) {
+            if (!done[m]) {
+                return true;
+            }
+        }
+        return false;
+    };
+    auto significant = [&](int node) { return (int)adjacent[node].size() >= colors(node); };
+
+    std::vector<bool> inGraph(numValues, false);
+    for (int node : nodes) {
+        inGraph[node] = true;
+    }
+    size_t remaining = nodes.size();
+    std::vector<int> stack;
+    auto removeNode = [&](int node) {
+        for (int neighbour : adjacent[node]) {
+            adjacent[neighbour].erase(node);
+        }
+        adjacent[node].clear();
+        inGraph[node] = false;
+        remaining--;
+        stack.push_back(node);
+    };
+
+    while (remaining > 0) {
+        // Simplify
+        int pick = -1;
+        for (int node : nodes) {
+            if (inGraph[node] && !significant(node) && !moveRelated(node)) {
+                pick = node;
+                break;
+            }
+        }
+        if (pick >= 0) {
+            removeNode(pick);
+            continue;
+        }
+
+        // Coalesce
+        bool merged = false;
+        for (size_t m = 0; m < moves.size() && !merged; m++) {
+            if (done[m]) {
+                continue;
+            }
+            int x = find(moves[m].first);
+            int y = find(moves[m].second);
+            if (x == y || adjacent[x].count(y)) {
+                done[m] = true;
+                continue;
+            }
+            std::set<int> neighbours = adjacent[x];
+            neighbours.insert(adjacent[y].begin(), adjacent[y].end());
+            int high = 0;
+            for (int neighbour : neighbours) {
+                if (significant(neighbour)) {
+                    high++;
+                }
+            }
+            if (high >= std::min(colors(x), colors(y))) {
+                continue;
+            }
+            // y goes into x
+            alias[y] = x;
+            crossesCall[x] = crossesCall[x] || crossesCall[y];
+            cost[x] += cost[y];
+            for (int neighbour : adjacent[y]) {
+                adjacent[neighbour].erase(y);
+                adjacent[neighbour].insert(x);
+                adjacent[x].insert(neighbour);
+            }
+            adjacent[y].clear();
+            interference[x].insert(interference[y].begin(), interference[y].end());
+            moveList[x].insert(moveList[x].end(), moveList[y].begin(), moveList[y].end());
+            inGraph[y] = false;
+            remaining--;
+            done[m] = true;
+            allocation.coalesced++;
+            merged = true;
+        }
+        if (merged) {
+            continue;
+        }
+
+        // Freeze: a node of low degree gives up its moves
+        for (int node : nodes) {
+            if (inGraph[node] && !significant(node)) {
+                pick = node;
+                break;
+            }
+        }
+        if (pick >= 0) {
+            for (size_t m : moveList[pick]) {
+                done[m] = true;
+            }
+            continue;
+        }
+
+        // Spill: the node that costs least per neighbour is pushed anyway, it may still get a color
+        double best = 0;
+        for (int node : nodes) {
+            if (!inGraph[node]) {
+                continue;
+            }
+            double ratio = cost[node] / std::max<size_t>(adjacent[node].size(), 1);
+            if (pick < 0 || ratio < best) {
+                pick = node;
+                best = ratio;
+            }
+        }
+        for (size_t m : moveList[pick]) {
+            done[m] = true;
+        }
+        removeNode(pick);
+    }
+
+    // Select: the lowest register the neighbours left, the register of a move partner if it is free
+    std::vector<int> color(numValues, SPILLED);
+    while (!stack.empty()) {
+        int node = stack.back();
+        stack.pop_back();
+        std::vector<bool> taken(numRegisters, false);
+        for (int neighbour : interference[node]) {
+            int reg = color[find(neighbour)];
+            if (reg != SPILLED && find(neighbour) != node) {
+                taken[reg] = true;
+            }
+        }
+        int first = crossesCall[node] ? FIRST_CALLEE_SAVED : 0;
+        for (size_t m : moveList[node]) {
+            int partner = find(moves[m].first) == node ? find(moves[m].second) : find(moves[m].first);
+            int reg = color[partner];
+            if (reg >= first && !taken[reg]) {
+                color[node] = reg;
+                break;
+            }
+        }
+        for (int reg = first; reg < numRegisters && color[node] == SPILLED; reg++) {
+            if (!taken[reg]) {
+                color[node] = reg;
+            }
+        }
+    }
+
+    // Every block of a value has the register of its node
+    for (int node : nodes) {
+        int reg = color[find(node)];
+        for (const liveRange& range : intervals[node].ranges) {
+            allocation.location[intervals[node].value][liveness.blockAt(range.start)] = reg;
+        }
+        if (reg == SPILLED) {
+            allocation.spilled_values++;
+        }
+    }
+    return allocation;
+}
@@ -0,0 +1,19 @@
+/*
+*   Purpose: This is my .h file for the graph coloring register allocator (Chaitin-Briggs). Two values
+*   interfere when their live intervals from computeLiveness overlap. The graph is simplified, phi moves are
+*   coalesced when that keeps it colorable, and nodes that cannot be simplified are pushed as potential
+*   spills, so they are only spilled if select really finds no register left for them.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#ifndef GRAPH_COLORING_H
+#define GRAPH_COLORING_H
+
+#include "register_alloc.h"
+
+// Function that colors the interference graph of a function with numRegisters registers. Every value
+// gets the same location in all of its blocks; values live across a call only get callee-saved registers.
+functionAllocation graphColoring(const functionLiveness& liveness, int numRegisters);
+
+#endif // GRAPH_COLORING_H
@@ -0,0 +1,95 @@
+/*
+*   Purpose: This file implements global value numbering over the dominator tree. A value defined in a
+*   block dominates every later block of the walk that is below it in the tree, so any expression found
+*   in the open scopes can replace a new one with the same key.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#include <stdio.h>
+#include <unordered_map>
+#include <vector>
+#include "gvn.h"
+
+void ScopedExpressionTable::enterScope() {
+    scopeMarks.push_back(log.size());
+}
+
+void ScopedExpressionTable::exitScope() {
+    // undo every entry made in the scope, newest first
+    size_t mark = scopeMarks.back();
+    scopeMarks.pop_back();
+    while (log.size() > mark) {
+        const entry& e = log.back();
+        if (e.shadowed == NULL) {
+            table.erase(e.key);
+        } else {
+            table[e.key] = e.shadowed;
+        }
+        log.pop_back();
+    }
+}
+
+LLVMValueRef ScopedExpressionTable::lookup(const InstructionKey& key) const {
+    auto it = table.find(key);
+    return it == table.end() ? NULL : it->second;
+}
+
+void ScopedExpressionTable::insert(const InstructionKey& key, LLVMValueRef value) {
+    LLVMValueRef& slot = table[key];
+    log.push_back({key, slot});
+    slot = value;
+}
+
+unsigned globalValueNumbering(AnalysisManager& analyses, blockWorklist& dirty) {
+    const std::vector<LLVMBasicBlockRef>& rpo = analyses.reversePostorder();
+    if (rpo.empty()) {
+        return CHANGED_NOTHING;
+    }
+
+    ScopedExpressionTable expressions;
+    unsigned replaced = 0;
+
+    printf("Starting global value numbering\n");
+
+    // Depth first over the dominator tree; each stack entry is a block and the next child to visit
+    std::vector<std::pair<LLVMBasicBlockRef, size_t>> stack;
+    stack.push_back({rpo[0], 0});
+    expressions.enterScope();
+    while (!stack.empty()) {
+        LLVMBasicBlockRef bb = stack.back().first;
+        if (stack.back().second == 0) {
+            // first time here: number the block's instructions in the scope opened for it
+            LLVMValueRef instr = LLVMGetFirstInstruction(bb);
+            while (instr != NULL) {
+                LLVMValueRef nextInstr = LLVMGetNextInstruction(instr);
+                if (isValueNumberable(instr)) {
+                    InstructionKey key(instr);
+                    LLVMValueRef available = expressions.lookup(key);
+                    if (available != NULL) {
+                        markUsersDirty(instr, dirty);
+                        LLVMReplaceAllUsesWith(instr, available);
+                        LLVMInstructionEraseFromParent(instr);
+                        replaced++;
+                    } else {
+                        expressions.insert(key, instr);
+                    }
+                }
+                instr = nextInstr;
+            }
+        }
+
+        const std::vector<LLVMBasicBlockRef>& children = analyses.dominatorChildren(bb);
+        if (stack.back().second < children.size()) {
+            LLVMBasicBlockRef child = children[stack.back().second++];
+            expressions.enterScope();
+            stack.push_back({child, 0});
+        } else {
+            expressions.exitScope();
+            stack.pop_back();
+        }
+    }
+
+    printf("Finished global value numbering, %u instructions replaced\n", replaced);
+    return replaced ? CHANGED_VALUES : CHANGED_NOTHING;
+}
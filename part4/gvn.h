@@ -0,0 +1,54 @@
+/*
+*   Purpose: This is the .h file for global value numbering. The pass walks the dominator tree with a
+*   scoped table of the expressions computed so far, so an expression computed in a block is reused by
+*   every block it dominates: a loop header's comparison in the loop body, or the operands of an if in
+*   both of its branches.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#ifndef GVN_H
+#define GVN_H
+
+#include <llvm-c/Core.h>
+#include <unordered_map>
+#include <vector>
+#include "llvm_parser.h"
+
+/*
+* Expression table scoped by the dominator tree. Entering a block opens a
+* scope, leaving it undoes every entry made in it (restoring the ones it
+* shadowed), the same undo log the symbol table of the semantic analysis uses.
+*/
+class ScopedExpressionTable {
+public:
+    void enterScope();
+    void exitScope();
+
+    // Value already computing key in an open scope, or NULL
+    LLVMValueRef lookup(const InstructionKey& key) const;
+
+    // Makes value the one computing key until the current scope is left
+    void insert(const InstructionKey& key, LLVMValueRef value);
+
+private:
+    struct entry {
+        InstructionKey key;
+        LLVMValueRef shadowed;  // previous value of the key, or NULL
+    };
+    std::unordered_map<InstructionKey, LLVMValueRef, InstructionKeyHash> table;
+    std::vector<entry> log;
+    std::vector<size_t> scopeMarks;
+};
+
+/**
+ *
+ * Replaces every pure expression (see isValueNumberable) that a dominating block already computes by
+ * that earlier value. Loads are left to the local CSE and the reaching definitions, since a store may sit
+ * on a path between the two blocks. Blocks of the users of replaced values are queued on dirty.
+ *
+ * returns: the irChange kinds made, CHANGED_VALUES or CHANGED_NOTHING
+ */
+unsigned globalValueNumbering(AnalysisManager& analyses, blockWorklist& dirty);
+
+#endif // GVN_H
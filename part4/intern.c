@@ -0,0 +1,148 @@
+/*
+*   Purpose: This file implements the identifier interning table. Names are copied once into large
+*   character chunks and looked up through an open-addressing hash table of symbol IDs, so the lexer,
+*   AST, semantic analysis and IR builder can compare and hash 32-bit IDs instead of strings.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#include "intern.h"
+#include "compilation_context.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define INTERN_CHUNK_SIZE 65536
+
+struct internTable {
+    std::vector<const char*> names;   // spelling of each symbol, indexed by ID
+    std::vector<uint32_t> lengths;
+    std::vector<uint32_t> hashes;
+    std::vector<symbolId> slots;      // hash slots, SYM_NONE marks an empty slot
+    std::vector<char*> chunks;        // storage behind names
+    char* chunkPos = NULL;
+    size_t chunkLeft = 0;
+
+    ~internTable() {
+        for (char* chunk : chunks) {
+            free(chunk);
+        }
+    }
+};
+
+// Table of the compilation running on this thread
+static internTable& currentTable() {
+    CompilationContext* ctx = currentCompilation();
+    if (ctx == NULL) {
+        fprintf(stderr, "Error: no compilation context is set\n");
+        exit(EXIT_FAILURE);
+    }
+    return *ctx->names;
+}
+
+// FNV-1a over the bytes of the name
+static uint32_t hashName(const char* name, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Copies name into chunk storage and NUL-terminates it
+static const char* storeName(internTable& table, const char* name, size_t len) {
+    if (table.chunkLeft < len + 1) {
+        size_t size = (len + 1 > INTERN_CHUNK_SIZE) ? len + 1 : INTERN_CHUNK_SIZE;
+        table.chunkPos = (char*)malloc(size);
+        if (table.chunkPos == NULL) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        table.chunks.push_back(table.chunkPos);
+        table.chunkLeft = size;
+    }
+    char* stored = table.chunkPos;
+    memcpy(stored, name, len);
+    stored[len] = '\0';
+    table.chunkPos += len + 1;
+    table.chunkLeft -= len + 1;
+    return stored;
+}
+
+// Places id in the first free slot of its probe sequence
+static void insertSlot(internTable& table, symbolId id) {
+    size_t mask = table.slots.size() - 1;
+    size_t i = table.hashes[id] & mask;
+    while (table.slots[i] != SYM_NONE) {
+        i = (i + 1) & mask;
+    }
+    table.slots[i] = id;
+}
+
+// Doubles the hash table once it is half full
+static void growSlots(internTable& table) {
+    table.slots.assign(table.slots.size() * 2, SYM_NONE);
+    for (symbolId id = 1; id < table.names.size(); id++) {
+        insertSlot(table, id);
+    }
+}
+
+static symbolId addName(internTable& table, const char* name, size_t len, uint32_t hash) {
+    symbolId id = (symbolId)table.names.size();
+    table.names.push_back(storeName(table, name, len));
+    table.lengths.push_back((uint32_t)len);
+    table.hashes.push_back(hash);
+    if (table.names.size() * 2 > table.slots.size()) {
+        growSlots(table);
+    } else {
+        insertSlot(table, id);
+    }
+    return id;
+}
+
+internTable* newInternTable() {
+    // Every table starts with the empty name and the predefined symbols
+    internTable* table = new internTable();
+    table->slots.assign(1024, SYM_NONE);
+    table->names.push_back("");
+    table->lengths.push_back(0);
+    table->hashes.push_back(0);
+    addName(*table, "print", 5, hashName("print", 5));
+    addName(*table, "read", 4, hashName("read", 4));
+    return table;
+}
+
+void deleteInternTable(internTable* table) {
+    delete table;
+}
+
+symbolId internName(const char* name, size_t len) {
+    if (len == 0) {
+        return SYM_NONE;
+    }
+
+    internTable& table = currentTable();
+    uint32_t hash = hashName(name, len);
+    size_t mask = table.slots.size() - 1;
+    for (size_t i = hash & mask; table.slots[i] != SYM_NONE; i = (i + 1) & mask) {
+        symbolId id = table.slots[i];
+        if (table.hashes[id] == hash && table.lengths[id] == len && memcmp(table.names[id], name, len) == 0) {
+            return id;
+        }
+    }
+    return addName(table, name, len, hash);
+}
+
+symbolId internName(const char* name) {
+    return internName(name, strlen(name));
+}
+
+const char* symbolName(symbolId id) {
+    return currentTable().names[id];
+}
+
+size_t symbolCount() {
+    return currentTable().names.size();
+}
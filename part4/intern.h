@@ -0,0 +1,44 @@
+/*
+*   Purpose: This is the .h file for the identifier interning table. Every distinct name in the
+*   program is stored once and referred to everywhere else by a 32-bit symbol ID.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <cstddef>
+#include <cstdint>
+
+typedef uint32_t symbolId;
+
+/*
+* Symbols every table starts with, so the phases can compare against the
+* extern functions without interning their names first.
+*/
+enum {
+    SYM_NONE = 0,   // the empty name, used for "no symbol"
+    SYM_PRINT,      // "print"
+    SYM_READ        // "read"
+};
+
+/*
+* Each compilation has its own table (see compilation_context.h); the
+* functions below work on the table of the calling thread's compilation.
+*/
+struct internTable;
+internTable* newInternTable();
+void deleteInternTable(internTable* table);
+
+// Returns the ID of the name[0..len), adding it to the table the first time it is seen
+symbolId internName(const char* name, size_t len);
+symbolId internName(const char* name);
+
+// Returns the NUL-terminated spelling of id. The pointer stays valid for the life of the table.
+const char* symbolName(symbolId id);
+
+// Number of symbols interned so far (IDs are dense in [0, symbolCount()))
+size_t symbolCount();
+
+#endif // INTERN_H
@@ -0,0 +1,113 @@
+/*
+*   Purpose: This file implements loop-invariant code motion. An instruction is invariant when it is pure and
+*   every operand is a constant, an argument, defined outside the loop, or invariant itself. A load is
+*   invariant when it reads an alloca that is only ever loaded from and stored to, and the loop has no store
+*   to it. Hoisting never moves anything that can trap: division is only moved by a nonzero constant.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#include <stdio.h>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "licm.h"
+
+// Function to check that an instruction can run on every path through the preheader without trapping
+static bool isSafeToSpeculate(LLVMValueRef instr) {
+    switch (LLVMGetInstructionOpcode(instr)) {
+        case LLVMSDiv:
+        case LLVMUDiv:
+        case LLVMSRem:
+        case LLVMURem: {
+            LLVMValueRef divisor = LLVMGetOperand(instr, 1);
+            return LLVMIsAConstantInt(divisor) && LLVMConstIntGetZExtValue(divisor) != 0;
+        }
+        default:
+            return true;
+    }
+}
+
+// Function to hoist the invariant instructions of one loop into its preheader. Returns how many moved.
+static unsigned hoistLoop(const naturalLoop& loop, LLVMBuilderRef builder, blockWorklist& dirty) {
+    // Addresses the loop stores to
+    std::unordered_set<LLVMValueRef> storedAddresses;
+    for (LLVMBasicBlockRef bb : loop.blocks) {
+        for (LLVMValueRef instr = LLVMGetFirstInstruction(bb); instr != NULL; instr = LLVMGetNextInstruction(instr)) {
+            if (LLVMGetInstructionOpcode(instr) == LLVMStore) {
+                storedAddresses.insert(LLVMGetOperand(instr, 1));
+            }
+        }
+    }
+
+    unsigned hoisted = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        // Blocks in reverse postorder, so an invariant operand is usually hoisted before its user
+        for (LLVMBasicBlockRef bb : loop.blocks) {
+            LLVMValueRef instr = LLVMGetFirstInstruction(bb);
+            while (instr != NULL) {
+                LLVMValueRef nextInstr = LLVMGetNextInstruction(instr);
+
+                bool candidate = false;
+                if (LLVMGetInstructionOpcode(instr) == LLVMLoad) {
+                    LLVMValueRef address = LLVMGetOperand(instr, 0);
+                    candidate = isLocalVariable(address) && storedAddresses.count(address) == 0;
+                } else {
+                    candidate = isValueNumberable(instr) && isSafeToSpeculate(instr);
+                }
+
+                // every operand has to be available in the preheader
+                for (int i = 0; candidate && i < LLVMGetNumOperands(instr); i++) {
+                    LLVMValueRef operand = LLVMGetOperand(instr, i);
+                    if (LLVMIsAInstruction(operand) && loop.members.count(LLVMGetInstructionParent(operand))) {
+                        candidate = false;
+                    }
+                }
+
+                if (candidate) {
+                    std::string name = LLVMGetValueName(instr);
+                    LLVMPositionBuilderBefore(builder, LLVMGetBasicBlockTerminator(loop.preheader));
+                    LLVMInstructionRemoveFromParent(instr);
+                    LLVMInsertIntoBuilderWithName(builder, instr, name.c_str());
+                    dirty.push(loop.preheader);
+                    markUsersDirty(instr, dirty);
+                    hoisted++;
+                    changed = true;
+                }
+                instr = nextInstr;
+            }
+        }
+    }
+    return hoisted;
+}
+
+unsigned hoistLoopInvariants(AnalysisManager& analyses, blockWorklist& dirty) {
+    unsigned changes = CHANGED_NOTHING;
+    if (insertPreheaders(analyses)) {
+        changes |= CHANGED_CFG;
+        // new preheaders have nothing to optimize yet, but the headers' phis were rebuilt
+        for (const naturalLoop& loop : analyses.loops()) {
+            dirty.push(loop.header);
+        }
+    }
+
+    LLVMValueRef function = analyses.function();
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(LLVMGetModuleContext(LLVMGetGlobalParent(function)));
+    unsigned hoisted = 0;
+    // Innermost first: what leaves an inner loop lands in a block of the outer one and may leave that too.
+    // Moving instructions does not change the CFG, so the loops stay valid the whole time.
+    for (const naturalLoop& loop : analyses.loops()) {
+        if (loop.preheader != NULL) {
+            hoisted += hoistLoop(loop, builder, dirty);
+        }
+    }
+    LLVMDisposeBuilder(builder);
+
+    printf("LICM hoisted %u instructions out of %zu loops\n", hoisted, analyses.loops().size());
+    if (hoisted > 0) {
+        changes |= CHANGED_VALUES;
+    }
+    return changes;
+}
@@ -0,0 +1,25 @@
+/*
+*   Purpose: This is the .h file for loop-invariant code motion. Pure arithmetic whose operands do not change
+*   inside a loop, and loads of variables the loop never stores to, are moved to the loop's preheader so
+*   they run once instead of on every iteration.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#ifndef LICM_H
+#define LICM_H
+
+#include <llvm-c/Core.h>
+#include "llvm_parser.h"
+
+/**
+ *
+ * Gives every loop a preheader, then hoists the invariant instructions of each loop, innermost loop first,
+ * so an instruction can leave several nested loops in one call. Blocks of the moved instructions' users
+ * are queued on dirty.
+ *
+ * returns: the irChange kinds made
+ */
+unsigned hoistLoopInvariants(AnalysisManager& analyses, blockWorklist& dirty);
+
+#endif // LICM_H
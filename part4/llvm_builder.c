@@ -9,71 +9,77 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
-#include <map>
+#include <vector>
 #include <string>
 #include "ast.h"
-#include "preprocessor.h"
-
-// Global maps and variables
-std::map<std::string, LLVMValueRef> var_map;
-LLVMValueRef ret_ref;
-LLVMBasicBlockRef retBB;
+#include "compact_ast.h"
+#include "compilation_context.h"
 
 // Function Prototypes
-LLVMBasicBlockRef genIRStmt(LLVMModuleRef mod, astNode* stmt, LLVMBuilderRef builder, LLVMBasicBlockRef startBB);
-LLVMValueRef genIRExpr(LLVMModuleRef mod, astNode* expr, LLVMBuilderRef builder);
+LLVMBasicBlockRef genIRStmt(CompilationContext& ctx, LLVMModuleRef mod, astNode* stmt, LLVMBuilderRef builder, LLVMBasicBlockRef startBB);
+LLVMValueRef genIRExpr(CompilationContext& ctx, LLVMModuleRef mod, astNode* expr, LLVMBuilderRef builder);
 LLVMValueRef createBinaryOp(LLVMBuilderRef builder, op_type op, LLVMValueRef lhs, LLVMValueRef rhs);
+LLVMBasicBlockRef genIRStmtCompact(CompilationContext& ctx, LLVMModuleRef mod, const compactAst& ast, nodeIndex stmt, LLVMBuilderRef builder, LLVMBasicBlockRef startBB);
+LLVMValueRef genIRExprCompact(CompilationContext& ctx, LLVMModuleRef mod, const compactAst& ast, nodeIndex expr, LLVMBuilderRef builder);
 
-void rename_variables(astNode* node);
+// Function to build a call to the function of mod named name, with the function type LLVMBuildCall2 needs
+static LLVMValueRef buildCall(LLVMModuleRef mod, LLVMBuilderRef builder, const char* name, LLVMValueRef* args, unsigned numArgs) {
+    LLVMValueRef fn = LLVMGetNamedFunction(mod, name);
+    return LLVMBuildCall2(builder, LLVMGlobalGetValueType(fn), fn, args, numArgs, "");
+}
 
-LLVMValueRef functionTraversal(LLVMModuleRef mod, astNode* funcNode) {
+LLVMValueRef functionTraversal(CompilationContext& ctx, LLVMModuleRef mod, astNode* funcNode, bool ssa) {
     printf("Starting functionTraversal\n");
 
-    LLVMBuilderRef builder = LLVMCreateBuilder();
-    LLVMTypeRef int32Type = LLVMInt32Type();
-    LLVMTypeRef funcType = LLVMFunctionType(int32Type, NULL, 0, 0);
-    LLVMValueRef func = LLVMAddFunction(mod, funcNode->func.name, funcType);
-    LLVMBasicBlockRef entryBB = LLVMAppendBasicBlock(func, "entry");
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(ctx.llvm);
+    LLVMTypeRef int32Type = LLVMInt32TypeInContext(ctx.llvm);
+    LLVMTypeRef funcType = LLVMFunctionType(int32Type, &int32Type, funcNode->func.param ? 1 : 0, 0);
+    LLVMValueRef func = LLVMAddFunction(mod, symbolName(funcNode->func.name), funcType);
+    LLVMBasicBlockRef entryBB = LLVMAppendBasicBlockInContext(ctx.llvm, func, "entry");
     LLVMPositionBuilderAtEnd(builder, entryBB);
 
-    // Initialize var_map for parameters and local variables
+    // One slot per declaration in the function, numbered by semantic analysis, plus one for the return value
+    ctx.ret_slot = funcNode->func.num_slots;
+    beginLocals(ctx.locals, func, ctx.ret_slot + 1, ssa);
+    sealBlock(ctx.locals, entryBB);
+
+    // Initialize the parameter's slot; local variables get theirs at their declaration
     if (funcNode->func.param) {
-        char* param_name = funcNode->func.param->var.name;
-        LLVMValueRef param = LLVMGetParam(func, 0);
-        LLVMValueRef alloc = LLVMBuildAlloca(builder, int32Type, param_name);
-        LLVMBuildStore(builder, param, alloc);
-        var_map[param_name] = alloc;
+        astNode* param_node = funcNode->func.param;
+        declareLocal(ctx.locals, param_node->var.slot, symbolName(param_node->var.name));
+        writeLocal(ctx.locals, builder, param_node->var.slot, LLVMGetParam(func, 0));
     }
 
-    // Initialize ret_ref and retBB
-    ret_ref = LLVMBuildAlloca(builder, int32Type, "ret_val");
-    retBB = LLVMAppendBasicBlock(func, "return");
+    // Initialize the return slot and block
+    declareLocal(ctx.locals, ctx.ret_slot, "ret_val");
+    ctx.retBB = LLVMAppendBasicBlockInContext(ctx.llvm, func, "return");
 
     // Generate IR for the function body
     if (funcNode->func.body) {
         printf("Generating IR for function body\n");
-        LLVMBasicBlockRef exitBB = genIRStmt(mod, funcNode->func.body, builder, entryBB);
-        // If the last block has no terminator, add a branch to retBB
+        LLVMBasicBlockRef exitBB = genIRStmt(ctx, mod, funcNode->func.body, builder, entryBB);
+        // If the last block has no terminator, add a branch to the return block
         if (!LLVMGetBasicBlockTerminator(exitBB)) {
             LLVMPositionBuilderAtEnd(builder, exitBB);
-            LLVMBuildBr(builder, retBB);
+            branchTo(ctx.locals, builder, ctx.retBB);
         }
     }
 
-    // Generate return block
-    LLVMPositionBuilderAtEnd(builder, retBB);
-    LLVMValueRef ret_val = LLVMBuildLoad2(builder, int32Type, ret_ref, "");
+    // Generate return block; every return has branched to it by now
+    sealBlock(ctx.locals, ctx.retBB);
+    LLVMPositionBuilderAtEnd(builder, ctx.retBB);
+    LLVMValueRef ret_val = readLocal(ctx.locals, builder, ctx.ret_slot);
     LLVMBuildRet(builder, ret_val);
 
     // Clean up
     LLVMDisposeBuilder(builder);
-    var_map.clear();
+    endLocals(ctx.locals);
     printf("Completed functionTraversal\n");
     return func;
 }
 
 // This is the basic block where the subroutine starts adding LLVM IR instructions
-LLVMBasicBlockRef genIRStmt(LLVMModuleRef mod, astNode* stmt, LLVMBuilderRef builder, LLVMBasicBlockRef startBB) {
+LLVMBasicBlockRef genIRStmt(CompilationContext& ctx, LLVMModuleRef mod, astNode* stmt, LLVMBuilderRef builder, LLVMBasicBlockRef startBB) {
     printf("Generating IR for statement\n");
     LLVMPositionBuilderAtEnd(builder, startBB);
 
@@ -82,22 +88,20 @@ LLVMBasicBlockRef genIRStmt(LLVMModuleRef mod, astNode* stmt, LLVMBuilderRef bui
         case ast_asgn: {
             printf("Generating IR for assignment\n");
             LLVMPositionBuilderAtEnd(builder, startBB); // Set the position of the builder
-            LLVMValueRef rhs = genIRExpr(mod, stmt->stmt.asgn.rhs, builder); // Generate LLVMValueRef of RHS
-            LLVMValueRef lhs = var_map[stmt->stmt.asgn.lhs->var.name]; // Retrieve LHS memory location
-            LLVMBuildStore(builder, rhs, lhs); // Generate store instruction
+            LLVMValueRef rhs = genIRExpr(ctx, mod, stmt->stmt.asgn.rhs, builder); // Generate LLVMValueRef of RHS
+            writeLocal(ctx.locals, builder, stmt->stmt.asgn.lhs->var.slot, rhs); // Store to the LHS slot
             return startBB; // Return startBB as endBB
         }
         // call nodes
         case ast_call: {
             printf("Generating IR for function call\n");
-            LLVMValueRef value = stmt->stmt.call.param ? genIRExpr(mod, stmt->stmt.call.param, builder) : NULL;
-            if (strcmp(stmt->stmt.call.name, "print") == 0) {
-                // Generate LLVMValueRef of the value being printed
-                LLVMValueRef printValue = genIRExpr(mod, stmt->stmt.call.param, builder);
+            // Generate LLVMValueRef of the argument once, before the call
+            LLVMValueRef value = stmt->stmt.call.param ? genIRExpr(ctx, mod, stmt->stmt.call.param, builder) : NULL;
+            if (stmt->stmt.call.name == SYM_PRINT) {
                 // Generate a Call instruction to the print function with the value as a parameter
-                LLVMBuildCall(builder, LLVMGetNamedFunction(mod, "print"), &printValue, 1, "");
+                buildCall(mod, builder, "print", &value, 1);
             } else {
-                LLVMBuildCall(builder, LLVMGetNamedFunction(mod, stmt->stmt.call.name), value ? &value : NULL, value ? 1 : 0, "");
+                buildCall(mod, builder, symbolName(stmt->stmt.call.name), value ? &value : NULL, value ? 1 : 0);
             }
             return startBB;
         }
@@ -108,22 +112,26 @@ LLVMBasicBlockRef genIRStmt(LLVMModuleRef mod, astNode* stmt, LLVMBuilderRef bui
 
             // Set the position of the builder to the end of startBB
             LLVMPositionBuilderAtEnd(builder, startBB);
-            LLVMBasicBlockRef condBB = LLVMAppendBasicBlock(LLVMGetBasicBlockParent(startBB), "cond");
-            LLVMBuildBr(builder, condBB);
+            LLVMBasicBlockRef condBB = LLVMAppendBasicBlockInContext(ctx.llvm, LLVMGetBasicBlockParent(startBB), "cond");
+            branchTo(ctx.locals, builder, condBB);
             LLVMPositionBuilderAtEnd(builder, condBB);
 
-            LLVMValueRef cond = genIRExpr(mod, stmt->stmt.whilen.cond, builder);
-            LLVMBasicBlockRef trueBB = LLVMAppendBasicBlock(LLVMGetBasicBlockParent(startBB), "true");
-            LLVMBasicBlockRef falseBB = LLVMAppendBasicBlock(LLVMGetBasicBlockParent(startBB), "false");
-            LLVMBuildCondBr(builder, cond, trueBB, falseBB);
+            LLVMValueRef cond = genIRExpr(ctx, mod, stmt->stmt.whilen.cond, builder);
+            LLVMBasicBlockRef trueBB = LLVMAppendBasicBlockInContext(ctx.llvm, LLVMGetBasicBlockParent(startBB), "true");
+            LLVMBasicBlockRef falseBB = LLVMAppendBasicBlockInContext(ctx.llvm, LLVMGetBasicBlockParent(startBB), "false");
+            condBranchTo(ctx.locals, builder, cond, trueBB, falseBB);
+            sealBlock(ctx.locals, trueBB);
+            sealBlock(ctx.locals, falseBB);
 
             // Generate the LLVM IR for the while loop body
             LLVMPositionBuilderAtEnd(builder, trueBB);
-            LLVMBasicBlockRef trueExitBB = genIRStmt(mod, stmt->stmt.whilen.body, builder, trueBB);
+            LLVMBasicBlockRef trueExitBB = genIRStmt(ctx, mod, stmt->stmt.whilen.body, builder, trueBB);
             // Set the position of the builder to the end of trueExitBB
             LLVMPositionBuilderAtEnd(builder, trueExitBB);
             // Generate an unconditional branch to condBB at the end of trueExitBB
-            LLVMBuildBr(builder, condBB);
+            branchTo(ctx.locals, builder, condBB);
+            // The back edge was condBB's last predecessor
+            sealBlock(ctx.locals, condBB);
             LLVMPositionBuilderAtEnd(builder, trueBB);
             return falseBB;
         }
@@ -132,37 +140,42 @@ LLVMBasicBlockRef genIRStmt(LLVMModuleRef mod, astNode* stmt, LLVMBuilderRef bui
         case ast_if: {
             printf("Generating IR for if statement\n");
             LLVMPositionBuilderAtEnd(builder, startBB);
-            LLVMValueRef cond = genIRExpr(mod, stmt->stmt.ifn.cond, builder);
+            LLVMValueRef cond = genIRExpr(ctx, mod, stmt->stmt.ifn.cond, builder);
 
             // Generate two basic blocks, trueBB and falseBB
-            LLVMBasicBlockRef trueBB = LLVMAppendBasicBlock(LLVMGetBasicBlockParent(startBB), "true");
-            LLVMBasicBlockRef falseBB = LLVMAppendBasicBlock(LLVMGetBasicBlockParent(startBB), "false");
-            LLVMBuildCondBr(builder, cond, trueBB, falseBB);
+            LLVMBasicBlockRef trueBB = LLVMAppendBasicBlockInContext(ctx.llvm, LLVMGetBasicBlockParent(startBB), "true");
+            LLVMBasicBlockRef falseBB = LLVMAppendBasicBlockInContext(ctx.llvm, LLVMGetBasicBlockParent(startBB), "false");
+            condBranchTo(ctx.locals, builder, cond, trueBB, falseBB);
+            sealBlock(ctx.locals, trueBB);
 
             // Handle the case where there is no else part
             if (!stmt->stmt.ifn.else_body) {
                 LLVMPositionBuilderAtEnd(builder, trueBB);
-                LLVMBasicBlockRef ifExitBB = genIRStmt(mod, stmt->stmt.ifn.if_body, builder, trueBB);
+                LLVMBasicBlockRef ifExitBB = genIRStmt(ctx, mod, stmt->stmt.ifn.if_body, builder, trueBB);
                 LLVMPositionBuilderAtEnd(builder, ifExitBB);
-                LLVMBuildBr(builder, falseBB);
+                branchTo(ctx.locals, builder, falseBB);
+                // falseBB is also the join block, so it is complete only now
+                sealBlock(ctx.locals, falseBB);
                 LLVMPositionBuilderAtEnd(builder, falseBB);
                 return falseBB;
             }
 
             // Handle the case where there is an else part
             else {
+                sealBlock(ctx.locals, falseBB);
                 LLVMPositionBuilderAtEnd(builder, trueBB);
-                LLVMBasicBlockRef ifExitBB = genIRStmt(mod, stmt->stmt.ifn.if_body, builder, trueBB);
+                LLVMBasicBlockRef ifExitBB = genIRStmt(ctx, mod, stmt->stmt.ifn.if_body, builder, trueBB);
                 LLVMPositionBuilderAtEnd(builder, falseBB);
-                LLVMBasicBlockRef elseExitBB = genIRStmt(mod, stmt->stmt.ifn.else_body, builder, falseBB);
-                LLVMBasicBlockRef endBB = LLVMAppendBasicBlock(LLVMGetBasicBlockParent(startBB), "end");
+                LLVMBasicBlockRef elseExitBB = genIRStmt(ctx, mod, stmt->stmt.ifn.else_body, builder, falseBB);
+                LLVMBasicBlockRef endBB = LLVMAppendBasicBlockInContext(ctx.llvm, LLVMGetBasicBlockParent(startBB), "end");
                 LLVMPositionBuilderAtEnd(builder, ifExitBB);
                 // Add an unconditional branch to endBB
-                LLVMBuildBr(builder, endBB);
+                branchTo(ctx.locals, builder, endBB);
                 
                 // Set the position of the builder to the end of elseExitBB
                 LLVMPositionBuilderAtEnd(builder, elseExitBB);
-                LLVMBuildBr(builder, endBB);
+                branchTo(ctx.locals, builder, endBB);
+                sealBlock(ctx.locals, endBB);
                 
                 LLVMPositionBuilderAtEnd(builder, endBB);
                 return endBB;
@@ -172,10 +185,14 @@ LLVMBasicBlockRef genIRStmt(LLVMModuleRef mod, astNode* stmt, LLVMBuilderRef bui
         case ast_ret: {
             printf("Generating IR for return statement\n");
             LLVMPositionBuilderAtEnd(builder, startBB);
-            LLVMValueRef ret_val = genIRExpr(mod, stmt->stmt.ret.expr, builder);
-            LLVMBuildStore(builder, ret_val, ret_ref);
-            LLVMBuildBr(builder, retBB);
-            LLVMBasicBlockRef afterRetBB = LLVMAppendBasicBlock(LLVMGetBasicBlockParent(startBB), "after_ret");
+            if (stmt->stmt.ret.expr) {
+                LLVMValueRef ret_val = genIRExpr(ctx, mod, stmt->stmt.ret.expr, builder);
+                writeLocal(ctx.locals, builder, ctx.ret_slot, ret_val);
+            }
+            branchTo(ctx.locals, builder, ctx.retBB);
+            // Nothing branches to the code after a return
+            LLVMBasicBlockRef afterRetBB = LLVMAppendBasicBlockInContext(ctx.llvm, LLVMGetBasicBlockParent(startBB), "after_ret");
+            sealBlock(ctx.locals, afterRetBB);
             LLVMPositionBuilderAtEnd(builder, afterRetBB);
             return afterRetBB;
         }
@@ -185,10 +202,16 @@ LLVMBasicBlockRef genIRStmt(LLVMModuleRef mod, astNode* stmt, LLVMBuilderRef bui
             // For each statement S in the statement list in the block statement
             for (auto s : *stmt->stmt.block.stmt_list) {
                 // Generate the LLVM IR for S by calling the genIRStmt subroutine recursively
-                prevBB = genIRStmt(mod, s, builder, prevBB);
+                prevBB = genIRStmt(ctx, mod, s, builder, prevBB);
             }
             return prevBB;
         }
+        // declarations: set up the variable's slot (an alloca in the entry block in memory mode)
+        case ast_decl: {
+            printf("Generating IR for declaration\n");
+            declareLocal(ctx.locals, stmt->stmt.decl.slot, symbolName(stmt->stmt.decl.name));
+            return startBB;
+        }
         default:
             fprintf(stderr, "Unknown statement type\n");
             exit(1);
@@ -198,18 +221,18 @@ LLVMBasicBlockRef genIRStmt(LLVMModuleRef mod, astNode* stmt, LLVMBuilderRef bui
 //Input: astNode of the expression, builder reference (this allows the subroutine to add LLVM 
 //instructions in the correct basic block)
 //Output: LLVMValueRef of the expression
-LLVMValueRef genIRExpr(LLVMModuleRef mod, astNode* expr, LLVMBuilderRef builder) {
+LLVMValueRef genIRExpr(CompilationContext& ctx, LLVMModuleRef mod, astNode* expr, LLVMBuilderRef builder) {
     printf("Generating IR for expression\n");
     switch (expr->type) {
         case ast_cnst:
             printf("Generating IR for constant\n");
-            return LLVMConstInt(LLVMInt32Type(), expr->cnst.value, 0);
+            return LLVMConstInt(LLVMInt32TypeInContext(ctx.llvm), expr->cnst.value, 0);
         case ast_var:
             printf("Generating IR for variable\n");
-            return LLVMBuildLoad2(builder, LLVMInt32Type(), var_map[expr->var.name], "");
+            return readLocal(ctx.locals, builder, expr->var.slot);
         case ast_uexpr: {
             printf("Generating IR for unary expression\n");
-            LLVMValueRef operand = genIRExpr(mod, expr->uexpr.expr, builder);
+            LLVMValueRef operand = genIRExpr(ctx, mod, expr->uexpr.expr, builder);
             if (expr->uexpr.op == uminus) {
                 return LLVMBuildNeg(builder, operand, "");
             }
@@ -218,14 +241,14 @@ LLVMValueRef genIRExpr(LLVMModuleRef mod, astNode* expr, LLVMBuilderRef builder)
         // case of binary expressions 
         case ast_bexpr: {
             printf("Generating IR for binary expression\n");
-            LLVMValueRef lhs = genIRExpr(mod, expr->bexpr.lhs, builder);
-            LLVMValueRef rhs = genIRExpr(mod, expr->bexpr.rhs, builder);
+            LLVMValueRef lhs = genIRExpr(ctx, mod, expr->bexpr.lhs, builder);
+            LLVMValueRef rhs = genIRExpr(ctx, mod, expr->bexpr.rhs, builder);
             return createBinaryOp(builder, expr->bexpr.op, lhs, rhs); // calling helper function 
         }
         case ast_rexpr: {
             printf("Generating IR for relational expression\n");
-            LLVMValueRef lhs = genIRExpr(mod, expr->rexpr.lhs, builder);
-            LLVMValueRef rhs = genIRExpr(mod, expr->rexpr.rhs, builder);
+            LLVMValueRef lhs = genIRExpr(ctx, mod, expr->rexpr.lhs, builder);
+            LLVMValueRef rhs = genIRExpr(ctx, mod, expr->rexpr.rhs, builder);
             LLVMIntPredicate pred;
             switch (expr->rexpr.op) {
                 case lt: pred = LLVMIntSLT; break;
@@ -238,9 +261,10 @@ LLVMValueRef genIRExpr(LLVMModuleRef mod, astNode* expr, LLVMBuilderRef builder)
             }
             return LLVMBuildICmp(builder, pred, lhs, rhs, "");
         }
-        case ast_call:
+        // read() is the only call that appears inside an expression; calls are statement nodes
+        case ast_stmt:
             printf("Generating IR for function call expression\n");
-            return LLVMBuildCall(builder, LLVMGetNamedFunction(mod, "read"), NULL, 0, "");
+            return buildCall(mod, builder, "read", NULL, 0);
         default:
             fprintf(stderr, "Unknown expression type\n");
             exit(1);
@@ -260,3 +284,180 @@ LLVMValueRef createBinaryOp(LLVMBuilderRef builder, op_type op, LLVMValueRef lhs
     }
     return NULL;
 }
+
+// Lowers the function at funcNode of the compact AST. Same shape of IR as functionTraversal.
+LLVMValueRef functionTraversalCompact(CompilationContext& ctx, LLVMModuleRef mod, const compactAst& ast, nodeIndex funcNode, bool ssa) {
+    printf("Starting functionTraversalCompact\n");
+
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(ctx.llvm);
+    LLVMTypeRef int32Type = LLVMInt32TypeInContext(ctx.llvm);
+    nodeIndex paramNode = ast.b[funcNode];
+    LLVMTypeRef funcType = LLVMFunctionType(int32Type, &int32Type, paramNode != NO_NODE ? 1 : 0, 0);
+    LLVMValueRef func = LLVMAddFunction(mod, symbolName(ast.a[funcNode]), funcType);
+    LLVMBasicBlockRef entryBB = LLVMAppendBasicBlockInContext(ctx.llvm, func, "entry");
+    LLVMPositionBuilderAtEnd(builder, entryBB);
+
+    // The function's subtree is a contiguous index range, so the parameter and all
+    // local declarations are found with one linear sweep and allocated up front
+    uint32_t num_slots = 0;
+    for (nodeIndex i = funcNode + 1; i < ast.end[funcNode]; i++) {
+        if (i == paramNode || isCompactStmt(ast, i, ast_decl)) {
+            num_slots = ast.b[i] + 1 > num_slots ? ast.b[i] + 1 : num_slots;
+        }
+    }
+    ctx.ret_slot = num_slots;
+    beginLocals(ctx.locals, func, ctx.ret_slot + 1, ssa);
+    sealBlock(ctx.locals, entryBB);
+
+    if (paramNode != NO_NODE) {
+        declareLocal(ctx.locals, ast.b[paramNode], symbolName(ast.a[paramNode]));
+        writeLocal(ctx.locals, builder, ast.b[paramNode], LLVMGetParam(func, 0));
+    }
+    for (nodeIndex i = funcNode + 1; i < ast.end[funcNode]; i++) {
+        if (isCompactStmt(ast, i, ast_decl)) {
+            declareLocal(ctx.locals, ast.b[i], symbolName(ast.a[i]));
+        }
+    }
+
+    // Initialize the return slot and block
+    declareLocal(ctx.locals, ctx.ret_slot, "ret_val");
+    ctx.retBB = LLVMAppendBasicBlockInContext(ctx.llvm, func, "return");
+
+    // Generate IR for the function body
+    LLVMBasicBlockRef exitBB = genIRStmtCompact(ctx, mod, ast, ast.c[funcNode], builder, entryBB);
+    if (!LLVMGetBasicBlockTerminator(exitBB)) {
+        LLVMPositionBuilderAtEnd(builder, exitBB);
+        branchTo(ctx.locals, builder, ctx.retBB);
+    }
+
+    // Generate return block
+    sealBlock(ctx.locals, ctx.retBB);
+    LLVMPositionBuilderAtEnd(builder, ctx.retBB);
+    LLVMValueRef ret_val = readLocal(ctx.locals, builder, ctx.ret_slot);
+    LLVMBuildRet(builder, ret_val);
+
+    // Clean up
+    LLVMDisposeBuilder(builder);
+    endLocals(ctx.locals);
+    printf("Completed functionTraversalCompact\n");
+    return func;
+}
+
+LLVMBasicBlockRef genIRStmtCompact(CompilationContext& ctx, LLVMModuleRef mod, const compactAst& ast, nodeIndex stmt, LLVMBuilderRef builder, LLVMBasicBlockRef startBB) {
+    LLVMPositionBuilderAtEnd(builder, startBB);
+    LLVMValueRef func = LLVMGetBasicBlockParent(startBB);
+
+    switch (ast.stmt[stmt]) {
+        case ast_asgn: {
+            LLVMValueRef rhs = genIRExprCompact(ctx, mod, ast, ast.b[stmt], builder);
+            writeLocal(ctx.locals, builder, ast.b[ast.a[stmt]], rhs);
+            return startBB;
+        }
+        case ast_call: {
+            LLVMValueRef value = ast.b[stmt] != NO_NODE ? genIRExprCompact(ctx, mod, ast, ast.b[stmt], builder) : NULL;
+            buildCall(mod, builder, symbolName(ast.a[stmt]), value ? &value : NULL, value ? 1 : 0);
+            return startBB;
+        }
+        case ast_while: {
+            LLVMBasicBlockRef condBB = LLVMAppendBasicBlockInContext(ctx.llvm, func, "cond");
+            branchTo(ctx.locals, builder, condBB);
+            LLVMPositionBuilderAtEnd(builder, condBB);
+            LLVMValueRef cond = genIRExprCompact(ctx, mod, ast, ast.a[stmt], builder);
+            LLVMBasicBlockRef trueBB = LLVMAppendBasicBlockInContext(ctx.llvm, func, "true");
+            LLVMBasicBlockRef falseBB = LLVMAppendBasicBlockInContext(ctx.llvm, func, "false");
+            condBranchTo(ctx.locals, builder, cond, trueBB, falseBB);
+            sealBlock(ctx.locals, trueBB);
+            sealBlock(ctx.locals, falseBB);
+
+            LLVMBasicBlockRef trueExitBB = genIRStmtCompact(ctx, mod, ast, ast.b[stmt], builder, trueBB);
+            LLVMPositionBuilderAtEnd(builder, trueExitBB);
+            branchTo(ctx.locals, builder, condBB);
+            sealBlock(ctx.locals, condBB);
+            return falseBB;
+        }
+        case ast_if: {
+            LLVMValueRef cond = genIRExprCompact(ctx, mod, ast, ast.a[stmt], builder);
+            LLVMBasicBlockRef trueBB = LLVMAppendBasicBlockInContext(ctx.llvm, func, "true");
+            LLVMBasicBlockRef falseBB = LLVMAppendBasicBlockInContext(ctx.llvm, func, "false");
+            condBranchTo(ctx.locals, builder, cond, trueBB, falseBB);
+            sealBlock(ctx.locals, trueBB);
+
+            LLVMBasicBlockRef ifExitBB = genIRStmtCompact(ctx, mod, ast, ast.b[stmt], builder, trueBB);
+            if (ast.c[stmt] == NO_NODE) {
+                LLVMPositionBuilderAtEnd(builder, ifExitBB);
+                branchTo(ctx.locals, builder, falseBB);
+                sealBlock(ctx.locals, falseBB);
+                return falseBB;
+            }
+            sealBlock(ctx.locals, falseBB);
+            LLVMBasicBlockRef elseExitBB = genIRStmtCompact(ctx, mod, ast, ast.c[stmt], builder, falseBB);
+            LLVMBasicBlockRef endBB = LLVMAppendBasicBlockInContext(ctx.llvm, func, "end");
+            LLVMPositionBuilderAtEnd(builder, ifExitBB);
+            branchTo(ctx.locals, builder, endBB);
+            LLVMPositionBuilderAtEnd(builder, elseExitBB);
+            branchTo(ctx.locals, builder, endBB);
+            sealBlock(ctx.locals, endBB);
+            return endBB;
+        }
+        case ast_ret: {
+            if (ast.a[stmt] != NO_NODE) {
+                writeLocal(ctx.locals, builder, ctx.ret_slot, genIRExprCompact(ctx, mod, ast, ast.a[stmt], builder));
+            }
+            branchTo(ctx.locals, builder, ctx.retBB);
+            LLVMBasicBlockRef afterRetBB = LLVMAppendBasicBlockInContext(ctx.llvm, func, "after_ret");
+            sealBlock(ctx.locals, afterRetBB);
+            return afterRetBB;
+        }
+        case ast_block: {
+            // the statements of a block are a contiguous range of ast.stmts
+            LLVMBasicBlockRef prevBB = startBB;
+            for (uint32_t k = ast.a[stmt]; k < ast.a[stmt] + ast.b[stmt]; k++) {
+                prevBB = genIRStmtCompact(ctx, mod, ast, ast.stmts[k], builder, prevBB);
+            }
+            return prevBB;
+        }
+        case ast_decl:
+            // allocated up front by functionTraversalCompact
+            return startBB;
+        default:
+            fprintf(stderr, "Unknown statement type\n");
+            exit(1);
+    }
+}
+
+LLVMValueRef genIRExprCompact(CompilationContext& ctx, LLVMModuleRef mod, const compactAst& ast, nodeIndex expr, LLVMBuilderRef builder) {
+    switch (ast.kind[expr]) {
+        case ast_cnst:
+            return LLVMConstInt(LLVMInt32TypeInContext(ctx.llvm), (int)ast.a[expr], 0);
+        case ast_var:
+            return readLocal(ctx.locals, builder, ast.b[expr]);
+        case ast_uexpr:
+            return LLVMBuildNeg(builder, genIRExprCompact(ctx, mod, ast, ast.a[expr], builder), "");
+        case ast_bexpr: {
+            LLVMValueRef lhs = genIRExprCompact(ctx, mod, ast, ast.a[expr], builder);
+            LLVMValueRef rhs = genIRExprCompact(ctx, mod, ast, ast.b[expr], builder);
+            return createBinaryOp(builder, (op_type)ast.op[expr], lhs, rhs);
+        }
+        case ast_rexpr: {
+            LLVMValueRef lhs = genIRExprCompact(ctx, mod, ast, ast.a[expr], builder);
+            LLVMValueRef rhs = genIRExprCompact(ctx, mod, ast, ast.b[expr], builder);
+            LLVMIntPredicate pred;
+            switch ((rop_type)ast.op[expr]) {
+                case lt: pred = LLVMIntSLT; break;
+                case gt: pred = LLVMIntSGT; break;
+                case le: pred = LLVMIntSLE; break;
+                case ge: pred = LLVMIntSGE; break;
+                case eq: pred = LLVMIntEQ; break;
+                case neq: pred = LLVMIntNE; break;
+                default: assert(0 && "Unknown comparison operator");
+            }
+            return LLVMBuildICmp(builder, pred, lhs, rhs, "");
+        }
+        case ast_stmt:
+            // read() is the only call that appears inside an expression
+            return buildCall(mod, builder, "read", NULL, 0);
+        default:
+            fprintf(stderr, "Unknown expression type\n");
+            exit(1);
+    }
+}
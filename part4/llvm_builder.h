@@ -13,23 +13,25 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
-#include <map>
+#include <vector>
 #include <string>
 #include "ast.h"
-#include "preprocessor.h"
+#include "compact_ast.h"
+#include "compilation_context.h"
 
-// Global maps and variables
-extern std::map<std::string, LLVMValueRef> var_map;
-extern LLVMValueRef ret_ref;
-extern LLVMBasicBlockRef retBB;
+// The builder keeps no globals: locals, the return slot and the return block are in the compilation context
 
 // Function Prototypes
-LLVMBasicBlockRef genIRStmt(LLVMModuleRef mod, astNode* stmt, LLVMBuilderRef builder, LLVMBasicBlockRef startBB);
-LLVMValueRef genIRExpr(LLVMModuleRef mod, astNode* expr, LLVMBuilderRef builder);
+LLVMBasicBlockRef genIRStmt(CompilationContext& ctx, LLVMModuleRef mod, astNode* stmt, LLVMBuilderRef builder, LLVMBasicBlockRef startBB);
+LLVMValueRef genIRExpr(CompilationContext& ctx, LLVMModuleRef mod, astNode* expr, LLVMBuilderRef builder);
 LLVMValueRef createBinaryOp(LLVMBuilderRef builder, op_type op, LLVMValueRef lhs, LLVMValueRef rhs);
 
-void rename_variables(astNode* node);
+// With ssa set, locals are kept in registers and phi nodes instead of allocas
+LLVMValueRef functionTraversal(CompilationContext& ctx, LLVMModuleRef mod, astNode* funcNode, bool ssa);
 
-LLVMValueRef functionTraversal(LLVMModuleRef mod, astNode* funcNode);
+// Same lowering over the compact AST, walking children by index
+LLVMValueRef functionTraversalCompact(CompilationContext& ctx, LLVMModuleRef mod, const compactAst& ast, nodeIndex funcNode, bool ssa);
+LLVMBasicBlockRef genIRStmtCompact(CompilationContext& ctx, LLVMModuleRef mod, const compactAst& ast, nodeIndex stmt, LLVMBuilderRef builder, LLVMBasicBlockRef startBB);
+LLVMValueRef genIRExprCompact(CompilationContext& ctx, LLVMModuleRef mod, const compactAst& ast, nodeIndex expr, LLVMBuilderRef builder);
 
 #endif // LLVM_BUILDER_H
@@ -21,13 +21,20 @@
 #include <vector>
 #include <functional>
 #include <cstddef>
+#include <utility>
 #include "llvm_parser.h"
+#include "gvn.h"
+#include "licm.h"
+#include "mem2reg.h"
+#include "sccp.h"
+#include "scev.h"
+#include "adce.h"
 
 
 #define prt(x) if(x) { printf("%s\n", x); }
 
-// Function to read the given LLVM file and load the LLVM IR into data structures for optimization
-LLVMModuleRef createLLVMModel(char *filename){
+// Function to read the given LLVM file into a module of context and load the LLVM IR into data structures for optimization
+LLVMModuleRef createLLVMModel(LLVMContextRef context, char *filename){
     char *err = NULL;
     LLVMMemoryBufferRef ll_f = NULL;
     LLVMModuleRef m = NULL;
@@ -36,7 +43,7 @@ LLVMModuleRef createLLVMModel(char *filename){
         prt(err);
         return NULL;
     }
-    LLVMParseIRInContext(LLVMGetGlobalContext(), ll_f, &m, &err);
+    LLVMParseIRInContext(context, ll_f, &m, &err);
     if (err != NULL) {
         prt(err);
     }
@@ -74,45 +81,197 @@ predMap buildPredMap(LLVMValueRef function) {
     return predecessors;
 }
 
-// Function to perform Common Subexpression Elimination (commonSubExprx) on a basic block
-bool commonSubExprx(LLVMBasicBlockRef basicBlock) {
-    if (basicBlock == NULL) {
-        printf("Has to skip a basic block in commonSubExprx.\n");
+// Function to give the predicate that compares the same way with the operands swapped
+static LLVMIntPredicate swappedPredicate(LLVMIntPredicate predicate) {
+    switch (predicate) {
+        case LLVMIntSGT: return LLVMIntSLT;
+        case LLVMIntSLT: return LLVMIntSGT;
+        case LLVMIntSGE: return LLVMIntSLE;
+        case LLVMIntSLE: return LLVMIntSGE;
+        case LLVMIntUGT: return LLVMIntULT;
+        case LLVMIntULT: return LLVMIntUGT;
+        case LLVMIntUGE: return LLVMIntULE;
+        case LLVMIntULE: return LLVMIntUGE;
+        default: return predicate;  // eq and ne
+    }
+}
+
+InstructionKey::InstructionKey(LLVMValueRef instr) {
+    opcode = LLVMGetInstructionOpcode(instr);
+    predicate = opcode == LLVMICmp ? (int)LLVMGetICmpPredicate(instr) : 0;
+    type = LLVMTypeOf(instr);
+    int operandCount = LLVMGetNumOperands(instr);
+    operand1 = (operandCount > 0) ? LLVMGetOperand(instr, 0) : NULL;
+    operand2 = (operandCount > 1) ? LLVMGetOperand(instr, 1) : NULL;
+
+    // Put the operands of commutative operations in pointer order
+    bool commutative = false;
+    switch (opcode) {
+        case LLVMAdd:
+        case LLVMMul:
+        case LLVMAnd:
+        case LLVMOr:
+        case LLVMXor:
+        case LLVMICmp:
+            commutative = true;
+            break;
+        default:
+            break;
+    }
+    if (commutative && operand2 != NULL && operand2 < operand1) {
+        std::swap(operand1, operand2);
+        if (opcode == LLVMICmp) {
+            predicate = (int)swappedPredicate((LLVMIntPredicate)predicate);
+        }
+    }
+}
+
+// Function to determine if an instruction is a pure expression that value numbering may merge
+bool isValueNumberable(LLVMValueRef instr) {
+    if (LLVMGetNumOperands(instr) == 0 || LLVMGetNumOperands(instr) > 2) {
         return false;
     }
+    switch (LLVMGetInstructionOpcode(instr)) {
+        case LLVMAdd:
+        case LLVMSub:
+        case LLVMMul:
+        case LLVMSDiv:
+        case LLVMUDiv:
+        case LLVMSRem:
+        case LLVMURem:
+        case LLVMShl:
+        case LLVMLShr:
+        case LLVMAShr:
+        case LLVMAnd:
+        case LLVMOr:
+        case LLVMXor:
+        case LLVMICmp:
+        case LLVMTrunc:
+        case LLVMZExt:
+        case LLVMSExt:
+        case LLVMBitCast:
+        case LLVMGetElementPtr:
+            return true;
+        default:
+            // allocas, calls, stores, phis and terminators are never the same as another instruction
+            return false;
+    }
+}
 
-    std::unordered_map<InstructionKey, LLVMValueRef, InstructionKeyHash> cachedExpressions;
-    bool hasChanges = false;
+// Function to queue the blocks of every user of value, whose operands are about to change
+void markUsersDirty(LLVMValueRef value, blockWorklist &dirty) {
+    for (LLVMUseRef use = LLVMGetFirstUse(value); use != NULL; use = LLVMGetNextUse(use)) {
+        dirty.push(LLVMGetInstructionParent(LLVMGetUser(use)));
+    }
+}
 
-    printf("Entering commonSubExprx for basic block: %p\n", basicBlock);
+// Function to drop the phi entries of a block for edges coming from pred, which no longer branches to it.
+// The C API cannot remove incoming entries, so each phi is rebuilt without them; a phi left with no entries
+// is replaced by undef.
+void removePhiEntries(LLVMBasicBlockRef bb, LLVMBasicBlockRef pred) {
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(LLVMGetModuleContext(LLVMGetGlobalParent(LLVMGetBasicBlockParent(bb))));
+    LLVMValueRef phi = LLVMGetFirstInstruction(bb);
+    while (phi != NULL && LLVMIsAPHINode(phi)) {
+        LLVMValueRef nextPhi = LLVMGetNextInstruction(phi);
+        std::vector<LLVMValueRef> values;
+        std::vector<LLVMBasicBlockRef> blocks;
+        for (unsigned i = 0; i < LLVMCountIncoming(phi); i++) {
+            if (LLVMGetIncomingBlock(phi, i) != pred) {
+                values.push_back(LLVMGetIncomingValue(phi, i));
+                blocks.push_back(LLVMGetIncomingBlock(phi, i));
+            }
+        }
+        if (values.size() == LLVMCountIncoming(phi)) {
+            phi = nextPhi;
+            continue;
+        }
+
+        LLVMValueRef replacement = LLVMGetUndef(LLVMTypeOf(phi));
+        if (!values.empty()) {
+            std::string name = LLVMGetValueName(phi);
+            LLVMPositionBuilderBefore(builder, phi);
+            replacement = LLVMBuildPhi(builder, LLVMTypeOf(phi), "");
+            LLVMAddIncoming(replacement, values.data(), blocks.data(), (unsigned)values.size());
+            LLVMReplaceAllUsesWith(phi, replacement);
+            LLVMInstructionEraseFromParent(phi);
+            LLVMSetValueName2(replacement, name.c_str(), name.size());
+        } else {
+            LLVMReplaceAllUsesWith(phi, replacement);
+            LLVMInstructionEraseFromParent(phi);
+        }
+        phi = nextPhi;
+    }
+    LLVMDisposeBuilder(builder);
+}
+
+// Function to check that every use of an alloca is the address of a load or a store, so nothing else can change it
+bool isLocalVariable(LLVMValueRef address) {
+    if (!LLVMIsAAllocaInst(address)) {
+        return false;
+    }
+    for (LLVMUseRef use = LLVMGetFirstUse(address); use != NULL; use = LLVMGetNextUse(use)) {
+        LLVMValueRef user = LLVMGetUser(use);
+        if (LLVMGetInstructionOpcode(user) == LLVMLoad) {
+            continue;
+        }
+        if (LLVMGetInstructionOpcode(user) == LLVMStore && LLVMGetOperand(user, 1) == address && LLVMGetOperand(user, 0) != address) {
+            continue;
+        }
+        return false;
+    }
+    return true;
+}
+
+// Function to determine if an instruction has effects beyond its immediate value
+bool hasSideEffects(LLVMValueRef currentInstr) {
+    switch (LLVMGetInstructionOpcode(currentInstr)) {
+        case LLVMStore:
+        case LLVMCall:
+        case LLVMRet:
+        case LLVMBr:
+        case LLVMFence:
+        case LLVMAtomicCmpXchg:
+        case LLVMAtomicRMW:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Function to run common subexpression elimination and dead code elimination over a basic block in one
+// sweep: CSE walks forward, DCE walks backward so whole chains of unused instructions go at once. Blocks
+// holding users of a replaced value, or operands of an erased one, are queued on dirty. Returns the irChange kinds it made.
+unsigned optimizeBlock(LLVMBasicBlockRef basicBlock, blockWorklist &dirty) {
+    if (basicBlock == NULL) {
+        printf("Has to skip a basic block in optimizeBlock.\n");
+        return CHANGED_NOTHING;
+    }
+
+    std::unordered_map<InstructionKey, LLVMValueRef, InstructionKeyHash> cachedExpressions;
+    unsigned hasChanges = CHANGED_NOTHING;
 
     LLVMValueRef currentInstr = LLVMGetFirstInstruction(basicBlock);
     while (currentInstr != NULL) {
         LLVMValueRef nextInstr = LLVMGetNextInstruction(currentInstr); // Fetch next instruction before potentially deleting the current one
 
+        // Common subexpression elimination, of pure expressions and of loads with no store in between
         LLVMOpcode opcode = LLVMGetInstructionOpcode(currentInstr);
-        int operandCount = LLVMGetNumOperands(currentInstr);
-        LLVMValueRef firstOperand = (operandCount > 0) ? LLVMGetOperand(currentInstr, 0) : NULL;
-        LLVMValueRef secondOperand = (operandCount > 1) ? LLVMGetOperand(currentInstr, 1) : NULL;
-
-        if (!firstOperand) {
+        if (opcode != LLVMLoad && !isValueNumberable(currentInstr)) {
             currentInstr = nextInstr;
             continue;
         }
 
-        InstructionKey instrKey(opcode, firstOperand, secondOperand);
+        InstructionKey instrKey(currentInstr);
+        LLVMValueRef firstOperand = instrKey.operand1;
         auto exprEntry = cachedExpressions.find(instrKey);
 
-        printf("Processing instruction: %p, opcode: %d, operand0: %p, operand1: %p\n", currentInstr, opcode, firstOperand, secondOperand);
-
         // Check if an existing instruction was found
         if (exprEntry != cachedExpressions.end()) {
-            printf("Found existing instruction: %p\n", exprEntry->second);
             LLVMValueRef foundInstr = exprEntry->second;
 
+            // Check for intervening stores that might affect load safety
+            bool isCSESafe = true;
             if (opcode == LLVMLoad && LLVMGetInstructionOpcode(foundInstr) == LLVMLoad) {
-                // Check for intervening stores that might affect load safety
-                bool isCSESafe = true;
                 for (LLVMValueRef checkInstr = LLVMGetNextInstruction(foundInstr);
                      checkInstr != currentInstr;
                      checkInstr = LLVMGetNextInstruction(checkInstr)) {
@@ -124,254 +283,153 @@ bool commonSubExprx(LLVMBasicBlockRef basicBlock) {
                         LLVMValueRef storeAddress = LLVMGetOperand(checkInstr, 1);
                         if (storeAddress == firstOperand) {
                             isCSESafe = false;
-                            printf("Unsafe to perform CSE between %p and %p due to intervening store %p\n", foundInstr, currentInstr, checkInstr);
                             break;
                         }
                     }
                 }
+            }
 
-                if (isCSESafe) {
-                    LLVMReplaceAllUsesWith(currentInstr, foundInstr);
-                    LLVMInstructionEraseFromParent(currentInstr);
-                    hasChanges = true;
-                    printf("Performed CSE: Replaced %p with %p\n", currentInstr, foundInstr);
-                }
-            } else {
+            if (isCSESafe) {
+                markUsersDirty(currentInstr, dirty);
                 LLVMReplaceAllUsesWith(currentInstr, foundInstr);
                 LLVMInstructionEraseFromParent(currentInstr);
-                hasChanges = true;
-                printf("Performed CSE: Replaced %p with %p for non-load instruction\n", currentInstr, foundInstr);
+                hasChanges |= CHANGED_VALUES;
             }
         } else {
             cachedExpressions[instrKey] = currentInstr;
-            printf("Storing new instruction key for %p\n", currentInstr);
         }
         currentInstr = nextInstr; // Move to the next instruction
     }
 
-    printf("Exiting CSE for basic block: %p, changed: %d\n", basicBlock, hasChanges);
-    return hasChanges;
-}
-
-
-
-// Function to perform Dead Code Elimination (DCE) on a basic block
-bool deadCode(LLVMBasicBlockRef basicBlock) {
-    if (basicBlock == NULL) {
-        return false;
-    }
-
-    bool isModified = false;
-
-    printf("Entering DCE for basic block: %p\n", (void*)basicBlock);
-
-    // Set of instructions identified as unnecessary and safe to remove
-    instructionSet candidatesForRemoval;
-
-    for (LLVMValueRef currentInstr = LLVMGetFirstInstruction(basicBlock); currentInstr != NULL;
-         currentInstr = LLVMGetNextInstruction(currentInstr)) {
-        LLVMOpcode instructionCode = LLVMGetInstructionOpcode(currentInstr);
-        printf("Processing instruction: %p, opcode: %d\n", (void*)currentInstr, instructionCode);
-
-        bool isUsed = LLVMGetFirstUse(currentInstr) != NULL;
-
-        // Determine if the instruction has effects beyond its immediate value
-        bool retainsEffects = false;
-        switch (instructionCode) {
-            case LLVMStore:
-            case LLVMCall:
-            case LLVMRet:
-            case LLVMBr:
-            case LLVMFence:
-            case LLVMAtomicCmpXchg:
-            case LLVMAtomicRMW:
-                retainsEffects = true;
-                break;
-            default:
-                retainsEffects = false;
-        }
-
-        // Conditionally mark unused and effect-free instructions for removal
-        if (!isUsed && !retainsEffects) {
-            printf("Marking instruction for removal: %p\n", (void*)currentInstr);
-            candidatesForRemoval.insert(currentInstr);
-        } else {
-            printf("Keeping instruction: %p\n", (void*)currentInstr);
+    // Dead code elimination, last instruction first so the operands of a removed instruction are seen after it
+    currentInstr = LLVMGetLastInstruction(basicBlock);
+    while (currentInstr != NULL) {
+        LLVMValueRef previousInstr = LLVMGetPreviousInstruction(currentInstr);
+
+        // Conditionally remove unused and effect-free instructions
+        if (LLVMGetFirstUse(currentInstr) == NULL && !hasSideEffects(currentInstr)) {
+            // operands defined in other blocks may be dead now too
+            for (int i = 0; i < LLVMGetNumOperands(currentInstr); i++) {
+                LLVMValueRef operand = LLVMGetOperand(currentInstr, i);
+                if (LLVMIsAInstruction(operand) && LLVMGetInstructionParent(operand) != basicBlock) {
+                    dirty.push(LLVMGetInstructionParent(operand));
+                }
+            }
+            LLVMInstructionEraseFromParent(currentInstr);
+            hasChanges |= CHANGED_VALUES;
         }
+        currentInstr = previousInstr;
     }
 
-    // Execute the removal of all marked instructions
-    for (LLVMValueRef deadInstr : candidatesForRemoval) {
-        printf("Removing instruction: %p\n", (void*)deadInstr);
-        LLVMInstructionEraseFromParent(deadInstr);
-        isModified = true;
-    }
-
-    printf("Exiting DCE for basic block: %p, changed: %d\n", (void*)basicBlock, isModified);
-
-    return isModified;
+    return hasChanges;
 }
 
-// Function to perform Constant Folding (constantFolding) on a basic block
-bool constantFolding(LLVMBasicBlockRef basicBlock) {
-    if (basicBlock == NULL) {
-        return false;
-    }
-
-    bool isModified = false;
-
-    printf("Entering CF for basic block: %p\n", (void*)basicBlock);
-
-    for (LLVMValueRef currentInstr = LLVMGetFirstInstruction(basicBlock); currentInstr != NULL;
-         currentInstr = LLVMGetNextInstruction(currentInstr)) {
-        LLVMOpcode opcode = LLVMGetInstructionOpcode(currentInstr);
-        int operandCount = LLVMGetNumOperands(currentInstr);
-        printf("Processing instruction: %p, opcode: %d, num_ops: %d\n", (void*)currentInstr, opcode, operandCount);
-
-        if (operandCount > 1) {
-            LLVMValueRef firstOperand = LLVMGetOperand(currentInstr, 0);
-            LLVMValueRef secondOperand = LLVMGetOperand(currentInstr, 1);
-
-            // Check if both operands are constants
-            if (firstOperand != NULL && secondOperand != NULL && LLVMIsConstant(firstOperand) && LLVMIsConstant(secondOperand)) {
-                printf("Both operands are constants\n");
-                LLVMValueRef foldedConst = NULL;
-
-                // Perform constant folding based on the operation
-                switch (opcode) {
-                    case LLVMAdd:
-                        foldedConst = LLVMConstAdd(firstOperand, secondOperand);
-                        break;
-                    case LLVMSub:
-                        foldedConst = LLVMConstSub(firstOperand, secondOperand);
-                        break;
-                    case LLVMMul:
-                        foldedConst = LLVMConstMul(firstOperand, secondOperand);
-                        break;
-                    default:
-                        printf("Unsupported opcode for constant folding: %d\n", opcode);
-                        break;
-                }
-
-                // Replace the original instruction with the new constant if folding was successful
-                if (foldedConst != NULL) {
-                    printf("Replacing instruction: %p with constant: %p\n", (void*)currentInstr, (void*)foldedConst);
-                    LLVMReplaceAllUsesWith(currentInstr, foldedConst);
-                    //LLVMInstructionEraseFromParent(currentInstr);
-                    isModified = true;
+// Function to number the store instructions of a function densely, in layout order,
+// and to group the store numbers by the address they write
+storeNumbering numberStores(LLVMValueRef targetFunction) {
+    storeNumbering numbering;
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(targetFunction); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        for (LLVMValueRef instr = LLVMGetFirstInstruction(bb); instr != NULL; instr = LLVMGetNextInstruction(instr)) {
+            if (LLVMGetInstructionOpcode(instr) == LLVMStore) {
+                uint32_t id = (uint32_t)numbering.stores.size();
+                numbering.ids[instr] = id;
+                numbering.stores.push_back(instr);
+
+                // first store to an address gives it the next address number
+                auto address = numbering.address_ids.insert({LLVMGetOperand(instr, 1), (uint32_t)numbering.address_stores.size()});
+                if (address.second) {
+                    numbering.address_stores.push_back(std::vector<uint32_t>());
                 }
-            } else {
-                printf("At least one operand is not a constant\n");
+                numbering.address_of.push_back(address.first->second);
+                numbering.address_stores[address.first->second].push_back(id);
             }
         }
     }
-
-    printf("Exiting CF for basic block: %p, changed: %d\n", (void*)basicBlock, isModified);
-
-    return isModified;
+    printf("Numbered %zu store instructions to %zu addresses\n", numbering.stores.size(), numbering.address_stores.size());
+    return numbering;
 }
 
 // Function to create a map of basic blocks to their GEN sets
-bbMap getGenMap(LLVMValueRef targetFunction) {
-    bbMap genMap;
+bbBits getGenMap(LLVMValueRef targetFunction, const storeNumbering &numbering) {
+    bbBits genMap;
     printf("Starting get GenMap\n");
 
+    // Addresses already stored to by the block being walked, reset through the list of touched ones
+    std::vector<bool> storedAddresses(numbering.address_stores.size(), false);
+    std::vector<uint32_t> touched;
+
     // Iterate over each basic block in the function
     for (LLVMBasicBlockRef currentBlock = LLVMGetFirstBasicBlock(targetFunction);
          currentBlock != NULL;
          currentBlock = LLVMGetNextBasicBlock(currentBlock)) {
 
         printf("Processing Basic Block: %p\n", (void*)currentBlock);
-        instructionSet uniqueStores;
+        bitVector gen(numbering.stores.size());
 
-        // Iterate over each instruction in the basic block
-        for (LLVMValueRef currentInstr = LLVMGetFirstInstruction(currentBlock);
+        // Walking the block backwards, the first store seen for an address is the last one
+        // executed, and it overrides every earlier store to that address in the block
+        for (LLVMValueRef currentInstr = LLVMGetLastInstruction(currentBlock);
              currentInstr != NULL;
-             currentInstr = LLVMGetNextInstruction(currentInstr)) {
-
-            printf("Examining Instruction: %p\n", (void*)currentInstr);
-
-            // If this is a store instruction
+             currentInstr = LLVMGetPreviousInstruction(currentInstr)) {
             if (LLVMGetInstructionOpcode(currentInstr) == LLVMStore) {
-                LLVMValueRef storeLoc = LLVMGetOperand(currentInstr, 1);
-                printf("Store Instruction at Address: %p\n", (void*)storeLoc);
-
-                // Remove any previous store instructions to the same address
-                auto iter = uniqueStores.begin();
-                while (iter != uniqueStores.end()) {
-                    if (LLVMGetOperand(*iter, 1) == storeLoc) {
-                        printf("Removing overlapping store instruction: %p\n", (void*)*iter);
-                        iter = uniqueStores.erase(iter);
-                    } else {
-                        ++iter;
-                    }
+                uint32_t id = numbering.ids.at(currentInstr);
+                uint32_t address = numbering.address_of[id];
+                if (!storedAddresses[address]) {
+                    storedAddresses[address] = true;
+                    touched.push_back(address);
+                    gen.set(id);
                 }
-
-                // Add the current store instruction to the set
-                uniqueStores.insert(currentInstr);
-                printf("Inserted Store Instruction: %p\n", (void*)currentInstr);
             }
         }
+        for (uint32_t address : touched) {
+            storedAddresses[address] = false;
+        }
+        touched.clear();
 
         // Store the set in the GEN map
-        genMap[currentBlock] = std::move(uniqueStores);
+        genMap[currentBlock] = std::move(gen);
     }
 
     printf("Finished createGenMap\n");
     return genMap;
 }
 
+// Function to create a map of basic blocks to their KILL sets: every store to an address the block
+// writes, except the ones the block itself generates. Each address is only expanded once per block.
+bbBits getKillMap(LLVMValueRef Function, const storeNumbering &numbering, const bbBits &genMap) {
+    bbBits killMap;
 
-bbMap getKillMap(LLVMValueRef Function) {
-    bbMap killMap;
-    instructionSet allStores;
-
-    printf("Collecting all Store Instructions\n");
+    printf("Computing Kill Sets for each Basic Block\n");
+    std::vector<bool> killedAddresses(numbering.address_stores.size(), false);
+    std::vector<uint32_t> touched;
 
     LLVMBasicBlockRef CurrentBlock = LLVMGetEntryBasicBlock(Function);
     while (CurrentBlock != NULL) {
-        printf("Accessing Basic Block %p\n", (void*)CurrentBlock);
-        LLVMValueRef Instruction = LLVMGetFirstInstruction(CurrentBlock);
-        printf("First Instruction in Basic Block %p is %p\n", (void*)CurrentBlock, (void*)Instruction);
-        while (Instruction != NULL) {
-            printf("Processing Instruction %p, Opcode: %d\n", (void*)Instruction, LLVMGetInstructionOpcode(Instruction));
-            if (LLVMGetInstructionOpcode(Instruction) == LLVMStore) {
-                if (LLVMGetOperand(Instruction, 1) == NULL) {
-                    printf("Failed to get store address for Instruction %p\n", (void*)Instruction);
-                    Instruction = LLVMGetNextInstruction(Instruction);
-                    continue;
-                }
-                allStores.insert(Instruction);
-                printf("Added Store Instruction to allStores: %p\n", (void*)Instruction);
-            }
-            Instruction = LLVMGetNextInstruction(Instruction);
-        }
-        CurrentBlock = LLVMGetNextBasicBlock(CurrentBlock);
-    }
-
-    printf("Computing Kill Sets for each Basic Block\n");
-    CurrentBlock = LLVMGetEntryBasicBlock(Function);
-    while (CurrentBlock != NULL) {
-        instructionSet killSet;
+        bitVector killSet(numbering.stores.size());
 
         LLVMValueRef Instruction = LLVMGetFirstInstruction(CurrentBlock);
         while (Instruction != NULL) {
             if (LLVMGetInstructionOpcode(Instruction) == LLVMStore) {
-                LLVMValueRef address = LLVMGetOperand(Instruction, 1);
-                printf("Processing Store Instruction at %p for Kill Set\n", (void*)address);
-
-                for (LLVMValueRef otherStoreInst : allStores) {
-                    if (LLVMGetOperand(otherStoreInst, 1) != NULL && LLVMGetOperand(otherStoreInst, 1) == address && otherStoreInst != Instruction) {
-                        killSet.insert(otherStoreInst);
-                        printf("Adding to Kill Set, Store Instruction: %p\n", (void*)otherStoreInst);
+                uint32_t address = numbering.address_of[numbering.ids.at(Instruction)];
+                if (!killedAddresses[address]) {
+                    printf("Processing Store Instruction at %p for Kill Set\n", (void*)LLVMGetOperand(Instruction, 1));
+                    killedAddresses[address] = true;
+                    touched.push_back(address);
+                    for (uint32_t other : numbering.address_stores[address]) {
+                        killSet.set(other);
                     }
                 }
             }
             Instruction = LLVMGetNextInstruction(Instruction);
         }
+        for (uint32_t address : touched) {
+            killedAddresses[address] = false;
+        }
+        touched.clear();
 
+        // an earlier store in the block to the same address stays killed, the last one is generated
+        killSet.subtract(genMap.at(CurrentBlock));
         killMap[CurrentBlock] = std::move(killSet);
-        printf("Kill Set for Basic Block %p populated\n", (void*)CurrentBlock);
         CurrentBlock = LLVMGetNextBasicBlock(CurrentBlock);
     }
 
@@ -380,87 +438,49 @@ bbMap getKillMap(LLVMValueRef Function) {
 }
 
 // Computing in and out
-// Only need to return the in as out is only used in this function
-// Compute the 'in' set
-// Function to calculate IN maps for basic blocks based on GEN and KILL maps
-bbMap getInMap(LLVMValueRef targetFunction, const bbMap &genSets, bbMap &killSets, const predMap &predecessorsMap) {
-    bbMap inMap;
-    bbMap outMap;
-
-    printf("Initializing IN sets for each basic block to empty.\n");
-    LLVMBasicBlockRef currBlock = LLVMGetEntryBasicBlock(targetFunction);
-    while (currBlock != NULL) {
-        inMap[currBlock] = instructionSet();
-        printf("IN set initialized for block %p\n", (void*)currBlock);
-        currBlock = LLVMGetNextBasicBlock(currBlock);
-    }
-
-    printf("Initializing OUT sets for each basic block using GEN sets.\n");
-    currBlock = LLVMGetEntryBasicBlock(targetFunction);
-    while (currBlock != NULL) {
-        outMap[currBlock] = genSets.at(currBlock);
-        printf("OUT set for block %p initialized from GEN set.\n", (void*)currBlock);
-        currBlock = LLVMGetNextBasicBlock(currBlock);
-    }
-
-    bool changesDetected = true;
-    printf("Starting computation of IN and OUT sets.\n");
-    while (changesDetected) {
-        changesDetected = false;
-        currBlock = LLVMGetEntryBasicBlock(targetFunction);
-        while (currBlock != NULL) {
-            printf("Computing IN and OUT for block %p\n", (void*)currBlock);
-
-            instructionSet newInSet;
-            const std::vector<LLVMBasicBlockRef>& blockPredecessors = predecessorsMap.at(currBlock);
-            printf("Block %p has %zu predecessors.\n", (void*)currBlock, blockPredecessors.size());
-            for (LLVMBasicBlockRef predecessor : blockPredecessors) {
-                newInSet.insert(outMap[predecessor].begin(), outMap[predecessor].end());
-                printf("Merging OUT of predecessor %p into IN of %p.\n", (void*)predecessor, (void*)currBlock);
-            }
-
-            instructionSet oldOut = outMap[currBlock];
-            outMap[currBlock] = genSets.at(currBlock);
-            const instructionSet &currentKillSet = killSets.at(currBlock);
-            for (LLVMValueRef inst : newInSet) {
-                if (currentKillSet.find(inst) == currentKillSet.end()) {
-                    outMap[currBlock].insert(inst);
-                }
-            }
-
-            printf("Updated OUT set for block %p.\n", (void*)currBlock);
-            if (outMap[currBlock] != oldOut) {
-                changesDetected = true;
-                printf("OUT set for block %p has changed.\n", (void*)currBlock);
-            }
-
-            inMap[currBlock] = std::move(newInSet);
-            currBlock = LLVMGetNextBasicBlock(currBlock);
-        }
-    }
+// Only need to return the in as out is only used by the solver
+// Function to calculate IN maps for basic blocks based on GEN and KILL maps:
+// reaching definitions is a forward union problem, IN(B) = union of OUT(P) over the predecessors P
+bbBits getInMap(LLVMValueRef targetFunction, const bbBits &genSets, const bbBits &killSets, const predMap &predecessorsMap,
+                const std::vector<LLVMBasicBlockRef> &rpo) {
+    dataflowProblem reachingDefs;
+    reachingDefs.direction = DATAFLOW_FORWARD;
+    reachingDefs.meet = MEET_UNION;
+    reachingDefs.num_bits = genSets.empty() ? 0 : genSets.begin()->second.size();
+    reachingDefs.gen = genSets;
+    reachingDefs.kill = killSets;
 
-    printf("Finished computing IN and OUT sets.\n");
-    return inMap;
+    printf("Starting computation of IN and OUT sets.\n");
+    dataflowResult solution = solveDataflow(targetFunction, reachingDefs, predecessorsMap, rpo);
+    printf("Finished computing IN and OUT sets after %u block visits for %u blocks.\n",
+           solution.block_visits, LLVMCountBasicBlocks(targetFunction));
+    return solution.in;
 }
 
-// Function to remove redundant load instructions based on an IN map
-bool removeRedundantLoads(LLVMValueRef targetFunction, bbMap &inSets) {
+// Function to remove redundant load instructions based on an IN map. A load of a local variable is replaced
+// by the stored value when every store reaching it writes the same constant, or when exactly one store
+// reaches it and that store dominates it, so the stored value is available at the load.
+bool removeRedundantLoads(LLVMValueRef targetFunction, AnalysisManager &analyses, const storeNumbering &numbering,
+                          const bbBits &inSets, blockWorklist &dirty) {
     if (targetFunction == NULL) {
         // Skip null functions
         return false;
     }
 
     bool isModified = false;
+    unsigned forwarded = 0;
     LLVMBasicBlockRef currentBlock = LLVMGetEntryBasicBlock(targetFunction);
 
     printf("Starting removal of redundant load instructions.\n");
 
     while (currentBlock != NULL) {
-        instructionSet activeInstructions = inSets.at(currentBlock);
+        // Stores reaching the top of the block, and per address the last store the block made so far
+        const bitVector &reachingStores = inSets.at(currentBlock);
+        std::unordered_map<uint32_t, LLVMValueRef> localStores;
         LLVMValueRef currentInstruction = LLVMGetFirstInstruction(currentBlock);
 
         // Store instructions to be deleted after the loop
-        instructionSet instructionsToDelete;
+        std::vector<LLVMValueRef> instructionsToDelete;
 
         printf("Processing block %p\n", (void*)currentBlock);
 
@@ -471,27 +491,30 @@ bool removeRedundantLoads(LLVMValueRef targetFunction, bbMap &inSets) {
                 LLVMValueRef storeAddress = LLVMGetOperand(currentInstruction, 1);
                 printf("Processing store instruction %p at address %p\n", (void*)currentInstruction, (void*)storeAddress);
 
-                // Remove any overlapping store instructions to the same address
-                auto iter = activeInstructions.begin();
-                while (iter != activeInstructions.end()) {
-                    if (LLVMGetOperand(*iter, 1) == storeAddress) {
-                        printf("Removing redundant store instruction %p from active set\n", (void*)*iter);
-                        iter = activeInstructions.erase(iter);
-                    } else {
-                        ++iter;
-                    }
-                }
-                // Add the current store instruction to the set
-                activeInstructions.insert(currentInstruction);
+                // The store replaces every earlier store to the same address
+                localStores[numbering.address_of[numbering.ids.at(currentInstruction)]] = currentInstruction;
             } else if (LLVMGetInstructionOpcode(currentInstruction) == LLVMLoad) {
-                LLVMValueRef loadAddress = LLVMGetOperand(currentInstruction, 1);
+                // the address is the only operand of a load
+                LLVMValueRef loadAddress = LLVMGetOperand(currentInstruction, 0);
                 printf("Processing load instruction %p at address %p\n", (void*)currentInstruction, (void*)loadAddress);
 
                 // Collect all store instructions that write to the same address
                 std::vector<LLVMValueRef> matchingStores;
-                for (LLVMValueRef storeInst : activeInstructions) {
-                    if (LLVMGetOperand(storeInst, 1) == loadAddress) {
-                        matchingStores.push_back(storeInst);
+                bool dominatingStore = false;
+                auto address = numbering.address_ids.find(loadAddress);
+                if (address != numbering.address_ids.end() && isLocalVariable(loadAddress)) {
+                    auto local = localStores.find(address->second);
+                    if (local != localStores.end()) {
+                        matchingStores.push_back(local->second);
+                        dominatingStore = true;
+                    } else {
+                        for (uint32_t id : numbering.address_stores[address->second]) {
+                            if (reachingStores.test(id)) {
+                                matchingStores.push_back(numbering.stores[id]);
+                            }
+                        }
+                        dominatingStore = matchingStores.size() == 1 &&
+                                          analyses.dominates(LLVMGetInstructionParent(matchingStores[0]), currentBlock);
                     }
                 }
                 // Verify if all these stores are constant and have the same value
@@ -509,10 +532,19 @@ bool removeRedundantLoads(LLVMValueRef targetFunction, bbMap &inSets) {
                         break;
                     }
                 }
+
+                LLVMValueRef forwardedValue = NULL;
                 if (constantStores && constantValue) {
-                    printf("Replacing load instruction %p with constant value from store %p\n", (void*)currentInstruction, (void*)constantValue);
-                    LLVMReplaceAllUsesWith(currentInstruction, constantValue);
-                    instructionsToDelete.insert(currentInstruction);
+                    forwardedValue = constantValue;
+                } else if (dominatingStore) {
+                    // one store on every path to the load, its value is defined before it
+                    forwardedValue = LLVMGetOperand(matchingStores[0], 0);
+                }
+                if (forwardedValue != NULL && LLVMTypeOf(forwardedValue) == LLVMTypeOf(currentInstruction)) {
+                    markUsersDirty(currentInstruction, dirty);
+                    LLVMReplaceAllUsesWith(currentInstruction, forwardedValue);
+                    instructionsToDelete.push_back(currentInstruction);
+                    forwarded++;
                 }
             }
             currentInstruction = nextInstruction;
@@ -523,57 +555,334 @@ bool removeRedundantLoads(LLVMValueRef targetFunction, bbMap &inSets) {
             LLVMInstructionEraseFromParent(inst);
             isModified = true;
         }
-        // Update the InMap for the current basic block with only the active instructions
-        instructionSet updatedActiveInstructions;
-        for (LLVMValueRef inst = LLVMGetFirstInstruction(currentBlock); inst != NULL; inst = LLVMGetNextInstruction(inst)) {
-            if (instructionsToDelete.find(inst) == instructionsToDelete.end()) {
-                updatedActiveInstructions.insert(inst);
-            }
-        }
-        inSets[currentBlock] = std::move(updatedActiveInstructions);
         currentBlock = LLVMGetNextBasicBlock(currentBlock);
     }
 
-    printf("Completed removal of redundant load instructions.\n");
+    printf("Completed removal of redundant load instructions, %u loads replaced.\n", forwarded);
     return isModified;
 }
 
+// Function to remove the stores to local variables that no load reads: stores overwritten before any load,
+// and stores after the last load, like the ones to ret_val on the way to the return. The stores a load
+// can read are the last one before it in its block, or else the ones in the block's IN set.
+bool removeDeadStores(LLVMValueRef targetFunction, const storeNumbering &numbering, const bbBits &inSets, blockWorklist &dirty) {
+    std::vector<bool> isRead(numbering.stores.size(), false);
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(targetFunction); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        std::unordered_map<uint32_t, uint32_t> localStores;     // address number -> last store in bb
+        for (LLVMValueRef instr = LLVMGetFirstInstruction(bb); instr != NULL; instr = LLVMGetNextInstruction(instr)) {
+            if (LLVMGetInstructionOpcode(instr) == LLVMStore) {
+                uint32_t id = numbering.ids.at(instr);
+                localStores[numbering.address_of[id]] = id;
+            } else if (LLVMGetInstructionOpcode(instr) == LLVMLoad) {
+                auto address = numbering.address_ids.find(LLVMGetOperand(instr, 0));
+                if (address == numbering.address_ids.end()) {
+                    continue;
+                }
+                auto local = localStores.find(address->second);
+                if (local != localStores.end()) {
+                    isRead[local->second] = true;
+                    continue;
+                }
+                for (uint32_t id : numbering.address_stores[address->second]) {
+                    if (inSets.at(bb).test(id)) {
+                        isRead[id] = true;
+                    }
+                }
+            }
+        }
+    }
+
+    unsigned removed = 0;
+    for (uint32_t id = 0; id < numbering.stores.size(); id++) {
+        LLVMValueRef store = numbering.stores[id];
+        if (!isRead[id] && isLocalVariable(LLVMGetOperand(store, 1))) {
+            dirty.push(LLVMGetInstructionParent(store));
+            LLVMInstructionEraseFromParent(store);
+            removed++;
+        }
+    }
+    printf("Removed %u dead stores\n", removed);
+    return removed > 0;
+}
+
+
+// Walking the dirty basic blocks and applying local optimizations until none is left.
+// Each sweep only queues the blocks its changes can affect, so the work follows the number of changes.
+bool applyLocalOptimizations(LLVMValueRef function, AnalysisManager& analyses, blockWorklist& dirty) {
+    unsigned localChanges = CHANGED_NOTHING;
+    unsigned sweeps = 0;
+    while (!dirty.empty()) {
+        localChanges |= optimizeBlock(dirty.pop(), dirty);
+        sweeps++;
+    }
+    printf("Local optimizations done after %u block sweeps for %u blocks\n", sweeps, LLVMCountBasicBlocks(function));
+    analyses.invalidate(localChanges);
+    return localChanges != CHANGED_NOTHING;
+}
+
+// Global optimizations
+bool applyGlobalOptimizations(LLVMValueRef function, AnalysisManager& analyses, blockWorklist& dirty) {
+    const reachingDefs& reaching = analyses.reachingDefinitions();
+    // Erasing loads leaves the reaching definitions valid, so the dead stores are found on the same sets
+    bool loadsChanged = removeRedundantLoads(function, analyses, reaching.numbering, reaching.in, dirty);
+    bool storesChanged = removeDeadStores(function, reaching.numbering, reaching.in, dirty);
+    analyses.invalidate((loadsChanged ? CHANGED_VALUES : CHANGED_NOTHING) | (storesChanged ? CHANGED_MEMORY : CHANGED_NOTHING));
+    return loadsChanged || storesChanged;
+}
 
-// Function to handle local optimizations on a single basic block
-bool performLocalOptimizations(LLVMBasicBlockRef bb) {
-    // CSE
-    if (commonSubExprx(bb)) {
-        return true;
+// Function to list the distinct blocks branching to bb. The branches are the uses of the block, so this is
+// right even while simplifyCFG changes the CFG under the analysis manager.
+static std::vector<LLVMBasicBlockRef> blockPredecessors(LLVMBasicBlockRef bb) {
+    std::vector<LLVMBasicBlockRef> preds;
+    for (LLVMUseRef use = LLVMGetFirstUse(LLVMBasicBlockAsValue(bb)); use != NULL; use = LLVMGetNextUse(use)) {
+        LLVMValueRef user = LLVMGetUser(use);
+        if (LLVMIsAInstruction(user) && LLVMIsATerminatorInst(user)) {
+            LLVMBasicBlockRef pred = LLVMGetInstructionParent(user);
+            if (std::find(preds.begin(), preds.end(), pred) == preds.end()) {
+                preds.push_back(pred);
+            }
+        }
     }
-    // Dead Code
-    if (deadCode(bb)) {
-        return true;
+    return preds;
+}
+
+// Function to replace the terminator of bb by a jump to target, dropping bb's phi entries in dropped
+static void replaceWithJump(LLVMBasicBlockRef bb, LLVMBasicBlockRef target, LLVMBasicBlockRef dropped, LLVMBuilderRef builder) {
+    LLVMValueRef terminator = LLVMGetBasicBlockTerminator(bb);
+    LLVMPositionBuilderBefore(builder, terminator);
+    LLVMBuildBr(builder, target);
+    LLVMInstructionEraseFromParent(terminator);
+    if (dropped != target) {
+        removePhiEntries(dropped, bb);
     }
-    // Constant Folding
-    if (constantFolding(bb)) {
-        return true;
+}
+
+// Function to give the predicate that holds exactly when predicate does not
+static LLVMIntPredicate inversePredicate(LLVMIntPredicate predicate) {
+    switch (predicate) {
+        case LLVMIntEQ:  return LLVMIntNE;
+        case LLVMIntNE:  return LLVMIntEQ;
+        case LLVMIntSGT: return LLVMIntSLE;
+        case LLVMIntSLE: return LLVMIntSGT;
+        case LLVMIntSGE: return LLVMIntSLT;
+        case LLVMIntSLT: return LLVMIntSGE;
+        case LLVMIntUGT: return LLVMIntULE;
+        case LLVMIntULE: return LLVMIntUGT;
+        case LLVMIntUGE: return LLVMIntULT;
+        case LLVMIntULT: return LLVMIntUGE;
+        default:         return predicate;
     }
-    // Return false in the case no optimizations are made
-    return false;
 }
 
-// Walking through each basic block and applying local optimizations 
-bool applyLocalOptimizations(LLVMValueRef function) {
-    bool localChanges = false;
-    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(function); bb; bb = LLVMGetNextBasicBlock(bb)) {
-        if (performLocalOptimizations(bb)) {
-            localChanges = true;
+// Function to fold the branches whose condition is known from a dominating branch: if a block is only
+// entered through the true edge of a branch on c, a branch on c inside it always goes the same way, and a
+// branch on the inverse compare the other way. All folds are found on one dominator tree and then made;
+// removing edges never makes a found fold wrong.
+static unsigned foldDominatedBranches(AnalysisManager& analyses, blockWorklist& dirty, LLVMBuilderRef builder) {
+    std::vector<std::pair<LLVMBasicBlockRef, bool>> folds;
+    for (LLVMBasicBlockRef bb : analyses.reversePostorder()) {
+        LLVMValueRef terminator = LLVMGetBasicBlockTerminator(bb);
+        if (LLVMGetInstructionOpcode(terminator) != LLVMBr || !LLVMIsConditional(terminator) ||
+            LLVMIsAConstant(LLVMGetCondition(terminator))) {
+            continue;
         }
+        LLVMValueRef condition = LLVMGetCondition(terminator);
+        for (LLVMBasicBlockRef dom = analyses.immediateDominator(bb); dom != NULL; dom = analyses.immediateDominator(dom)) {
+            LLVMValueRef domBranch = LLVMGetBasicBlockTerminator(dom);
+            if (LLVMGetInstructionOpcode(domBranch) != LLVMBr || !LLVMIsConditional(domBranch) ||
+                LLVMGetSuccessor(domBranch, 0) == LLVMGetSuccessor(domBranch, 1)) {
+                continue;
+            }
+            LLVMValueRef domCondition = LLVMGetCondition(domBranch);
+            bool same = domCondition == condition;
+            bool inverse = !same && LLVMIsAICmpInst(condition) && LLVMIsAICmpInst(domCondition) &&
+                           LLVMGetOperand(condition, 0) == LLVMGetOperand(domCondition, 0) &&
+                           LLVMGetOperand(condition, 1) == LLVMGetOperand(domCondition, 1) &&
+                           LLVMGetICmpPredicate(condition) == inversePredicate(LLVMGetICmpPredicate(domCondition));
+            if (!same && !inverse) {
+                continue;
+            }
+            bool found = false;
+            for (unsigned i = 0; i < 2 && !found; i++) {
+                LLVMBasicBlockRef edge = LLVMGetSuccessor(domBranch, i);
+                if (analyses.predecessors().at(edge).size() == 1 && analyses.dominates(edge, bb)) {
+                    // successor 0 is the true edge
+                    folds.push_back({bb, (i == 0) == same});
+                    found = true;
+                }
+            }
+            if (found) {
+                break;
+            }
+        }
+    }
+
+    for (auto& fold : folds) {
+        LLVMValueRef terminator = LLVMGetBasicBlockTerminator(fold.first);
+        LLVMBasicBlockRef taken = LLVMGetSuccessor(terminator, fold.second ? 0 : 1);
+        LLVMBasicBlockRef dropped = LLVMGetSuccessor(terminator, fold.second ? 1 : 0);
+        replaceWithJump(fold.first, taken, dropped, builder);
+        dirty.push(fold.first);
+        dirty.push(dropped);
     }
-    return localChanges;
+    return (unsigned)folds.size();
 }
 
-// Global optimizations
-bool applyGlobalOptimizations(LLVMValueRef function, const predMap& predecessorMap) {
-    bbMap genMap = getGenMap(function);
-    bbMap killMap = getKillMap(function);
-    bbMap inMap = getInMap(function, genMap, killMap, predecessorMap);
-    return removeRedundantLoads(function, inMap);
+// Function to merge bb into its only successor when bb is that successor's only predecessor.
+// Returns true if bb was merged and deleted.
+static bool mergeIntoSuccessor(LLVMValueRef function, LLVMBasicBlockRef bb, blockWorklist& dirty, LLVMBuilderRef builder) {
+    LLVMValueRef terminator = LLVMGetBasicBlockTerminator(bb);
+    if (LLVMGetInstructionOpcode(terminator) != LLVMBr || LLVMIsConditional(terminator)) {
+        return false;
+    }
+    LLVMBasicBlockRef successor = LLVMGetSuccessor(terminator, 0);
+    if (successor == bb || blockPredecessors(successor).size() != 1) {
+        return false;
+    }
+
+    // the successor's phis have the one entry from bb
+    LLVMValueRef phi = LLVMGetFirstInstruction(successor);
+    while (phi != NULL && LLVMIsAPHINode(phi)) {
+        LLVMValueRef nextPhi = LLVMGetNextInstruction(phi);
+        LLVMReplaceAllUsesWith(phi, LLVMGetIncomingValue(phi, 0));
+        LLVMInstructionEraseFromParent(phi);
+        phi = nextPhi;
+    }
+
+    // bb's instructions go in front of the successor's, so the blocks branching to bb can branch there
+    LLVMValueRef anchor = LLVMGetFirstInstruction(successor);
+    LLVMValueRef instr = LLVMGetFirstInstruction(bb);
+    while (instr != terminator) {
+        LLVMValueRef nextInstr = LLVMGetNextInstruction(instr);
+        std::string name = LLVMGetValueName(instr);
+        LLVMInstructionRemoveFromParent(instr);
+        LLVMPositionBuilderBefore(builder, anchor);
+        LLVMInsertIntoBuilderWithName(builder, instr, name.c_str());
+        instr = nextInstr;
+    }
+    if (bb == LLVMGetEntryBasicBlock(function)) {
+        LLVMMoveBasicBlockBefore(successor, bb);
+    }
+    LLVMReplaceAllUsesWith(LLVMBasicBlockAsValue(bb), LLVMBasicBlockAsValue(successor));
+    dirty.remove(bb);
+    dirty.push(successor);
+    LLVMDeleteBasicBlock(bb);
+    return true;
+}
+
+// Function to let the predecessors of a block holding nothing but a jump branch to its target directly.
+// Returns true if bb was bypassed and deleted.
+static bool bypassEmptyBlock(LLVMValueRef function, LLVMBasicBlockRef bb, blockWorklist& dirty) {
+    LLVMValueRef terminator = LLVMGetFirstInstruction(bb);
+    if (bb == LLVMGetEntryBasicBlock(function) || LLVMGetInstructionOpcode(terminator) != LLVMBr || LLVMIsConditional(terminator)) {
+        return false;
+    }
+    LLVMBasicBlockRef target = LLVMGetSuccessor(terminator, 0);
+    if (target == bb) {
+        return false;
+    }
+    std::vector<LLVMBasicBlockRef> preds = blockPredecessors(bb);
+    std::vector<LLVMBasicBlockRef> targetPreds = blockPredecessors(target);
+
+    // The target's phis need the value coming through bb on each new edge; a predecessor that already
+    // branches to the target has to agree with it
+    std::vector<LLVMValueRef> phis;
+    for (LLVMValueRef phi = LLVMGetFirstInstruction(target); phi != NULL && LLVMIsAPHINode(phi); phi = LLVMGetNextInstruction(phi)) {
+        phis.push_back(phi);
+    }
+    std::vector<LLVMValueRef> through(phis.size());
+    for (size_t p = 0; p < phis.size(); p++) {
+        for (unsigned i = 0; i < LLVMCountIncoming(phis[p]); i++) {
+            if (LLVMGetIncomingBlock(phis[p], i) == bb) {
+                through[p] = LLVMGetIncomingValue(phis[p], i);
+            }
+        }
+        for (unsigned i = 0; i < LLVMCountIncoming(phis[p]); i++) {
+            LLVMBasicBlockRef incoming = LLVMGetIncomingBlock(phis[p], i);
+            if (std::find(preds.begin(), preds.end(), incoming) != preds.end() && LLVMGetIncomingValue(phis[p], i) != through[p]) {
+                return false;
+            }
+        }
+    }
+
+    for (LLVMBasicBlockRef pred : preds) {
+        LLVMValueRef predTerminator = LLVMGetBasicBlockTerminator(pred);
+        for (unsigned i = 0; i < LLVMGetNumSuccessors(predTerminator); i++) {
+            if (LLVMGetSuccessor(predTerminator, i) != bb) {
+                continue;
+            }
+            for (size_t p = 0; p < phis.size(); p++) {
+                LLVMAddIncoming(phis[p], &through[p], &pred, 1);    // one entry per edge
+            }
+        }
+        dirty.push(pred);
+    }
+    if (!phis.empty()) {
+        removePhiEntries(target, bb);
+    }
+    LLVMReplaceAllUsesWith(LLVMBasicBlockAsValue(bb), LLVMBasicBlockAsValue(target));
+    dirty.remove(bb);
+    dirty.push(target);
+    LLVMDeleteBasicBlock(bb);
+    return true;
+}
+
+// Function to simplify the CFG: branches decided by a dominating branch or by a constant become jumps,
+// a block jumping to a block with no other predecessor is merged with it, and blocks holding nothing but
+// a jump are bypassed. Loop preheaders are kept even when empty, LICM needs them. Returns the irChange
+// kinds it made; the manager has been told already.
+unsigned simplifyCFG(AnalysisManager& analyses, blockWorklist& dirty) {
+    LLVMValueRef function = analyses.function();
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(LLVMGetModuleContext(LLVMGetGlobalParent(function)));
+    unsigned blocksBefore = LLVMCountBasicBlocks(function);
+
+    std::unordered_set<LLVMBasicBlockRef> preheaders;
+    for (const naturalLoop& loop : analyses.loops()) {
+        if (loop.preheader != NULL) {
+            preheaders.insert(loop.preheader);
+        }
+    }
+    unsigned dominated = foldDominatedBranches(analyses, dirty, builder);
+
+    // The block local rewrites ask the IR for predecessors, so they can go on until nothing changes
+    unsigned constant = 0, merged = 0, bypassed = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(function);
+        while (bb != NULL) {
+            LLVMBasicBlockRef nextBB = LLVMGetNextBasicBlock(bb);   // only bb itself is ever deleted
+            LLVMValueRef terminator = LLVMGetBasicBlockTerminator(bb);
+            if (LLVMGetInstructionOpcode(terminator) == LLVMBr && LLVMIsConditional(terminator) &&
+                LLVMIsAConstantInt(LLVMGetCondition(terminator))) {
+                bool condition = LLVMConstIntGetZExtValue(LLVMGetCondition(terminator)) != 0;
+                LLVMBasicBlockRef taken = LLVMGetSuccessor(terminator, condition ? 0 : 1);
+                LLVMBasicBlockRef dropped = LLVMGetSuccessor(terminator, condition ? 1 : 0);
+                replaceWithJump(bb, taken, dropped, builder);
+                dirty.push(bb);
+                constant++;
+                changed = true;
+            } else if (!preheaders.count(bb) && bypassEmptyBlock(function, bb, dirty)) {
+                bypassed++;
+                changed = true;
+            } else if (mergeIntoSuccessor(function, bb, dirty, builder)) {
+                merged++;
+                changed = true;
+            }
+            bb = nextBB;
+        }
+    }
+    LLVMDisposeBuilder(builder);
+
+    unsigned changes = CHANGED_NOTHING;
+    if (dominated + constant + merged + bypassed > 0) {
+        changes = CHANGED_CFG | CHANGED_VALUES;
+        analyses.invalidate(changes);
+        removeUnreachableBlocks(analyses, dirty);   // behind the folded branches
+    }
+    printf("SimplifyCFG: %u -> %u blocks, %u dominated and %u constant branches folded, %u blocks merged, %u bypassed\n",
+           blocksBefore, LLVMCountBasicBlocks(function), dominated, constant, merged, bypassed);
+    return changes;
 }
 
 // Main function orchestrating the optimization process
@@ -582,15 +891,45 @@ void doOptimizations(LLVMValueRef function) {
         return; // early exit for declarations or functions without basic blocks
     }
 
-    predMap predecessorMap = buildPredMap(function);
-    bool globalChanged, localChanged;  //bools to keep track if changes are made during local or global optimizations
+    // CFG and dataflow results are computed on first use and kept until a pass invalidates them
+    AnalysisManager analyses(function);
+    bool globalChanged;  //bool to keep track if changes are made during global optimizations
+
+    // Every block is dirty at first; after that only the blocks the last changes touched
+    blockWorklist dirty;
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(function); bb; bb = LLVMGetNextBasicBlock(bb)) {
+        dirty.push(bb);
+    }
+
+    // Local variables become SSA values first, so the passes below see values instead of memory
+    analyses.invalidate(promoteAllocas(analyses, dirty));
 
     do {
-        do {
-            localChanged = applyLocalOptimizations(function);
-        } while (localChanged);
-        globalChanged = applyGlobalOptimizations(function, predecessorMap);
+        // constants, including the ones that only show once dead branches are ignored; converges in one run
+        unsigned sccpChanges = propagateConstants(analyses, dirty);
+        analyses.invalidate(sccpChanges);
+        // dead code, dead branches and the blocks no longer reached, in one mark and sweep
+        unsigned adceChanges = eliminateDeadCode(analyses, dirty);
+        analyses.invalidate(adceChanges);
+        // fewer, larger blocks for everything after
+        unsigned cfgChanges = simplifyCFG(analyses, dirty);
+        applyLocalOptimizations(function, analyses, dirty);
+        // value numbering across blocks, along the dominator tree
+        unsigned gvnChanges = globalValueNumbering(analyses, dirty);
+        analyses.invalidate(gvnChanges);
+        // move loop invariant code to the loop preheaders
+        unsigned licmChanges = hoistLoopInvariants(analyses, dirty);
+        analyses.invalidate(licmChanges);
+        // exit values of counting loops, and loops that only compute them
+        unsigned scevChanges = replaceLoopExitValues(analyses, dirty);
+        analyses.invalidate(scevChanges);
+        globalChanged = applyGlobalOptimizations(function, analyses, dirty) || sccpChanges != CHANGED_NOTHING ||
+                        adceChanges != CHANGED_NOTHING || cfgChanges != CHANGED_NOTHING ||
+                        gvnChanges != CHANGED_NOTHING || licmChanges != CHANGED_NOTHING ||
+                        scevChanges != CHANGED_NOTHING;
     } while (globalChanged);
+
+    analyses.printStatistics();
 }
 
 void walkBasicblocks(LLVMValueRef function){
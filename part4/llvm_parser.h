@@ -5,34 +5,66 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
+#include <algorithm>
+#include <deque>
+#include "analysis_manager.h"
 
 using instructionSet = std::unordered_set<LLVMValueRef>;
 using bbMap = std::unordered_map<LLVMBasicBlockRef, instructionSet>;
-using predMap = std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMBasicBlockRef>>;
 
-LLVMModuleRef createLLVMModel(char *filename);
+// Basic blocks waiting for the local optimizations, each queued at most once
+struct blockWorklist {
+    std::deque<LLVMBasicBlockRef> queue;
+    std::unordered_set<LLVMBasicBlockRef> queued;
+
+    void push(LLVMBasicBlockRef bb) {
+        if (queued.insert(bb).second) {
+            queue.push_back(bb);
+        }
+    }
+    LLVMBasicBlockRef pop() {
+        LLVMBasicBlockRef bb = queue.front();
+        queue.pop_front();
+        queued.erase(bb);
+        return bb;
+    }
+    // a deleted block must not be popped later
+    void remove(LLVMBasicBlockRef bb) {
+        if (queued.erase(bb)) {
+            queue.erase(std::find(queue.begin(), queue.end(), bb));
+        }
+    }
+    bool empty() const { return queue.empty(); }
+};
+
+LLVMModuleRef createLLVMModel(LLVMContextRef context, char *filename);
 
 // Function that builds a map of basic blocks to their predecessors
 predMap buildPredMap(LLVMValueRef function);
 
-// Struct to hold opcode and operands for instructions
+// Struct to hold what makes two instructions compute the same value: opcode, comparison predicate,
+// result type and operands. Operands of commutative instructions are put in a fixed order, and a
+// comparison with swapped operands gets the swapped predicate, so a + b and b + a share a key.
 struct InstructionKey {
     LLVMOpcode opcode;
+    int predicate;          // LLVMIntPredicate of an icmp, 0 for everything else
+    LLVMTypeRef type;
     LLVMValueRef operand1;
     LLVMValueRef operand2;
 
-    InstructionKey(LLVMOpcode op, LLVMValueRef op1, LLVMValueRef op2 = NULL)
-        : opcode(op), operand1(op1), operand2(op2) {}
+    explicit InstructionKey(LLVMValueRef instr);
 
     bool operator==(const InstructionKey& other) const {
-        return opcode == other.opcode && operand1 == other.operand1 && operand2 == other.operand2;
+        return opcode == other.opcode && predicate == other.predicate && type == other.type &&
+               operand1 == other.operand1 && operand2 == other.operand2;
     }
 };
 
 // Hash function for InstructionKey
 struct InstructionKeyHash {
     std::size_t operator()(const InstructionKey& key) const {
-        size_t hash = std::hash<LLVMOpcode>{}(key.opcode);
+        size_t hash = std::hash<int>{}((int)key.opcode * 64 + key.predicate);
+        hash ^= std::hash<LLVMTypeRef>{}(key.type) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
         hash ^= std::hash<LLVMValueRef>{}(key.operand1) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
         if (key.operand2) {
             hash ^= std::hash<LLVMValueRef>{}(key.operand2) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
@@ -41,34 +73,54 @@ struct InstructionKeyHash {
     }
 };
 
-// Function that performs CSE
-bool commonSubExprx(LLVMBasicBlockRef bb);
-// function that performs dead code elimination
-bool deadCode(LLVMBasicBlockRef bb);
+// Function that tells if an instruction is a pure expression of at most two operands,
+// so any other instruction with the same InstructionKey computes the same value
+bool isValueNumberable(LLVMValueRef instr);
+
+// Function that queues the blocks of every user of value
+void markUsersDirty(LLVMValueRef value, blockWorklist &dirty);
+
+// Function that removes the phi entries of bb for the edge from pred
+void removePhiEntries(LLVMBasicBlockRef bb, LLVMBasicBlockRef pred);
+
+// Function that tells if an alloca is only used as the address of loads and stores
+bool isLocalVariable(LLVMValueRef address);
 
-// Function that performs constant folding
-bool constantFolding(LLVMBasicBlockRef bb);
+// Function that tells if an instruction has to stay even when its value is unused
+bool hasSideEffects(LLVMValueRef instr);
 
-// Helper function that calls local optimizations on a given basic block
-bool performLocalOptimizations(LLVMBasicBlockRef bb);
+// Function that performs CSE and dead code elimination on a basic block in one sweep,
+// queues the blocks its changes affect and returns the irChange kinds it made
+unsigned optimizeBlock(LLVMBasicBlockRef bb, blockWorklist &dirty);
 
-// Helper function that applies local optimizations
-bool applyLocalOptimizations(LLVMValueRef function);
+// Helper function that applies local optimizations to the dirty blocks until there are none
+bool applyLocalOptimizations(LLVMValueRef function, AnalysisManager& analyses, blockWorklist& dirty);
+
+// Helper function that numbers the store instructions of a function
+storeNumbering numberStores(LLVMValueRef function);
 
 // Helper function that creates the GEN Map 
-bbMap getGenMap(LLVMValueRef function);
+bbBits getGenMap(LLVMValueRef function, const storeNumbering &numbering);
 
 // Helper function that creates the KILL Map
-bbMap getKillMap(LLVMValueRef Function);
+bbBits getKillMap(LLVMValueRef Function, const storeNumbering &numbering, const bbBits &GenMap);
 
 // function that crates the in and out sets 
-bbMap getInMap(LLVMValueRef Function, const bbMap &GenMap, bbMap &KillMap, const predMap &predecessorMap);
+bbBits getInMap(LLVMValueRef Function, const bbBits &GenMap, const bbBits &KillMap, const predMap &predecessorMap,
+                const std::vector<LLVMBasicBlockRef> &rpo);
 
 // Helper function that calls for global optimizations on the GEN and KILL set
-bool applyGlobalOptimizations(LLVMValueRef function, const predMap &predecessorMap);
+bool applyGlobalOptimizations(LLVMValueRef function, AnalysisManager& analyses, blockWorklist& dirty);
 
 // Helper function that removes redundant load instructions based on the IN map
-bool removeRedundantLoads(LLVMValueRef Function, bbMap &InMap);
+bool removeRedundantLoads(LLVMValueRef Function, AnalysisManager &analyses, const storeNumbering &numbering,
+                          const bbBits &InMap, blockWorklist &dirty);
+
+// Helper function that removes the stores no load can read, based on the IN map
+bool removeDeadStores(LLVMValueRef Function, const storeNumbering &numbering, const bbBits &InMap, blockWorklist &dirty);
+
+// Function that merges, bypasses and folds basic blocks and returns the irChange kinds it made
+unsigned simplifyCFG(AnalysisManager& analyses, blockWorklist& dirty);
 
 // Function that loops through global and local optimizations
 void doOptimizations(LLVMValueRef function);
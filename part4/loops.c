@@ -0,0 +1,206 @@
+/*
+*   Purpose: This file implements the loop analysis of the optimizer and preheader insertion. The loops of a
+*   while statement have the cond block as header and the block ending the body as latch; the block before the
+*   loop usually branches straight to cond and already is the preheader.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "loops.h"
+#include "analysis_manager.h"
+
+std::vector<naturalLoop> findLoops(AnalysisManager& analyses) {
+    const std::vector<LLVMBasicBlockRef>& rpo = analyses.reversePostorder();
+    const predMap& preds = analyses.predecessors();
+    const succMap& succs = analyses.successors();
+
+    // Back edges grouped by their header, headers in reverse postorder
+    std::vector<LLVMBasicBlockRef> headers;
+    std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMBasicBlockRef>> latches;
+    for (LLVMBasicBlockRef bb : rpo) {
+        for (LLVMBasicBlockRef successor : succs.at(bb)) {
+            if (analyses.dominates(successor, bb)) {
+                if (latches.find(successor) == latches.end()) {
+                    headers.push_back(successor);
+                }
+                latches[successor].push_back(bb);
+            }
+        }
+    }
+
+    std::vector<naturalLoop> loops;
+    for (LLVMBasicBlockRef header : headers) {
+        naturalLoop loop;
+        loop.header = header;
+        loop.latches = latches[header];
+        loop.preheader = NULL;
+        loop.parent = -1;
+        loop.depth = 1;
+
+        // The body is everything that reaches a latch without going through the header
+        loop.members.insert(header);
+        std::vector<LLVMBasicBlockRef> worklist;
+        for (LLVMBasicBlockRef latch : loop.latches) {
+            if (loop.members.insert(latch).second) {
+                worklist.push_back(latch);
+            }
+        }
+        while (!worklist.empty()) {
+            LLVMBasicBlockRef bb = worklist.back();
+            worklist.pop_back();
+            for (LLVMBasicBlockRef pred : preds.at(bb)) {
+                // unreachable blocks are left out, the header dominates every block of the loop
+                if (analyses.dominates(header, pred) && loop.members.insert(pred).second) {
+                    worklist.push_back(pred);
+                }
+            }
+        }
+        for (LLVMBasicBlockRef bb : rpo) {
+            if (loop.members.count(bb)) {
+                loop.blocks.push_back(bb);
+            }
+        }
+
+        std::unordered_set<LLVMBasicBlockRef> exits;
+        for (LLVMBasicBlockRef bb : loop.blocks) {
+            for (LLVMBasicBlockRef successor : succs.at(bb)) {
+                if (!loop.members.count(successor) && exits.insert(successor).second) {
+                    loop.exits.push_back(successor);
+                }
+            }
+        }
+
+        // A preheader is the only reachable block entering the loop, with nowhere else to go
+        LLVMBasicBlockRef entering = NULL;
+        unsigned numEntering = 0;
+        for (LLVMBasicBlockRef pred : preds.at(header)) {
+            if (!loop.members.count(pred) && analyses.dominates(rpo[0], pred)) {
+                entering = pred;
+                numEntering++;
+            }
+        }
+        if (numEntering == 1 && succs.at(entering).size() == 1) {
+            loop.preheader = entering;
+        }
+
+        loops.push_back(loop);
+    }
+
+    // Innermost first: a loop nested in another has fewer blocks
+    std::stable_sort(loops.begin(), loops.end(), [](const naturalLoop& a, const naturalLoop& b) {
+        return a.blocks.size() < b.blocks.size();
+    });
+    for (size_t i = 0; i < loops.size(); i++) {
+        for (size_t j = i + 1; j < loops.size(); j++) {
+            if (loops[j].members.count(loops[i].header)) {
+                loops[i].parent = (int)j;   // the smallest loop containing this one
+                break;
+            }
+        }
+    }
+    for (size_t i = loops.size(); i-- > 0;) {
+        if (loops[i].parent != -1) {
+            loops[i].depth = loops[loops[i].parent].depth + 1;
+        }
+    }
+
+    printf("Found %zu natural loops\n", loops.size());
+    return loops;
+}
+
+// Function to put a new block between the blocks entering loop and its header
+static void insertPreheader(LLVMValueRef function, const naturalLoop& loop, const std::vector<LLVMBasicBlockRef>& entering) {
+    LLVMContextRef llvm = LLVMGetModuleContext(LLVMGetGlobalParent(function));
+    LLVMBasicBlockRef header = loop.header;
+    LLVMBasicBlockRef preheader = LLVMInsertBasicBlockInContext(llvm, header, "preheader");
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(llvm);
+    LLVMPositionBuilderAtEnd(builder, preheader);
+    LLVMBuildBr(builder, header);
+
+    std::unordered_set<LLVMBasicBlockRef> outside(entering.begin(), entering.end());
+
+    // The header's phis take the values from outside through the preheader. The C API cannot change an
+    // incoming block, so each phi is rebuilt: a phi in the preheader merges the outside values if they differ.
+    std::vector<LLVMValueRef> oldPhis;
+    for (LLVMValueRef phi = LLVMGetFirstInstruction(header); phi != NULL && LLVMIsAPHINode(phi); phi = LLVMGetNextInstruction(phi)) {
+        oldPhis.push_back(phi);
+    }
+    for (LLVMValueRef phi : oldPhis) {
+        std::vector<LLVMValueRef> outsideValues, insideValues;
+        std::vector<LLVMBasicBlockRef> outsideBlocks, insideBlocks;
+        for (unsigned i = 0; i < LLVMCountIncoming(phi); i++) {
+            LLVMBasicBlockRef from = LLVMGetIncomingBlock(phi, i);
+            if (outside.count(from)) {
+                outsideValues.push_back(LLVMGetIncomingValue(phi, i));
+                outsideBlocks.push_back(from);
+            } else {
+                insideValues.push_back(LLVMGetIncomingValue(phi, i));
+                insideBlocks.push_back(from);
+            }
+        }
+
+        LLVMValueRef entryValue = outsideValues[0];
+        if (std::count(outsideValues.begin(), outsideValues.end(), entryValue) != (long)outsideValues.size()) {
+            LLVMPositionBuilderBefore(builder, LLVMGetFirstInstruction(preheader));
+            entryValue = LLVMBuildPhi(builder, LLVMTypeOf(phi), "");
+            LLVMAddIncoming(entryValue, outsideValues.data(), outsideBlocks.data(), (unsigned)outsideValues.size());
+        }
+
+        LLVMPositionBuilderBefore(builder, LLVMGetFirstInstruction(header));
+        std::string name = LLVMGetValueName(phi);
+        LLVMValueRef newPhi = LLVMBuildPhi(builder, LLVMTypeOf(phi), "");
+        LLVMAddIncoming(newPhi, &entryValue, &preheader, 1);
+        LLVMAddIncoming(newPhi, insideValues.data(), insideBlocks.data(), (unsigned)insideValues.size());
+        LLVMReplaceAllUsesWith(phi, newPhi);
+        LLVMInstructionEraseFromParent(phi);
+        LLVMSetValueName2(newPhi, name.c_str(), name.size());
+    }
+
+    // Reroute the entering edges
+    for (LLVMBasicBlockRef from : entering) {
+        LLVMValueRef terminator = LLVMGetBasicBlockTerminator(from);
+        for (unsigned i = 0; i < LLVMGetNumSuccessors(terminator); i++) {
+            if (LLVMGetSuccessor(terminator, i) == header) {
+                LLVMSetSuccessor(terminator, i, preheader);
+            }
+        }
+    }
+
+    LLVMDisposeBuilder(builder);
+}
+
+bool insertPreheaders(AnalysisManager& analyses) {
+    unsigned inserted = 0;
+    // a copy, the cached list goes away when the CFG changes
+    std::vector<naturalLoop> loops = analyses.loops();
+    LLVMBasicBlockRef entry = analyses.reversePostorder()[0];
+    for (const naturalLoop& loop : loops) {
+        if (loop.preheader != NULL) {
+            continue;
+        }
+        // Only reachable blocks are rerouted; unreachable ones keep their edge into the header
+        std::vector<LLVMBasicBlockRef> entering;
+        for (LLVMBasicBlockRef pred : analyses.predecessors().at(loop.header)) {
+            if (!loop.members.count(pred) && analyses.dominates(entry, pred) &&
+                std::find(entering.begin(), entering.end(), pred) == entering.end()) {
+                entering.push_back(pred);
+            }
+        }
+        if (entering.empty()) {
+            continue;   // the entry block itself is the header
+        }
+        insertPreheader(analyses.function(), loop, entering);
+        inserted++;
+    }
+    if (inserted > 0) {
+        printf("Inserted %u loop preheaders\n", inserted);
+        analyses.invalidate(CHANGED_CFG);
+    }
+    return inserted > 0;
+}
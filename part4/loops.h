@@ -0,0 +1,37 @@
+/*
+*   Purpose: This is the .h file for the loop analysis of the optimizer. A natural loop is found for every
+*   back edge (an edge whose target dominates its source); loops sharing a header are merged. Loops are
+*   kept innermost first, and every loop knows its enclosing loop, so passes can work from the inside out.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#ifndef LOOPS_H
+#define LOOPS_H
+
+#include <llvm-c/Core.h>
+#include <unordered_set>
+#include <vector>
+
+class AnalysisManager;
+
+typedef struct {
+    LLVMBasicBlockRef header;
+    std::vector<LLVMBasicBlockRef> blocks;              // in reverse postorder, so the header is first
+    std::unordered_set<LLVMBasicBlockRef> members;
+    std::vector<LLVMBasicBlockRef> latches;             // blocks with a back edge to the header
+    std::vector<LLVMBasicBlockRef> exits;               // blocks outside the loop that it branches to
+    LLVMBasicBlockRef preheader;                        // only block outside the loop entering it, ending in
+                                                        // an unconditional branch to the header; NULL if none
+    int parent;                                         // index of the enclosing loop, -1 for outermost loops
+    unsigned depth;                                     // 1 for outermost loops
+} naturalLoop;
+
+// Function to find the natural loops of the function the manager is for, innermost first
+std::vector<naturalLoop> findLoops(AnalysisManager& analyses);
+
+// Function to give every loop a preheader, inserting a block where there is none.
+// Returns true if the CFG changed; the manager has been told already.
+bool insertPreheaders(AnalysisManager& analyses);
+
+#endif // LOOPS_H
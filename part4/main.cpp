@@ -1,11 +1,16 @@
 #include "semantic_analysis.h"
 #include "ast.h"
-#include "preprocessor.h"
 #include <cstdio>
-#include <stack>
+#include <cstring>
+#include <string>
 #include <vector>
 #include "llvm_builder.h"
 #include "llvm_parser.h"  // Include the llvm_parser header
+#include "source_input.h"
+#include "compact_ast.h"
+#include "compilation_context.h"
+#include "register_alloc.h"
+#include "assembly_code_gen.h"
 
 extern "C" {
     #include <llvm-c/Core.h>
@@ -14,30 +19,103 @@ extern "C" {
     #include <llvm-c/Initialization.h>
 }
 
-extern FILE *yyin;             // Declare yyin as an external variable
-extern int yyparse();          // Declare yyparse as an external function
-extern void yylex_destroy();   // Declare yylex_destroy as an external function
-extern astNode *rootNode;      // Declare rootNode as an external variable
+extern int yyparse(void* scanner, CompilationContext* ctx);   // Declare yyparse as an external function
+extern int yylex_destroy(void* scanner);                      // Declare yylex_destroy as an external function
 
-using SymbolTable = std::vector<char *>;
+LLVMModuleRef generateLLVMIR(CompilationContext& ctx, astNode* root, bool ssa);
+LLVMModuleRef generateLLVMIRCompact(CompilationContext& ctx, const compactAst& ast, bool ssa);
 
-LLVMModuleRef generateLLVMIR(astNode* root);
-LLVMValueRef functionTraversal(LLVMModuleRef mod, astNode* funcNode); // Declare the function here
-void rename_variables(astNode* node);
+int compileFile(const char* path, const char* irPath, const char* asmPath, bool compactMode, bool ssaMode,
+                registerAllocator allocator);
 
-// Function declarations for register allocation and assembly generation
-void registerAllocation(LLVMModuleRef module);
-void generateAssembly(LLVMModuleRef module);
+// Function to give path with its extension replaced, foo.c -> foo.s
+static std::string replaceExtension(const std::string& path, const char* extension) {
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return path + extension;
+    }
+    return path.substr(0, dot) + extension;
+}
+
+// What compileFile holds of the source and the tree. It is released on every way out of the compile,
+// rejected files included.
+struct compileResources {
+    sourceBuffer source = {};
+    void* scanner = NULL;
+    bool arena_open = false;
+
+    void beginArena() {
+        astArenaBegin();
+        arena_open = true;
+    }
+    void endArena() {
+        if (arena_open) {
+            astArenaEnd();
+            arena_open = false;
+        }
+    }
+    ~compileResources() {
+        endArena();
+        if (scanner != NULL) {
+            yylex_destroy(scanner);
+        }
+        closeSourceBuffer(&source);
+    }
+};
 
 int main(int argc, char* argv[]) {
-    if (argc == 2) {
-        yyin = fopen(argv[1], "r");
-        if (yyin == NULL) {
-            fprintf(stderr, "File open error\n");
-            return 1;
+    // Parse command line: [-compact-ast] [-ssa] [-regalloc=linear|graph] [-o <file.s>] <file>
+    const char* path = NULL;
+    const char* output = NULL;
+    bool compactMode = false;
+    bool ssaMode = false;
+    registerAllocator allocator = ALLOCATOR_LINEAR_SCAN;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-compact-ast") == 0) {
+            compactMode = true;
+        } else if (strcmp(argv[i], "-ssa") == 0) {
+            ssaMode = true;
+        } else if (strcmp(argv[i], "-regalloc=linear") == 0) {
+            allocator = ALLOCATOR_LINEAR_SCAN;
+        } else if (strcmp(argv[i], "-regalloc=graph") == 0) {
+            allocator = ALLOCATOR_GRAPH_COLORING;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (argv[i][0] != '-' && path == NULL) {
+            path = argv[i];
+        } else {
+            path = NULL;
+            break;
         }
-    } else {
-        fprintf(stderr, "Usage: %s <file>\n", argv[0]);
+    }
+
+    if (path == NULL) {
+        fprintf(stderr, "Usage: %s [-compact-ast] [-ssa] [-regalloc=linear|graph] [-o <file.s>] <file>\n", argv[0]);
+        return 1;
+    }
+
+    // The assembly goes next to the source unless -o says otherwise, and the IR next to the assembly
+    std::string asmPath = output != NULL ? output : replaceExtension(path, ".s");
+    std::string irPath = replaceExtension(asmPath, ".ll");
+    int result = compileFile(path, irPath.c_str(), asmPath.c_str(), compactMode, ssaMode, allocator);
+
+    LLVMShutdown(); // Clean up LLVM's internal state, after every context is gone
+    return result;
+}
+
+// Function to compile one source file into the IR at irPath and the assembly at asmPath. All of its state
+// is in a context of its own and it writes only its own outputs, so separate files can be compiled on
+// separate threads at the same time.
+int compileFile(const char* path, const char* irPath, const char* asmPath, bool compactMode, bool ssaMode,
+                registerAllocator allocator) {
+    // Everything this compile creates or changes belongs to ctx, which is current until compileFile returns
+    CompilationContext ctx;
+    CompilationScope scope(&ctx);
+
+    // Map the source and let the lexer scan it in place; declared after ctx so it is released first
+    compileResources res;
+    if (!openSourceBuffer(path, &res.source) || !scanSourceBuffer(&res.source, &res.scanner)) {
         return 1;
     }
 
@@ -45,80 +123,116 @@ int main(int argc, char* argv[]) {
     yydebug = 1;
     #endif
 
-    yyparse();
+    // Allocate the whole AST from one arena so it can be released in one go
+    res.beginArena();
+    yyparse(res.scanner, &ctx);
+    astNode* rootNode = ctx.rootNode;
 
     if (rootNode == NULL) {
         fprintf(stderr, "root is null\n");
         return 1;
     }
 
-    std::stack<SymbolTable> symbolTableStack;
-    if (rootNode != NULL) {
-        if (!visitNode(rootNode, symbolTableStack)) {
+    LLVMModuleRef mod = NULL;
+    if (compactMode) {
+        // Copy the tree into the index-based layout; the pointer tree is not needed after that
+        compactAst ast;
+        flattenAst(rootNode, ast);
+        res.endArena();
+
+        if (!visitCompactAst(ast)) {
+            fprintf(stderr, "didn't visit root node\n");
+            return 1;
+        }
+        mod = generateLLVMIRCompact(ctx, ast, ssaMode);
+    } else {
+        ScopedSymbolTable symbols;
+        if (!visitNode(rootNode, symbols)) {
             fprintf(stderr, "didn't visit root node\n");
-            freeNode(rootNode);
             return 1;
         }
-
-        // Preprocess to rename variables
-        rename_variables(rootNode);
 
         // Generate LLVM IR
-        LLVMModuleRef mod = generateLLVMIR(rootNode);
+        mod = generateLLVMIR(ctx, rootNode, ssaMode);
 
-        // Optionally, you can print the generated LLVM IR to stdout
-        char* ir_string = LLVMPrintModuleToString(mod);
-        printf("%s", ir_string);
-        LLVMDisposeMessage(ir_string);
-
-        // Write LLVM IR to a file
-        if (LLVMPrintModuleToFile(mod, "output.ll", nullptr) != 0) {
-            fprintf(stderr, "Error writing LLVM IR to file\n");
-        }
+        // Releases every node and statement list of the tree at once
+        res.endArena();
+    }
 
-        // Call the llvm_parser function to perform optimizations
-        walkFunctions(mod);
+    // Optionally, you can print the generated LLVM IR to stdout
+    char* ir_string = LLVMPrintModuleToString(mod);
+    printf("%s", ir_string);
+    LLVMDisposeMessage(ir_string);
 
-        // Perform register allocation
-        registerAllocation(mod);
+    // Write LLVM IR to a file; LLVM reports why it could not through error
+    char* error = NULL;
+    if (LLVMPrintModuleToFile(mod, irPath, &error) != 0) {
+        fprintf(stderr, "Error writing LLVM IR to file: %s\n", error);
+        LLVMDisposeMessage(error);
+    }
 
-        // Generate assembly code
-        generateAssembly(mod);
+    // Call the llvm_parser function to perform optimizations
+    walkFunctions(mod);
 
-        // Cleanup the module
-        LLVMDisposeModule(mod);
+    // Perform register allocation with the allocator the command line picked
+    moduleAllocation allocations = registerAllocation(mod, allocator);
 
-        freeNode(rootNode);
-    }  
+    // Generate assembly code in the registers the allocator chose, ready to link with runtime.c
+    FILE* asmFile = fopen(asmPath, "w");
+    if (asmFile == NULL) {
+        fprintf(stderr, "Error writing assembly to file %s\n", asmPath);
+    } else {
+        generateAssembly(mod, allocations, asmFile);
+        fclose(asmFile);
+    }
 
-    fclose(yyin);
-    yylex_destroy();
-    LLVMShutdown(); // Clean up LLVM's internal state
+    // Cleanup the module; res releases the scanner and the source
+    LLVMDisposeModule(mod);
 
-    return 0;
+    return asmFile == NULL ? 1 : 0;
 }
 
 // Function to generate LLVM IR from AST
-LLVMModuleRef generateLLVMIR(astNode* root) {
-    LLVMModuleRef mod = LLVMModuleCreateWithName("my_module");
+LLVMModuleRef generateLLVMIR(CompilationContext& ctx, astNode* root, bool ssa) {
+    LLVMModuleRef mod = LLVMModuleCreateWithNameInContext("my_module", ctx.llvm);
     LLVMSetTarget(mod, "x86_64-pc-linux-gnu");
 
-    LLVMBuilderRef builder = LLVMCreateBuilder();
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(ctx.llvm);
 
     // Generate extern function declarations for print and read
-    LLVMTypeRef int32Type = LLVMInt32Type();
-    LLVMTypeRef voidType = LLVMVoidType();
+    LLVMTypeRef int32Type = LLVMInt32TypeInContext(ctx.llvm);
+    LLVMTypeRef voidType = LLVMVoidTypeInContext(ctx.llvm);
     LLVMTypeRef printType = LLVMFunctionType(voidType, &int32Type, 1, 0);
     LLVMAddFunction(mod, "print", printType);
     
     LLVMTypeRef readType = LLVMFunctionType(int32Type, NULL, 0, 0);
     LLVMAddFunction(mod, "read", readType);
 
-    // Visit the function node (assuming root is a function node)
-    LLVMValueRef func = functionTraversal(mod, root);
+    // Visit the function node of the program
+    LLVMValueRef func = functionTraversal(ctx, mod, root->prog.func, ssa);
 
     // Memory cleanup
     LLVMDisposeBuilder(builder);
 
     return mod;
 }
+
+// Function to generate LLVM IR from the compact AST
+LLVMModuleRef generateLLVMIRCompact(CompilationContext& ctx, const compactAst& ast, bool ssa) {
+    LLVMModuleRef mod = LLVMModuleCreateWithNameInContext("my_module", ctx.llvm);
+    LLVMSetTarget(mod, "x86_64-pc-linux-gnu");
+
+    // Generate extern function declarations for print and read
+    LLVMTypeRef int32Type = LLVMInt32TypeInContext(ctx.llvm);
+    LLVMTypeRef voidType = LLVMVoidTypeInContext(ctx.llvm);
+    LLVMTypeRef printType = LLVMFunctionType(voidType, &int32Type, 1, 0);
+    LLVMAddFunction(mod, "print", printType);
+
+    LLVMTypeRef readType = LLVMFunctionType(int32Type, NULL, 0, 0);
+    LLVMAddFunction(mod, "read", readType);
+
+    // Node 0 is the program; its third child is the function
+    functionTraversalCompact(ctx, mod, ast, ast.c[0], ssa);
+
+    return mod;
+}
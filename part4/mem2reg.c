@@ -0,0 +1,229 @@
+/*
+*   Purpose: This file implements the promotion of allocas to SSA values (Cytron et al.): phi placement at
+*   iterated dominance frontiers, then renaming in a depth first walk of the dominator tree with one stack
+*   of current values per variable. Loads and stores in blocks that cannot be reached are dropped; a load
+*   there reads undef.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "mem2reg.h"
+
+// Function to check if every use of an alloca is the address of a load or a store
+static bool isPromotable(LLVMValueRef alloca) {
+    for (LLVMUseRef use = LLVMGetFirstUse(alloca); use != NULL; use = LLVMGetNextUse(use)) {
+        LLVMValueRef user = LLVMGetUser(use);
+        LLVMOpcode opcode = LLVMGetInstructionOpcode(user);
+        if (opcode == LLVMLoad && LLVMTypeOf(user) == LLVMGetAllocatedType(alloca)) {
+            continue;
+        }
+        if (opcode == LLVMStore && LLVMGetOperand(user, 1) == alloca && LLVMGetOperand(user, 0) != alloca &&
+            LLVMTypeOf(LLVMGetOperand(user, 0)) == LLVMGetAllocatedType(alloca)) {
+            continue;
+        }
+        return false;
+    }
+    return true;
+}
+
+unsigned promoteAllocas(AnalysisManager& analyses, blockWorklist& dirty) {
+    LLVMValueRef function = analyses.function();
+    LLVMBasicBlockRef entry = LLVMGetEntryBasicBlock(function);
+
+    // Variables to promote, numbered densely
+    std::vector<LLVMValueRef> allocas;
+    std::unordered_map<LLVMValueRef, uint32_t> allocaIds;
+    for (LLVMValueRef instr = LLVMGetFirstInstruction(entry); instr != NULL; instr = LLVMGetNextInstruction(instr)) {
+        if (LLVMIsAAllocaInst(instr) && isPromotable(instr)) {
+            allocaIds[instr] = (uint32_t)allocas.size();
+            allocas.push_back(instr);
+        }
+    }
+    if (allocas.empty()) {
+        return CHANGED_NOTHING;
+    }
+    printf("Promoting %zu allocas to SSA values\n", allocas.size());
+
+    LLVMContextRef llvm = LLVMGetModuleContext(LLVMGetGlobalParent(function));
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(llvm);
+
+    // Phi placement: the iterated dominance frontier of the blocks storing to each variable
+    std::unordered_map<LLVMValueRef, uint32_t> phiVariable;     // placed phi -> variable
+    std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMValueRef>> blockPhis;
+    for (uint32_t v = 0; v < allocas.size(); v++) {
+        std::vector<LLVMBasicBlockRef> worklist;
+        std::unordered_set<LLVMBasicBlockRef> inWorklist;
+        for (LLVMUseRef use = LLVMGetFirstUse(allocas[v]); use != NULL; use = LLVMGetNextUse(use)) {
+            LLVMValueRef user = LLVMGetUser(use);
+            if (LLVMGetInstructionOpcode(user) == LLVMStore && inWorklist.insert(LLVMGetInstructionParent(user)).second) {
+                worklist.push_back(LLVMGetInstructionParent(user));
+            }
+        }
+
+        std::unordered_set<LLVMBasicBlockRef> hasPhi;
+        std::string name = LLVMGetValueName(allocas[v]);
+        while (!worklist.empty()) {
+            LLVMBasicBlockRef bb = worklist.back();
+            worklist.pop_back();
+            for (LLVMBasicBlockRef join : analyses.dominanceFrontier(bb)) {
+                if (!hasPhi.insert(join).second) {
+                    continue;
+                }
+                LLVMValueRef first = LLVMGetFirstInstruction(join);
+                LLVMPositionBuilderBefore(builder, first);
+                LLVMValueRef phi = LLVMBuildPhi(builder, LLVMGetAllocatedType(allocas[v]), name.c_str());
+                phiVariable[phi] = v;
+                blockPhis[join].push_back(phi);
+                // a phi is a new definition of the variable
+                if (inWorklist.insert(join).second) {
+                    worklist.push_back(join);
+                }
+            }
+        }
+    }
+
+    // Renaming along the dominator tree. Each stack entry remembers how many values it pushed per variable.
+    std::vector<std::vector<LLVMValueRef>> current(allocas.size());
+    std::unordered_set<LLVMBasicBlockRef> visited;
+    std::vector<LLVMValueRef> memoryOps;
+    unsigned promotedLoads = 0, promotedStores = 0;
+
+    struct frame {
+        LLVMBasicBlockRef bb;
+        size_t nextChild;
+        std::vector<uint32_t> pushed;   // variables given a new value in bb, once per push
+    };
+    std::vector<frame> stack;
+    stack.push_back({LLVMGetEntryBasicBlock(function), 0, {}});
+    while (!stack.empty()) {
+        if (stack.back().nextChild == 0 && visited.insert(stack.back().bb).second) {
+            LLVMBasicBlockRef bb = stack.back().bb;
+            std::vector<uint32_t>& pushed = stack.back().pushed;
+
+            for (LLVMValueRef phi : blockPhis[bb]) {
+                current[phiVariable[phi]].push_back(phi);
+                pushed.push_back(phiVariable[phi]);
+            }
+            for (LLVMValueRef instr = LLVMGetFirstInstruction(bb); instr != NULL; instr = LLVMGetNextInstruction(instr)) {
+                LLVMOpcode opcode = LLVMGetInstructionOpcode(instr);
+                if (opcode != LLVMLoad && opcode != LLVMStore) {
+                    continue;
+                }
+                auto id = allocaIds.find(LLVMGetOperand(instr, opcode == LLVMLoad ? 0 : 1));
+                if (id == allocaIds.end()) {
+                    continue;
+                }
+                if (opcode == LLVMLoad) {
+                    std::vector<LLVMValueRef>& values = current[id->second];
+                    LLVMValueRef value = values.empty() ? LLVMGetUndef(LLVMTypeOf(instr)) : values.back();
+                    LLVMReplaceAllUsesWith(instr, value);
+                    promotedLoads++;
+                } else {
+                    current[id->second].push_back(LLVMGetOperand(instr, 0));
+                    pushed.push_back(id->second);
+                    promotedStores++;
+                }
+                memoryOps.push_back(instr);
+            }
+
+            // the value leaving bb flows into the phis of its successors
+            for (LLVMBasicBlockRef successor : analyses.successors().at(bb)) {
+                for (LLVMValueRef phi : blockPhis[successor]) {
+                    std::vector<LLVMValueRef>& values = current[phiVariable[phi]];
+                    LLVMValueRef value = values.empty() ? LLVMGetUndef(LLVMTypeOf(phi)) : values.back();
+                    LLVMAddIncoming(phi, &value, &bb, 1);
+                }
+            }
+        }
+
+        LLVMBasicBlockRef bb = stack.back().bb;
+        const std::vector<LLVMBasicBlockRef>& children = analyses.dominatorChildren(bb);
+        if (stack.back().nextChild < children.size()) {
+            LLVMBasicBlockRef child = children[stack.back().nextChild++];
+            stack.push_back({child, 0, {}});
+        } else {
+            for (uint32_t v : stack.back().pushed) {
+                current[v].pop_back();
+            }
+            stack.pop_back();
+        }
+    }
+
+    // Unreachable blocks: their loads read undef, and their edges into a join still need phi entries
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(function); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        if (visited.count(bb)) {
+            continue;
+        }
+        for (LLVMValueRef instr = LLVMGetFirstInstruction(bb); instr != NULL; instr = LLVMGetNextInstruction(instr)) {
+            LLVMOpcode opcode = LLVMGetInstructionOpcode(instr);
+            if ((opcode == LLVMLoad || opcode == LLVMStore) && allocaIds.count(LLVMGetOperand(instr, opcode == LLVMLoad ? 0 : 1))) {
+                if (opcode == LLVMLoad) {
+                    LLVMReplaceAllUsesWith(instr, LLVMGetUndef(LLVMTypeOf(instr)));
+                }
+                memoryOps.push_back(instr);
+            }
+        }
+        for (LLVMBasicBlockRef successor : analyses.successors().at(bb)) {
+            for (LLVMValueRef phi : blockPhis[successor]) {
+                LLVMValueRef value = LLVMGetUndef(LLVMTypeOf(phi));
+                LLVMAddIncoming(phi, &value, &bb, 1);
+            }
+        }
+    }
+
+    for (LLVMValueRef instr : memoryOps) {
+        dirty.push(LLVMGetInstructionParent(instr));
+        LLVMInstructionEraseFromParent(instr);
+    }
+    for (LLVMValueRef alloca : allocas) {
+        LLVMInstructionEraseFromParent(alloca);
+    }
+    dirty.push(entry);
+
+    // Phis only feeding other phis are dead: keep the ones some other instruction needs, directly or not
+    std::unordered_set<LLVMValueRef> livePhis;
+    std::vector<LLVMValueRef> worklist;
+    for (auto& p : phiVariable) {
+        for (LLVMUseRef use = LLVMGetFirstUse(p.first); use != NULL; use = LLVMGetNextUse(use)) {
+            if (!LLVMIsAPHINode(LLVMGetUser(use))) {
+                livePhis.insert(p.first);
+                worklist.push_back(p.first);
+                break;
+            }
+        }
+    }
+    while (!worklist.empty()) {
+        LLVMValueRef phi = worklist.back();
+        worklist.pop_back();
+        for (unsigned i = 0; i < LLVMCountIncoming(phi); i++) {
+            LLVMValueRef incoming = LLVMGetIncomingValue(phi, i);
+            if (phiVariable.count(incoming) && livePhis.insert(incoming).second) {
+                worklist.push_back(incoming);
+            }
+        }
+    }
+    unsigned deadPhis = 0;
+    for (auto& p : phiVariable) {
+        if (!livePhis.count(p.first)) {
+            LLVMReplaceAllUsesWith(p.first, LLVMGetUndef(LLVMTypeOf(p.first)));
+        }
+    }
+    for (auto& p : phiVariable) {
+        if (!livePhis.count(p.first)) {
+            LLVMInstructionEraseFromParent(p.first);
+            deadPhis++;
+        } else {
+            dirty.push(LLVMGetInstructionParent(p.first));
+        }
+    }
+
+    LLVMDisposeBuilder(builder);
+    printf("Promoted %u loads and %u stores, placed %zu phis of which %u were dead\n",
+           promotedLoads, promotedStores, phiVariable.size(), deadPhis);
+    return CHANGED_VALUES | CHANGED_MEMORY;
+}
@@ -0,0 +1,26 @@
+/*
+*   Purpose: This is the .h file for the promotion of local variables to SSA values. The llvm builder (in
+*   memory mode) and clang give every variable an alloca that is read with loads and written with stores;
+*   this pass turns such variables into SSA values with phi nodes, the way -ssa builds them directly.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#ifndef MEM2REG_H
+#define MEM2REG_H
+
+#include <llvm-c/Core.h>
+#include "llvm_parser.h"
+
+/**
+ *
+ * Promotes every alloca of the entry block that is only used as the address of loads and stores. Phis are
+ * placed at the iterated dominance frontier of the blocks storing to the variable, values are renamed
+ * along the dominator tree, and the loads, stores and allocas are deleted. Phis that no real instruction
+ * ends up using are deleted again. Every block that changed is queued on dirty.
+ *
+ * returns: the irChange kinds made
+ */
+unsigned promoteAllocas(AnalysisManager& analyses, blockWorklist& dirty);
+
+#endif // MEM2REG_H
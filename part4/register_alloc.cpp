@@ -1,152 +1,416 @@
 /*
-*   Purpose: This file is a responsible for handing the register allocation process for the backend processing of the compiler. 
-*   It follows the algorithm provided on Canvas and is based on the linear scan register allocation algorithm.
+*   Purpose: This file is a responsible for handing the register allocation process for the backend processing of the compiler.
+*   Liveness comes from a backward dataflow problem over the whole CFG, and the live interval of a value is the
+*   list of its ranges in the blocks it is live in, with the blocks in reverse postorder. Linear scan walks the
+*   intervals by start over the whole function. An interval that cannot keep a register for all of its blocks
+*   is split at a block boundary: the blocks before keep the register and the rest is allocated again later.
 *   Author: Carly Retterer
 *   Date:  30 May 2024
 *
 *
 */
 
-#include <iostream>
-#include <vector>
-#include <map>
-#include <algorithm>
-#include <llvm-c/Core.h>
-#include <llvm-c/Analysis.h>
-#include <llvm-c/BitWriter.h>
-#include <llvm-c/Transforms/PassManagerBuilder.h>
-
-#define NUM_REGISTERS 3
-
-// Function declarations
-std::pair<std::map<LLVMValueRef, int>, std::map<LLVMValueRef, std::pair<int, int>>> compute_liveness(LLVMBasicBlockRef BB);
-LLVMValueRef find_spill(LLVMValueRef Instr, std::map<LLVMValueRef, int>& reg_map, std::map<LLVMValueRef, int>& inst_index, std::vector<LLVMValueRef>& sorted_list, std::map<LLVMValueRef, std::pair<int, int>>& live_range);
-
-std::pair<std::map<LLVMValueRef, int>, std::map<LLVMValueRef, std::pair<int, int>>> compute_liveness(LLVMBasicBlockRef BB) {
-    std::map<LLVMValueRef, int> inst_index;
-    std::map<LLVMValueRef, std::pair<int, int>> live_range;
-    
+#include <stdio.h>
+#include <climits>
+#include <set>
+#include "register_alloc.h"
+#include "analysis_manager.h"
+#include "graph_coloring.h"
+
+bool liveInterval::covers(int position) const {
+    for (const liveRange& range : ranges) {
+        if (range.start <= position && position < range.end) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// INT_MAX when the value is not read again
+int liveInterval::nextUseAfter(int position) const {
+    std::vector<int>::const_iterator it = std::lower_bound(uses.begin(), uses.end(), position);
+    return it == uses.end() ? INT_MAX : *it;
+}
+
+// The value is live across a call if it is live both where the call reads its operands and after the call
+// wrote its own. INT_MAX when there is no such call.
+int liveInterval::firstCallCrossed(const std::vector<int>& calls) const {
+    for (int call : calls) {
+        for (const liveRange& range : ranges) {
+            if (range.start <= call && call + 1 < range.end) {
+                return call;
+            }
+        }
+    }
+    return INT_MAX;
+}
+
+LLVMBasicBlockRef functionLiveness::blockAt(int position) const {
+    size_t low = 0;
+    size_t high = order.size();
+    while (high - low > 1) {
+        size_t middle = (low + high) / 2;
+        if (block_range.at(order[middle]).start <= position) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    return order[low];
+}
+
+// Function to tell if an instruction gives a value that needs a register or a stack slot of its own
+static bool needsLocation(LLVMValueRef instr) {
+    return LLVMGetTypeKind(LLVMTypeOf(instr)) != LLVMVoidTypeKind && LLVMGetInstructionOpcode(instr) != LLVMAlloca;
+}
+
+functionLiveness computeLiveness(LLVMValueRef function) {
+    functionLiveness liveness;
+    AnalysisManager analyses(function);
+    liveness.order = analyses.reversePostorder();
+
+    // Number the values, and the instructions in the linear order
+    for (unsigned i = 0; i < LLVMCountParams(function); i++) {
+        liveness.value_ids[LLVMGetParam(function, i)] = liveness.values.size();
+        liveness.values.push_back(LLVMGetParam(function, i));
+    }
     int index = 0;
-    // First pass: assign indices to each instruction
-    for (LLVMValueRef Instr = LLVMGetFirstInstruction(BB); Instr; Instr = LLVMGetNextInstruction(Instr)) {
-        if (LLVMGetInstructionOpcode(Instr) == LLVMAlloca) {
-            continue; // Ignore alloc instructions
+    for (LLVMBasicBlockRef bb : liveness.order) {
+        int first = 2 * index;
+        for (LLVMValueRef instr = LLVMGetFirstInstruction(bb); instr; instr = LLVMGetNextInstruction(instr)) {
+            liveness.position[instr] = 2 * index++;
+            if (LLVMGetInstructionOpcode(instr) == LLVMCall) {
+                liveness.calls.push_back(liveness.position[instr]);
+            }
+            if (needsLocation(instr)) {
+                liveness.value_ids[instr] = liveness.values.size();
+                liveness.values.push_back(instr);
+            }
         }
-        inst_index[Instr] = index++;
-        live_range[Instr] = {inst_index[Instr], inst_index[Instr]};
+        liveness.block_range[bb] = {first, 2 * index};
+    }
+    for (const naturalLoop& loop : analyses.loops()) {
+        for (LLVMBasicBlockRef bb : loop.blocks) {
+            liveness.loop_depth[bb] = std::max(liveness.loop_depth[bb], loop.depth);
+        }
+    }
+    size_t numValues = liveness.values.size();
+    liveness.intervals.resize(numValues);
+    for (size_t id = 0; id < numValues; id++) {
+        liveness.intervals[id].value = liveness.values[id];
     }
+    auto idOf = [&](LLVMValueRef value) {
+        std::map<LLVMValueRef, int>::const_iterator it = liveness.value_ids.find(value);
+        return it == liveness.value_ids.end() ? -1 : it->second;
+    };
 
-    // Second pass: update the live ranges based on operands usage
-    for (LLVMValueRef Instr = LLVMGetFirstInstruction(BB); Instr; Instr = LLVMGetNextInstruction(Instr)) {
-        if (LLVMGetInstructionOpcode(Instr) == LLVMAlloca) {
-            continue; // Ignore alloc instructions
+    // GEN is what a block reads before writing it, KILL what it writes. A phi reads its operand at the
+    // bottom of the incoming block, so the operand counts as read there and not in the block of the phi.
+    dataflowProblem problem = {DATAFLOW_BACKWARD, MEET_UNION, numValues, {}, {}};
+    bbBits phiUses;
+    for (LLVMBasicBlockRef bb : liveness.order) {
+        bitVector gen(numValues);
+        bitVector kill(numValues);
+        for (LLVMValueRef instr = LLVMGetFirstInstruction(bb); instr; instr = LLVMGetNextInstruction(instr)) {
+            if (!LLVMIsAPHINode(instr)) {
+                for (int i = 0; i < LLVMGetNumOperands(instr); i++) {
+                    int id = idOf(LLVMGetOperand(instr, i));
+                    if (id >= 0 && !kill.test(id)) {
+                        gen.set(id);
+                    }
+                }
+            }
+            if (idOf(instr) >= 0) {
+                kill.set(idOf(instr));
+            }
+        }
+        problem.gen[bb] = gen;
+        problem.kill[bb] = kill;
+        phiUses[bb] = bitVector(numValues);
+    }
+    for (LLVMBasicBlockRef bb : liveness.order) {
+        for (LLVMValueRef phi = LLVMGetFirstInstruction(bb); phi && LLVMIsAPHINode(phi); phi = LLVMGetNextInstruction(phi)) {
+            for (unsigned i = 0; i < LLVMCountIncoming(phi); i++) {
+                LLVMBasicBlockRef pred = LLVMGetIncomingBlock(phi, i);
+                int id = idOf(LLVMGetIncomingValue(phi, i));
+                if (id < 0 || liveness.block_range.count(pred) == 0) {
+                    continue;
+                }
+                phiUses[pred].set(id);
+                if (!problem.kill[pred].test(id)) {
+                    problem.gen[pred].set(id);
+                }
+                liveness.intervals[id].uses.push_back(liveness.block_range[pred].end - 1);
+            }
         }
-        for (unsigned i = 0; i < LLVMGetNumOperands(Instr); ++i) {
-            LLVMValueRef operand = LLVMGetOperand(Instr, i);
-            if (inst_index.find(operand) != inst_index.end()) {
-                live_range[operand].second = std::max(live_range[operand].second, inst_index[Instr]);
+    }
+
+    dataflowResult result = solveDataflow(function, problem, analyses.predecessors(), liveness.order);
+    liveness.live_in = result.in;
+    liveness.live_out = result.out;
+    for (LLVMBasicBlockRef bb : liveness.order) {
+        liveness.live_out[bb].unionWith(phiUses[bb]);
+    }
+
+    // Build the intervals backwards: blocks in reverse linear order, instructions from the bottom up, so
+    // every new range is at or before the earliest one the interval has
+    for (std::vector<LLVMBasicBlockRef>::reverse_iterator it = liveness.order.rbegin(); it != liveness.order.rend(); ++it) {
+        LLVMBasicBlockRef bb = *it;
+        liveRange block = liveness.block_range[bb];
+        auto addRange = [&](int id, int start, int end) {
+            std::vector<liveRange>& ranges = liveness.intervals[id].ranges;
+            if (!ranges.empty() && ranges.back().start < block.end) {
+                ranges.back().start = std::min(ranges.back().start, start);
+                ranges.back().end = std::max(ranges.back().end, end);
+            } else {
+                ranges.push_back({start, end});
+            }
+        };
+        // a definition starts the range; a value nobody reads still needs a place to be written to
+        auto setStart = [&](int id, int start) {
+            std::vector<liveRange>& ranges = liveness.intervals[id].ranges;
+            if (!ranges.empty() && ranges.back().start < block.end) {
+                ranges.back().start = start;
+            } else {
+                ranges.push_back({start, start + 1});
+            }
+        };
+
+        liveness.live_out[bb].forEach([&](size_t id) { addRange(id, block.start, block.end); });
+        for (LLVMValueRef instr = LLVMGetLastInstruction(bb); instr && !LLVMIsAPHINode(instr); instr = LLVMGetPreviousInstruction(instr)) {
+            int position = liveness.position[instr];
+            if (idOf(instr) >= 0) {
+                setStart(idOf(instr), position + 1);
+            }
+            for (int i = 0; i < LLVMGetNumOperands(instr); i++) {
+                int id = idOf(LLVMGetOperand(instr, i));
+                if (id >= 0) {
+                    addRange(id, block.start, position + 1);
+                    liveness.intervals[id].uses.push_back(position);
+                }
             }
         }
+        for (LLVMValueRef phi = LLVMGetFirstInstruction(bb); phi && LLVMIsAPHINode(phi); phi = LLVMGetNextInstruction(phi)) {
+            setStart(idOf(phi), block.start);
+        }
+    }
+    for (liveInterval& interval : liveness.intervals) {
+        std::reverse(interval.ranges.begin(), interval.ranges.end());
+        std::sort(interval.uses.begin(), interval.uses.end());
     }
 
-    return {inst_index, live_range};
+    return liveness;
 }
 
-// sorted list is by the end of live range in descending order
-LLVMValueRef find_spill(LLVMValueRef Instr, std::map<LLVMValueRef, int>& reg_map, std::map<LLVMValueRef, int>& inst_index, std::vector<LLVMValueRef>& sorted_list, std::map<LLVMValueRef, std::pair<int, int>>& live_range) {
-    for (LLVMValueRef V : sorted_list) {
-        // checking that current variable is still live and that it's currently assigned to a register
-        if (live_range[V].second > inst_index[Instr] && reg_map[V] != -1) {
-            // spill that instruction
-            return V;
+// Function to find the first position two intervals are both live at, or -1 if there is none
+int firstIntersection(const liveInterval& a, const liveInterval& b) {
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a.ranges.size() && j < b.ranges.size()) {
+        int start = std::max(a.ranges[i].start, b.ranges[j].start);
+        if (start < std::min(a.ranges[i].end, b.ranges[j].end)) {
+            return start;
+        }
+        if (a.ranges[i].end <= b.ranges[j].end) {
+            i++;
+        } else {
+            j++;
         }
     }
-    return NULL; // if no instructions match 
+    return -1;
 }
 
-void registerAllocation(LLVMModuleRef module) {
-    for (LLVMValueRef function = LLVMGetFirstFunction(module); function; function = LLVMGetNextFunction(function)) {
-        for (LLVMBasicBlockRef BB = LLVMGetFirstBasicBlock(function); BB; BB = LLVMGetNextBasicBlock(BB)) {
-            int available_registers[NUM_REGISTERS] = {1, 1, 1}; // ebx, ecx, edx
-            std::map<LLVMValueRef, int> reg_map;
-            std::vector<LLVMValueRef> sorted_list;
-
-            // Call compute_liveness to populate inst_index and live_range
-            auto [inst_index, live_range] = compute_liveness(BB);
-            
-            // Populate sorted_list with instructions in the basic block
-            for (LLVMValueRef Instr = LLVMGetFirstInstruction(BB); Instr; Instr = LLVMGetNextInstruction(Instr)) {
-                sorted_list.push_back(Instr);
-            }
-            
-            // Sort sorted_list based on the end of the live range in descending order
-            std::sort(sorted_list.begin(), sorted_list.end(), [&live_range](LLVMValueRef a, LLVMValueRef b) {
-                return live_range[a].second > live_range[b].second;
-            });
-
-            // Register allocation process
-            for (LLVMValueRef Instr = LLVMGetFirstInstruction(BB); Instr; Instr = LLVMGetNextInstruction(Instr)) {
-                if (LLVMGetInstructionOpcode(Instr) == LLVMAlloca) {
-                    continue; // Ignore alloc instructions
+functionAllocation linearScan(const functionLiveness& liveness, int numRegisters) {
+    functionAllocation allocation;
+    std::vector<liveInterval> intervals;
+    std::set<std::pair<int, size_t>> unhandled;     // by start position
+    for (const liveInterval& interval : liveness.intervals) {
+        if (!interval.ranges.empty()) {
+            unhandled.insert({interval.start(), intervals.size()});
+            intervals.push_back(interval);
+        }
+    }
+    std::vector<size_t> active;     // hold their register at the current position
+    std::vector<size_t> inactive;   // hold it later, but are in a hole between two blocks now
+
+    // Function to cut an interval before its range k; the new interval gets ranges k onwards
+    auto splitAt = [&](size_t index, size_t k) {
+        liveInterval rest;
+        rest.value = intervals[index].value;
+        rest.ranges.assign(intervals[index].ranges.begin() + k, intervals[index].ranges.end());
+        intervals[index].ranges.resize(k);
+        std::vector<int> kept;
+        for (int use : intervals[index].uses) {
+            (use < rest.start() ? kept : rest.uses).push_back(use);
+        }
+        intervals[index].uses = kept;
+        intervals.push_back(rest);
+        allocation.splits++;
+        return intervals.size() - 1;
+    };
+    auto removeFrom = [](std::vector<size_t>& list, size_t index) {
+        list.erase(std::find(list.begin(), list.end(), index));
+    };
+
+    while (!unhandled.empty()) {
+        int position = unhandled.begin()->first;
+        size_t current = unhandled.begin()->second;
+        unhandled.erase(unhandled.begin());
+
+        // Intervals that ended are done, and the others move between active and inactive
+        std::vector<size_t> stillActive;
+        std::vector<size_t> stillInactive;
+        for (size_t index : active) {
+            if (intervals[index].end() > position) {
+                (intervals[index].covers(position) ? stillActive : stillInactive).push_back(index);
+            }
+        }
+        for (size_t index : inactive) {
+            if (intervals[index].end() > position) {
+                (intervals[index].covers(position) ? stillActive : stillInactive).push_back(index);
+            }
+        }
+        active = stillActive;
+        inactive = stillInactive;
+
+        // How long each register stays free
+        std::vector<int> freeUntil(numRegisters, INT_MAX);
+        for (size_t index : active) {
+            freeUntil[intervals[index].reg] = 0;
+        }
+        for (size_t index : inactive) {
+            int intersection = firstIntersection(intervals[index], intervals[current]);
+            if (intersection >= 0) {
+                freeUntil[intervals[index].reg] = std::min(freeUntil[intervals[index].reg], intersection);
+            }
+        }
+        // a call ends what a caller-saved register can hold
+        int call = intervals[current].firstCallCrossed(liveness.calls);
+        for (int reg = 0; reg < FIRST_CALLEE_SAVED && reg < numRegisters; reg++) {
+            freeUntil[reg] = std::min(freeUntil[reg], call);
+        }
+        int reg = std::max_element(freeUntil.begin(), freeUntil.end()) - freeUntil.begin();
+
+        // The blocks that end before the register is taken can have it
+        size_t fits = 0;
+        while (fits < intervals[current].ranges.size() && intervals[current].ranges[fits].end <= freeUntil[reg]) {
+            fits++;
+        }
+        if (fits == intervals[current].ranges.size()) {
+            intervals[current].reg = reg;
+        } else if (fits > 0) {
+            unhandled.insert({intervals[current].ranges[fits].start, splitAt(current, fits)});
+            intervals[current].reg = reg;
+        } else {
+            // No register is free: the value read last stays in memory
+            std::vector<int> nextUse(numRegisters, INT_MAX);
+            for (size_t index : active) {
+                nextUse[intervals[index].reg] = std::min(nextUse[intervals[index].reg], intervals[index].nextUseAfter(position));
+            }
+            for (size_t index : inactive) {
+                if (firstIntersection(intervals[index], intervals[current]) >= 0) {
+                    nextUse[intervals[index].reg] = std::min(nextUse[intervals[index].reg], intervals[index].nextUseAfter(position));
+                }
+            }
+            // the first block cannot be in a caller-saved register if it has a call the value lives across
+            size_t callRange = 0;
+            while (callRange < intervals[current].ranges.size() && intervals[current].ranges[callRange].end <= call) {
+                callRange++;
+            }
+            if (callRange == 0) {
+                for (int reg = 0; reg < FIRST_CALLEE_SAVED && reg < numRegisters; reg++) {
+                    nextUse[reg] = -1;
                 }
+            }
+            reg = std::max_element(nextUse.begin(), nextUse.end()) - nextUse.begin();
 
-                if (LLVMGetInstructionOpcode(Instr) == LLVMStore || LLVMGetInstructionOpcode(Instr) == LLVMBr || LLVMGetInstructionOpcode(Instr) == LLVMCall) {
-                    for (unsigned i = 0; i < LLVMGetNumOperands(Instr); ++i) {
-                        LLVMValueRef operand = LLVMGetOperand(Instr, i);
-                        // If live range of any operand of Instr ends, and it has a physical register P assigned
-                        // to it then add P to available set of registers.
-                        if (live_range[operand].second == inst_index[Instr] && reg_map[operand] != -1) {
-                            available_registers[reg_map[operand]] = 1;
-                        }
+            if (intervals[current].nextUseAfter(position) > nextUse[reg]) {
+                // only its first block is spilled, the later ones get another chance
+                if (intervals[current].ranges.size() > 1) {
+                    unhandled.insert({intervals[current].ranges[1].start, splitAt(current, 1)});
+                }
+                intervals[current].reg = SPILLED;
+            } else {
+                // The holders of reg give it up from the block they are in now. The blocks after that
+                // are allocated again.
+                std::vector<size_t> holders;
+                for (size_t index : active) {
+                    if (intervals[index].reg == reg) {
+                        holders.push_back(index);
                     }
-                    continue;
                 }
-
-                if (LLVMGetInstructionOpcode(Instr) == LLVMAdd || LLVMGetInstructionOpcode(Instr) == LLVMMul || LLVMGetInstructionOpcode(Instr) == LLVMSub) {
-                    LLVMValueRef first_operand = LLVMGetOperand(Instr, 0);
-                    LLVMValueRef second_operand = LLVMGetOperand(Instr, 1);
-
-                    if (reg_map[first_operand] != -1 && live_range[first_operand].second == inst_index[Instr]) {
-                        reg_map[Instr] = reg_map[first_operand];
-                    } else if (available_registers[0] || available_registers[1] || available_registers[2]) {  //if physical registers are available
-                        for (int i = 0; i < NUM_REGISTERS; ++i) {
-                            if (available_registers[i]) {
-                                reg_map[Instr] = i;
-                                available_registers[i] = 0;
-                                break;
-                            }
+                for (size_t index : inactive) {
+                    if (intervals[index].reg == reg && firstIntersection(intervals[index], intervals[current]) >= 0) {
+                        holders.push_back(index);
+                    }
+                }
+                for (size_t holder : holders) {
+                    size_t k = 0;
+                    while (intervals[holder].ranges[k].end <= position) {
+                        k++;
+                    }
+                    if (intervals[holder].covers(position)) {
+                        removeFrom(active, holder);
+                        if (k + 1 < intervals[holder].ranges.size()) {
+                            unhandled.insert({intervals[holder].ranges[k + 1].start, splitAt(holder, k + 1)});
                         }
-                    } else {   // if physical register is not available 
-                        LLVMValueRef V = find_spill(Instr, reg_map, inst_index, sorted_list, live_range);
-                        if (live_range[V].second > live_range[Instr].second) {
-                            reg_map[Instr] = -1;
+                        if (k == 0) {
+                            intervals[holder].reg = SPILLED;
                         } else {
-                            reg_map[Instr] = reg_map[V];
-                            reg_map[V] = -1;
+                            splitAt(holder, k);     // the piece in this block, left in memory
                         }
-                    }
-
-                    // If the live range of the first operand ends, add its register to the available set
-                    if (live_range[first_operand].second == inst_index[Instr] && reg_map[first_operand] != -1) {
-                        available_registers[reg_map[first_operand]] = 1;
-                    }
-
-                    // If the live range of the second operand ends, add its register to the available set
-                    if (live_range[second_operand].second == inst_index[Instr] && reg_map[second_operand] != -1) {
-                        available_registers[reg_map[second_operand]] = 1;
+                    } else {
+                        removeFrom(inactive, holder);
+                        unhandled.insert({intervals[holder].ranges[k].start, splitAt(holder, k)});
                     }
                 }
-
-                // If the live range of any operand ends, add its register to the available set
-                for (unsigned i = 0; i < LLVMGetNumOperands(Instr); ++i) {
-                    LLVMValueRef operand = LLVMGetOperand(Instr, i);
-                    if (live_range[operand].second == inst_index[Instr] && reg_map[operand] != -1) {
-                        available_registers[reg_map[operand]] = 1;
-                    }
+                if (reg < FIRST_CALLEE_SAVED && callRange < intervals[current].ranges.size()) {
+                    unhandled.insert({intervals[current].ranges[callRange].start, splitAt(current, callRange)});
                 }
+                intervals[current].reg = reg;
+            }
+        }
+
+        if (intervals[current].reg != SPILLED) {
+            active.push_back(current);
+        }
+    }
+
+    // Where each value is in each block
+    for (const liveInterval& interval : intervals) {
+        for (const liveRange& range : interval.ranges) {
+            allocation.location[interval.value][liveness.blockAt(range.start)] = interval.reg;
+        }
+    }
+    for (const auto& value : allocation.location) {
+        for (const auto& block : value.second) {
+            if (block.second == SPILLED) {
+                allocation.spilled_values++;
+                break;
             }
         }
     }
+    return allocation;
 }
 
-
+moduleAllocation registerAllocation(LLVMModuleRef module, registerAllocator allocator) {
+    moduleAllocation allocations;
+    for (LLVMValueRef function = LLVMGetFirstFunction(module); function; function = LLVMGetNextFunction(function)) {
+        if (LLVMCountBasicBlocks(function) == 0) {
+            continue;   // declarations like print and read
+        }
+        functionLiveness liveness = computeLiveness(function);
+        functionAllocation allocation;
+        if (allocator == ALLOCATOR_GRAPH_COLORING) {
+            allocation = graphColoring(liveness, NUM_REGISTERS);
+            printf("Graph coloring on %s: %zu values, %u coalesced, %u spilled\n", LLVMGetValueName(function),
+                   allocation.location.size(), allocation.coalesced, allocation.spilled_values);
+        } else {
+            allocation = linearScan(liveness, NUM_REGISTERS);
+            printf("Linear scan on %s: %zu values, %u splits, %u spilled\n", LLVMGetValueName(function),
+                   allocation.location.size(), allocation.splits, allocation.spilled_values);
+        }
+        allocations[function] = allocation;
+    }
+    return allocations;
+}
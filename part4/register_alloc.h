@@ -1,5 +1,8 @@
 /*
-*   Purpose: This is my .h file for register allocation. 
+*   Purpose: This is my .h file for register allocation. Liveness is computed over the whole function with the
+*   dataflow solver, and every value gets a live interval in the linear order of the blocks (reverse postorder).
+*   Linear scan then hands out the registers for the whole function at once, so a value can stay in a register
+*   across branches and around loops. Graph coloring (graph_coloring.h) is the other allocator on the same liveness.
 *   Author: Carly Retterer
 *   Date: 30 May 2024
 */
@@ -15,12 +18,75 @@
 #include <llvm-c/Analysis.h>
 #include <llvm-c/BitWriter.h>
 #include <llvm-c/Transforms/PassManagerBuilder.h>
+#include "dataflow.h"
 
-#define NUM_REGISTERS 3
+// x86-64 registers handed out: 0 to 7 are caller-saved (rcx, rdx, rsi, rdi, r8 to r11) and 8 to 12 are
+// callee-saved (rbx, r12 to r15). %rax is the scratch register and %rbp/%rsp hold the frame.
+#define NUM_REGISTERS 13
+#define FIRST_CALLEE_SAVED 8
+
+// The allocator a compile uses, picked with -regalloc=linear|graph
+enum registerAllocator {
+    ALLOCATOR_LINEAR_SCAN,      // fast, splits intervals at block boundaries
+    ALLOCATOR_GRAPH_COLORING    // slower, coalesces phi moves and keeps a value in one register everywhere
+};
+
+// Location of a value that is kept in its stack slot instead of a register
+#define SPILLED -1
+
+// Half open range [start, end) of positions in the linear order. The k-th instruction reads its operands at
+// 2k and writes its value at 2k + 1, so a value can take the register of an operand that dies there.
+struct liveRange {
+    int start;
+    int end;
+};
+
+// Where one value (or a piece of it, after a split) is live
+struct liveInterval {
+    LLVMValueRef value;
+    std::vector<liveRange> ranges;  // sorted, at most one per basic block
+    std::vector<int> uses;          // positions reading the value, sorted; a phi reads at the end of the predecessor
+    int reg = SPILLED;
+
+    int start() const { return ranges.front().start; }
+    int end() const { return ranges.back().end; }
+    bool covers(int position) const;
+    int nextUseAfter(int position) const;
+    int firstCallCrossed(const std::vector<int>& calls) const;
+};
+
+// Liveness of one function
+struct functionLiveness {
+    std::vector<LLVMBasicBlockRef> order;               // blocks in linear order
+    std::map<LLVMBasicBlockRef, liveRange> block_range; // positions of each block
+    std::map<LLVMValueRef, int> position;               // instruction -> the position it reads its operands at
+    std::vector<LLVMValueRef> values;                   // value number -> argument or instruction
+    std::map<LLVMValueRef, int> value_ids;              // the values that need a location, allocas aside
+    bbBits live_in;                                     // values live at the top of each block, its phis aside
+    bbBits live_out;                                    // values live at the bottom, phi operands included
+    std::vector<int> calls;                             // positions of the calls, which clobber the caller-saved registers
+    std::map<LLVMBasicBlockRef, unsigned> loop_depth;   // blocks inside loops, how deeply they are nested
+    std::vector<liveInterval> intervals;                // by value number
+
+    // Block whose positions hold position
+    LLVMBasicBlockRef blockAt(int position) const;
+};
+
+// Registers of one function: the register each value has in each block it is live in, or SPILLED
+struct functionAllocation {
+    std::map<LLVMValueRef, std::map<LLVMBasicBlockRef, int>> location;
+    unsigned spilled_values = 0;    // values that are in memory in at least one block
+    unsigned splits = 0;            // intervals cut at a block boundary
+    unsigned coalesced = 0;         // phi moves removed by giving both values the same register
+};
+
+// Allocation of every function with a body
+using moduleAllocation = std::map<LLVMValueRef, functionAllocation>;
 
 // Function declarations
-std::pair<std::map<LLVMValueRef, int>, std::map<LLVMValueRef, std::pair<int, int>>> compute_liveness(LLVMBasicBlockRef BB);
-LLVMValueRef find_spill(LLVMValueRef Instr, std::map<LLVMValueRef, int>& reg_map, std::map<LLVMValueRef, int>& inst_index, std::vector<LLVMValueRef>& sorted_list, std::map<LLVMValueRef, std::pair<int, int>>& live_range);
-void registerAllocation(LLVMModuleRef module);
+functionLiveness computeLiveness(LLVMValueRef function);
+int firstIntersection(const liveInterval& a, const liveInterval& b);
+functionAllocation linearScan(const functionLiveness& liveness, int numRegisters);
+moduleAllocation registerAllocation(LLVMModuleRef module, registerAllocator allocator);
 
 #endif // REGISTER_ALLOCATION_H
@@ -0,0 +1,30 @@
+/*
+*   Purpose: This file is the runtime the programs our compiler generates are linked with. It has the print and
+*   read functions miniC programs declare as extern, and a main that calls func with the number given on the
+*   command line and prints what it returns.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+int func(int n);
+
+void print(int value) {
+    printf("%d\n", value);
+}
+
+int read() {
+    int value = 0;
+    if (scanf("%d", &value) != 1) {
+        return 0;
+    }
+    return value;
+}
+
+int main(int argc, char* argv[]) {
+    int n = argc > 1 ? atoi(argv[1]) : 0;
+    printf("%d\n", func(n));
+    return 0;
+}
@@ -0,0 +1,310 @@
+/*
+*   Purpose: This file implements sparse conditional constant propagation. Two worklists drive the solver:
+*   blocks that just became reachable, and instructions whose lattice value went down and whose users
+*   have to be looked at again. Each value can only go down twice, so the solver runs in time linear in
+*   the number of uses and edges.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "sccp.h"
+
+// Function to fold opcode over constant integer operands. Returns NULL if the result is not a constant
+// (division by zero, or an operation this pass does not know).
+static LLVMValueRef foldInteger(LLVMValueRef instr, LLVMValueRef a, LLVMValueRef b) {
+    LLVMTypeRef type = LLVMTypeOf(instr);
+    if (LLVMGetTypeKind(type) != LLVMIntegerTypeKind || !LLVMIsAConstantInt(a) || (b != NULL && !LLVMIsAConstantInt(b))) {
+        return NULL;
+    }
+    unsigned width = LLVMGetIntTypeWidth(LLVMTypeOf(a));
+    int64_t sa = LLVMConstIntGetSExtValue(a);
+    uint64_t ua = LLVMConstIntGetZExtValue(a);
+    int64_t sb = b ? LLVMConstIntGetSExtValue(b) : 0;
+    uint64_t ub = b ? LLVMConstIntGetZExtValue(b) : 0;
+    int64_t minValue = width >= 64 ? INT64_MIN : -((int64_t)1 << (width - 1));
+
+    // results are computed in 64 bits and truncated to the type by LLVMConstInt
+    switch (LLVMGetInstructionOpcode(instr)) {
+        case LLVMAdd:  return LLVMConstInt(type, ua + ub, 0);
+        case LLVMSub:  return LLVMConstInt(type, ua - ub, 0);
+        case LLVMMul:  return LLVMConstInt(type, ua * ub, 0);
+        case LLVMSDiv:
+            if (sb == 0 || (sa == minValue && sb == -1)) {
+                return NULL;    // traps, or overflows
+            }
+            return LLVMConstInt(type, (uint64_t)(sa / sb), 1);
+        case LLVMSRem:
+            if (sb == 0 || (sa == minValue && sb == -1)) {
+                return NULL;
+            }
+            return LLVMConstInt(type, (uint64_t)(sa % sb), 1);
+        case LLVMUDiv: return ub == 0 ? NULL : LLVMConstInt(type, ua / ub, 0);
+        case LLVMURem: return ub == 0 ? NULL : LLVMConstInt(type, ua % ub, 0);
+        case LLVMAnd:  return LLVMConstInt(type, ua & ub, 0);
+        case LLVMOr:   return LLVMConstInt(type, ua | ub, 0);
+        case LLVMXor:  return LLVMConstInt(type, ua ^ ub, 0);
+        case LLVMShl:  return ub >= width ? NULL : LLVMConstInt(type, ua << ub, 0);
+        case LLVMLShr: return ub >= width ? NULL : LLVMConstInt(type, ua >> ub, 0);
+        case LLVMAShr: return ub >= width ? NULL : LLVMConstInt(type, (uint64_t)(sa >> ub), 1);
+        case LLVMTrunc:
+        case LLVMZExt: return LLVMConstInt(type, ua, 0);
+        case LLVMSExt: return LLVMConstInt(type, (uint64_t)sa, 1);
+        case LLVMICmp: {
+            bool result;
+            switch (LLVMGetICmpPredicate(instr)) {
+                case LLVMIntEQ:  result = ua == ub; break;
+                case LLVMIntNE:  result = ua != ub; break;
+                case LLVMIntSGT: result = sa > sb; break;
+                case LLVMIntSGE: result = sa >= sb; break;
+                case LLVMIntSLT: result = sa < sb; break;
+                case LLVMIntSLE: result = sa <= sb; break;
+                case LLVMIntUGT: result = ua > ub; break;
+                case LLVMIntUGE: result = ua >= ub; break;
+                case LLVMIntULT: result = ua < ub; break;
+                case LLVMIntULE: result = ua <= ub; break;
+                default: return NULL;
+            }
+            return LLVMConstInt(type, result, 0);
+        }
+        default:
+            return NULL;
+    }
+}
+
+// State of one run of the solver
+typedef struct {
+    std::unordered_map<LLVMValueRef, latticeValue> values;
+    std::set<std::pair<LLVMBasicBlockRef, LLVMBasicBlockRef>> executableEdges;
+    std::unordered_set<LLVMBasicBlockRef> executableBlocks;
+    std::vector<LLVMBasicBlockRef> blockWorklist;
+    std::vector<LLVMValueRef> valueWorklist;
+} sccpState;
+
+static latticeValue getLattice(sccpState& state, LLVMValueRef value) {
+    if (LLVMIsAConstantInt(value)) {
+        return {LATTICE_CONSTANT, value};
+    }
+    if (LLVMIsUndef(value)) {
+        return {LATTICE_UNKNOWN, NULL};     // undef may be taken to be any constant
+    }
+    if (!LLVMIsAInstruction(value)) {
+        return {LATTICE_VARYING, NULL};     // arguments, globals
+    }
+    auto it = state.values.find(value);
+    return it == state.values.end() ? latticeValue{LATTICE_UNKNOWN, NULL} : it->second;
+}
+
+// Function to move value down to newValue; queues its users if that is a change
+static void updateLattice(sccpState& state, LLVMValueRef value, latticeValue newValue) {
+    latticeValue& old = state.values.insert({value, {LATTICE_UNKNOWN, NULL}}).first->second;
+    if (old.kind == newValue.kind && old.constant == newValue.constant) {
+        return;
+    }
+    if (old.kind == LATTICE_CONSTANT && newValue.kind == LATTICE_CONSTANT) {
+        newValue = {LATTICE_VARYING, NULL};     // two different constants
+    }
+    if (old.kind == LATTICE_VARYING) {
+        return;     // values never go back up
+    }
+    old = newValue;
+    state.valueWorklist.push_back(value);
+}
+
+static void visitInstruction(sccpState& state, LLVMValueRef instr);
+
+static void markEdgeExecutable(sccpState& state, LLVMBasicBlockRef from, LLVMBasicBlockRef to) {
+    if (!state.executableEdges.insert({from, to}).second) {
+        return;
+    }
+    if (state.executableBlocks.insert(to).second) {
+        state.blockWorklist.push_back(to);
+    } else {
+        // the block was visited already; only its phis can see the new edge
+        for (LLVMValueRef phi = LLVMGetFirstInstruction(to); phi != NULL && LLVMIsAPHINode(phi); phi = LLVMGetNextInstruction(phi)) {
+            visitInstruction(state, phi);
+        }
+    }
+}
+
+static void visitInstruction(sccpState& state, LLVMValueRef instr) {
+    LLVMBasicBlockRef bb = LLVMGetInstructionParent(instr);
+    LLVMOpcode opcode = LLVMGetInstructionOpcode(instr);
+
+    if (opcode == LLVMPHI) {
+        // meet of the values coming in over executable edges
+        latticeValue result = {LATTICE_UNKNOWN, NULL};
+        for (unsigned i = 0; i < LLVMCountIncoming(instr) && result.kind != LATTICE_VARYING; i++) {
+            if (!state.executableEdges.count({LLVMGetIncomingBlock(instr, i), bb})) {
+                continue;
+            }
+            latticeValue incoming = getLattice(state, LLVMGetIncomingValue(instr, i));
+            if (incoming.kind == LATTICE_UNKNOWN) {
+                continue;
+            }
+            if (result.kind == LATTICE_UNKNOWN) {
+                result = incoming;
+            } else if (incoming.kind == LATTICE_VARYING || incoming.constant != result.constant) {
+                result = {LATTICE_VARYING, NULL};
+            }
+        }
+        updateLattice(state, instr, result);
+        return;
+    }
+
+    if (opcode == LLVMBr) {
+        if (!LLVMIsConditional(instr)) {
+            markEdgeExecutable(state, bb, LLVMGetSuccessor(instr, 0));
+            return;
+        }
+        latticeValue cond = getLattice(state, LLVMGetCondition(instr));
+        if (cond.kind == LATTICE_CONSTANT) {
+            // successor 0 is taken on true
+            markEdgeExecutable(state, bb, LLVMGetSuccessor(instr, LLVMConstIntGetZExtValue(cond.constant) ? 0 : 1));
+        } else if (cond.kind == LATTICE_VARYING) {
+            markEdgeExecutable(state, bb, LLVMGetSuccessor(instr, 0));
+            markEdgeExecutable(state, bb, LLVMGetSuccessor(instr, 1));
+        }
+        return;
+    }
+
+    if (LLVMGetTypeKind(LLVMTypeOf(instr)) == LLVMVoidTypeKind) {
+        return;     // stores, void calls, returns
+    }
+
+    if (!isValueNumberable(instr)) {
+        updateLattice(state, instr, {LATTICE_VARYING, NULL});   // loads, calls, allocas
+        return;
+    }
+
+    // pure expression: constant if every operand is, varying as soon as one is
+    LLVMValueRef operands[2] = {NULL, NULL};
+    for (int i = 0; i < LLVMGetNumOperands(instr); i++) {
+        latticeValue operand = getLattice(state, LLVMGetOperand(instr, i));
+        if (operand.kind == LATTICE_VARYING) {
+            updateLattice(state, instr, {LATTICE_VARYING, NULL});
+            return;
+        }
+        if (operand.kind == LATTICE_UNKNOWN) {
+            return;     // wait for the operand
+        }
+        operands[i] = operand.constant;
+    }
+    LLVMValueRef folded = foldInteger(instr, operands[0], operands[1]);
+    if (folded != NULL) {
+        updateLattice(state, instr, {LATTICE_CONSTANT, folded});
+    } else {
+        updateLattice(state, instr, {LATTICE_VARYING, NULL});
+    }
+}
+
+unsigned propagateConstants(AnalysisManager& analyses, blockWorklist& dirty) {
+    LLVMValueRef function = analyses.function();
+    sccpState state;
+    LLVMBasicBlockRef entry = LLVMGetEntryBasicBlock(function);
+    state.executableBlocks.insert(entry);
+    state.blockWorklist.push_back(entry);
+
+    printf("Starting sparse conditional constant propagation\n");
+    unsigned visits = 0;
+    bool resolved = true;
+    while (resolved) {
+        while (!state.blockWorklist.empty() || !state.valueWorklist.empty()) {
+            while (!state.valueWorklist.empty()) {
+                LLVMValueRef value = state.valueWorklist.back();
+                state.valueWorklist.pop_back();
+                for (LLVMUseRef use = LLVMGetFirstUse(value); use != NULL; use = LLVMGetNextUse(use)) {
+                    LLVMValueRef user = LLVMGetUser(use);
+                    if (state.executableBlocks.count(LLVMGetInstructionParent(user))) {
+                        visitInstruction(state, user);
+                        visits++;
+                    }
+                }
+            }
+            if (!state.blockWorklist.empty()) {
+                LLVMBasicBlockRef bb = state.blockWorklist.back();
+                state.blockWorklist.pop_back();
+                for (LLVMValueRef instr = LLVMGetFirstInstruction(bb); instr != NULL; instr = LLVMGetNextInstruction(instr)) {
+                    visitInstruction(state, instr);
+                    visits++;
+                }
+            }
+        }
+
+        // A condition still unknown now depends on undef (an uninitialized local) and the branch is left
+        // with no successor taken, which would make the phis after it look like the branch never runs.
+        // Such a branch can go either way: both edges are taken and the solver runs again.
+        resolved = false;
+        for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(function); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+            LLVMValueRef terminator = LLVMGetBasicBlockTerminator(bb);
+            if (!state.executableBlocks.count(bb) || terminator == NULL || LLVMGetInstructionOpcode(terminator) != LLVMBr ||
+                !LLVMIsConditional(terminator) || getLattice(state, LLVMGetCondition(terminator)).kind != LATTICE_UNKNOWN) {
+                continue;
+            }
+            for (unsigned i = 0; i < 2; i++) {
+                if (!state.executableEdges.count({bb, LLVMGetSuccessor(terminator, i)})) {
+                    markEdgeExecutable(state, bb, LLVMGetSuccessor(terminator, i));
+                    resolved = true;
+                }
+            }
+        }
+    }
+
+    // Replace the constants
+    unsigned replaced = 0;
+    unsigned changes = CHANGED_NOTHING;
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(function); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        if (!state.executableBlocks.count(bb)) {
+            continue;
+        }
+        LLVMValueRef instr = LLVMGetFirstInstruction(bb);
+        while (instr != NULL) {
+            LLVMValueRef nextInstr = LLVMGetNextInstruction(instr);
+            latticeValue value = getLattice(state, instr);
+            if (value.kind == LATTICE_CONSTANT && !hasSideEffects(instr)) {
+                markUsersDirty(instr, dirty);
+                LLVMReplaceAllUsesWith(instr, value.constant);
+                LLVMInstructionEraseFromParent(instr);
+                replaced++;
+                changes |= CHANGED_VALUES;
+            }
+            instr = nextInstr;
+        }
+    }
+
+    // Branches that always go one way
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(LLVMGetModuleContext(LLVMGetGlobalParent(function)));
+    unsigned foldedBranches = 0;
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(function); bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+        LLVMValueRef terminator = LLVMGetBasicBlockTerminator(bb);
+        if (!state.executableBlocks.count(bb) || terminator == NULL || LLVMGetInstructionOpcode(terminator) != LLVMBr ||
+            !LLVMIsConditional(terminator) || !LLVMIsAConstantInt(LLVMGetCondition(terminator))) {
+            continue;
+        }
+        bool condition = LLVMConstIntGetZExtValue(LLVMGetCondition(terminator)) != 0;
+        LLVMBasicBlockRef taken = LLVMGetSuccessor(terminator, condition ? 0 : 1);
+        LLVMBasicBlockRef dropped = LLVMGetSuccessor(terminator, condition ? 1 : 0);
+        LLVMPositionBuilderBefore(builder, terminator);
+        LLVMBuildBr(builder, taken);
+        LLVMInstructionEraseFromParent(terminator);
+        if (dropped != taken) {
+            removePhiEntries(dropped, bb);
+            dirty.push(dropped);
+        }
+        dirty.push(bb);
+        foldedBranches++;
+        changes |= CHANGED_CFG;
+    }
+    LLVMDisposeBuilder(builder);
+
+    unsigned unreachable = LLVMCountBasicBlocks(function) - (unsigned)state.executableBlocks.size();
+    printf("SCCP: %u instruction visits, %u constants replaced, %u branches folded, %u unreachable blocks\n",
+           visits, replaced, foldedBranches, unreachable);
+    return changes;
+}
@@ -0,0 +1,39 @@
+/*
+*   Purpose: This is the .h file for sparse conditional constant propagation (Wegman and Zadeck). Every SSA
+*   value starts out unknown and can only move down the lattice unknown -> constant -> not constant, and a
+*   block is only looked at once an edge into it is known to be taken. Constants therefore flow through phis
+*   and across branches that turn out to always go one way, in a single run over the def-use chains.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#ifndef SCCP_H
+#define SCCP_H
+
+#include <llvm-c/Core.h>
+#include "llvm_parser.h"
+
+enum latticeKind {
+    LATTICE_UNKNOWN,    // no value seen yet (top)
+    LATTICE_CONSTANT,   // always this constant
+    LATTICE_VARYING     // not a constant (bottom)
+};
+
+typedef struct {
+    latticeKind kind;
+    LLVMValueRef constant;  // for LATTICE_CONSTANT
+} latticeValue;
+
+/**
+ *
+ * Runs SCCP over the function the manager is for. Instructions found constant are replaced by the
+ * constant, conditional branches on a constant become unconditional, and the phis of the block no longer
+ * branched to lose that entry. Blocks found unreachable are left in place for the CFG cleanup. Folds
+ * arithmetic (add, sub, mul, sdiv, srem and the negation sub 0, x), bitwise operations, shifts, integer
+ * casts and icmp.
+ *
+ * returns: the irChange kinds made
+ */
+unsigned propagateConstants(AnalysisManager& analyses, blockWorklist& dirty);
+
+#endif // SCCP_H
@@ -0,0 +1,301 @@
+/*
+*   Purpose: This file implements the scalar evolution of counting loops and the replacement of their exit
+*   values. The trip count of a loop continuing while counter < bound with counter = {start, +, step} is
+*   ceil((bound - start) / step) when start < bound and 0 otherwise; the other signed tests are the same
+*   up to the sign of the step and one extra trip for <= and >=. Everything is computed in 64 bits, so
+*   bound - start cannot overflow.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+#include "scev.h"
+
+// Function to check if a value is the same on every iteration of a loop
+static bool isLoopInvariant(const naturalLoop& loop, LLVMValueRef value) {
+    return !LLVMIsAInstruction(value) || loop.members.count(LLVMGetInstructionParent(value)) == 0;
+}
+
+std::vector<addRecurrence> findAddRecurrences(const naturalLoop& loop) {
+    std::vector<addRecurrence> recurrences;
+    if (loop.preheader == NULL || loop.latches.size() != 1) {
+        return recurrences;
+    }
+    for (LLVMValueRef phi = LLVMGetFirstInstruction(loop.header); phi != NULL && LLVMIsAPHINode(phi);
+         phi = LLVMGetNextInstruction(phi)) {
+        if (LLVMGetTypeKind(LLVMTypeOf(phi)) != LLVMIntegerTypeKind || LLVMGetIntTypeWidth(LLVMTypeOf(phi)) >= 64 ||
+            LLVMCountIncoming(phi) != 2) {
+            continue;
+        }
+        addRecurrence recurrence = {phi, NULL, NULL, NULL};
+        for (unsigned i = 0; i < 2; i++) {
+            if (LLVMGetIncomingBlock(phi, i) == loop.preheader) {
+                recurrence.start = LLVMGetIncomingValue(phi, i);
+            } else if (LLVMGetIncomingBlock(phi, i) == loop.latches[0]) {
+                recurrence.next = LLVMGetIncomingValue(phi, i);
+            }
+        }
+        if (recurrence.start == NULL || recurrence.next == NULL || !LLVMIsAInstruction(recurrence.next)) {
+            continue;
+        }
+
+        // next is phi + step, step + phi or phi - step
+        LLVMValueRef next = recurrence.next;
+        LLVMOpcode opcode = LLVMGetInstructionOpcode(next);
+        LLVMValueRef lhs = LLVMGetNumOperands(next) == 2 ? LLVMGetOperand(next, 0) : NULL;
+        LLVMValueRef rhs = LLVMGetNumOperands(next) == 2 ? LLVMGetOperand(next, 1) : NULL;
+        if (opcode == LLVMAdd && lhs == phi && isLoopInvariant(loop, rhs)) {
+            recurrence.step = rhs;
+        } else if (opcode == LLVMAdd && rhs == phi && isLoopInvariant(loop, lhs)) {
+            recurrence.step = lhs;
+        } else if (opcode == LLVMSub && lhs == phi && LLVMIsAConstantInt(rhs)) {
+            recurrence.step = LLVMConstNeg(rhs);
+        } else {
+            continue;
+        }
+        recurrences.push_back(recurrence);
+    }
+    return recurrences;
+}
+
+// Function to give the predicate that holds for b, a when predicate holds for a, b
+static LLVMIntPredicate swapSignedPredicate(LLVMIntPredicate predicate) {
+    switch (predicate) {
+        case LLVMIntSLT: return LLVMIntSGT;
+        case LLVMIntSLE: return LLVMIntSGE;
+        case LLVMIntSGT: return LLVMIntSLT;
+        case LLVMIntSGE: return LLVMIntSLE;
+        default:         return predicate;
+    }
+}
+
+// Function to give the predicate that holds when predicate does not
+static LLVMIntPredicate invertSignedPredicate(LLVMIntPredicate predicate) {
+    switch (predicate) {
+        case LLVMIntSLT: return LLVMIntSGE;
+        case LLVMIntSLE: return LLVMIntSGT;
+        case LLVMIntSGT: return LLVMIntSLE;
+        case LLVMIntSGE: return LLVMIntSLT;
+        default:         return predicate;
+    }
+}
+
+bool findTripCount(const naturalLoop& loop, const std::vector<addRecurrence>& recurrences, loopTripCount& tripCount) {
+    if (recurrences.empty() || loop.exits.size() != 1) {
+        return false;
+    }
+    // only the header leaves the loop
+    for (LLVMBasicBlockRef bb : loop.blocks) {
+        if (bb == loop.header) {
+            continue;
+        }
+        LLVMValueRef terminator = LLVMGetBasicBlockTerminator(bb);
+        for (unsigned i = 0; terminator != NULL && i < LLVMGetNumSuccessors(terminator); i++) {
+            if (!loop.members.count(LLVMGetSuccessor(terminator, i))) {
+                return false;
+            }
+        }
+    }
+
+    LLVMValueRef branch = LLVMGetBasicBlockTerminator(loop.header);
+    if (branch == NULL || LLVMGetInstructionOpcode(branch) != LLVMBr || !LLVMIsConditional(branch)) {
+        return false;
+    }
+    LLVMValueRef compare = LLVMGetCondition(branch);
+    if (!LLVMIsAICmpInst(compare)) {
+        return false;
+    }
+    LLVMIntPredicate predicate = LLVMGetICmpPredicate(compare);
+    if (predicate != LLVMIntSLT && predicate != LLVMIntSLE && predicate != LLVMIntSGT && predicate != LLVMIntSGE) {
+        return false;
+    }
+    // successor 0 is taken when the compare holds
+    if (!loop.members.count(LLVMGetSuccessor(branch, 0))) {
+        predicate = invertSignedPredicate(predicate);
+    }
+
+    for (const addRecurrence& recurrence : recurrences) {
+        LLVMValueRef lhs = LLVMGetOperand(compare, 0);
+        LLVMValueRef rhs = LLVMGetOperand(compare, 1);
+        LLVMIntPredicate counterPredicate = predicate;
+        if (rhs == recurrence.phi) {
+            std::swap(lhs, rhs);
+            counterPredicate = swapSignedPredicate(predicate);
+        }
+        if (lhs != recurrence.phi || !isLoopInvariant(loop, rhs) || !LLVMIsAConstantInt(recurrence.step)) {
+            continue;
+        }
+        // the counter has to move towards the bound, or the loop never ends
+        int64_t step = LLVMConstIntGetSExtValue(recurrence.step);
+        bool upwards = counterPredicate == LLVMIntSLT || counterPredicate == LLVMIntSLE;
+        if ((upwards && step <= 0) || (!upwards && step >= 0)) {
+            continue;
+        }
+        tripCount.counter = recurrence;
+        tripCount.bound = rhs;
+        tripCount.predicate = counterPredicate;
+        return true;
+    }
+    return false;
+}
+
+// Function to emit the trip count of a loop before the builder's position, as an i64
+static LLVMValueRef buildTripCount(LLVMBuilderRef builder, const loopTripCount& tripCount) {
+    LLVMTypeRef i64 = LLVMInt64TypeInContext(LLVMGetTypeContext(LLVMTypeOf(tripCount.bound)));
+    LLVMValueRef start = LLVMBuildSExt(builder, tripCount.counter.start, i64, "start");
+    LLVMValueRef bound = LLVMBuildSExt(builder, tripCount.bound, i64, "bound");
+    int64_t step = LLVMConstIntGetSExtValue(tripCount.counter.step);
+    bool upwards = tripCount.predicate == LLVMIntSLT || tripCount.predicate == LLVMIntSLE;
+    bool inclusive = tripCount.predicate == LLVMIntSLE || tripCount.predicate == LLVMIntSGE;
+
+    // distance the counter has to cover, one more for <= and >=
+    LLVMValueRef distance = upwards ? LLVMBuildSub(builder, bound, start, "distance")
+                                    : LLVMBuildSub(builder, start, bound, "distance");
+    if (inclusive) {
+        distance = LLVMBuildAdd(builder, distance, LLVMConstInt(i64, 1, 0), "distance");
+    }
+    uint64_t stride = (uint64_t)(upwards ? step : -step);
+    LLVMValueRef rounded = LLVMBuildAdd(builder, distance, LLVMConstInt(i64, stride - 1, 0), "rounded");
+    LLVMValueRef trips = LLVMBuildSDiv(builder, rounded, LLVMConstInt(i64, stride, 0), "trips");
+    LLVMValueRef entered = LLVMBuildICmp(builder, LLVMIntSGT, distance, LLVMConstInt(i64, 0, 0), "entered");
+    return LLVMBuildSelect(builder, entered, trips, LLVMConstInt(i64, 0, 0), "trip_count");
+}
+
+// Function to emit start + trips * step of a recurrence before the builder's position
+static LLVMValueRef buildExitValue(LLVMBuilderRef builder, const addRecurrence& recurrence, LLVMValueRef trips) {
+    LLVMTypeRef i64 = LLVMTypeOf(trips);
+    LLVMValueRef start = LLVMBuildSExt(builder, recurrence.start, i64, "start");
+    LLVMValueRef step = LLVMBuildSExt(builder, recurrence.step, i64, "step");
+    LLVMValueRef value = LLVMBuildAdd(builder, start, LLVMBuildMul(builder, trips, step, "advance"), "exit_value");
+    return LLVMBuildTrunc(builder, value, LLVMTypeOf(recurrence.phi), "exit_value");
+}
+
+// Function to replace the operands equal to value of the users of value outside the loop. Returns how many.
+static unsigned replaceUsesOutside(const naturalLoop& loop, LLVMValueRef value, LLVMValueRef replacement, blockWorklist& dirty) {
+    std::vector<LLVMValueRef> users;
+    for (LLVMUseRef use = LLVMGetFirstUse(value); use != NULL; use = LLVMGetNextUse(use)) {
+        LLVMValueRef user = LLVMGetUser(use);
+        if (!loop.members.count(LLVMGetInstructionParent(user))) {
+            users.push_back(user);
+        }
+    }
+    unsigned replaced = 0;
+    for (LLVMValueRef user : users) {
+        for (int i = 0; i < LLVMGetNumOperands(user); i++) {
+            if (LLVMGetOperand(user, i) == value) {
+                LLVMSetOperand(user, i, replacement);
+                replaced++;
+            }
+        }
+        dirty.push(LLVMGetInstructionParent(user));
+    }
+    return replaced;
+}
+
+// Function to check if a loop leaves nothing behind but the values of its header phis
+static bool isSideEffectFree(const naturalLoop& loop, AnalysisManager& analyses) {
+    for (LLVMBasicBlockRef bb : loop.blocks) {
+        for (LLVMValueRef instr = LLVMGetFirstInstruction(bb); instr != NULL; instr = LLVMGetNextInstruction(instr)) {
+            if (hasSideEffects(instr) && LLVMGetInstructionOpcode(instr) != LLVMBr) {
+                return false;
+            }
+            for (LLVMUseRef use = LLVMGetFirstUse(instr); use != NULL; use = LLVMGetNextUse(use)) {
+                if (!loop.members.count(LLVMGetInstructionParent(LLVMGetUser(use))) &&
+                    !(LLVMIsAPHINode(instr) && bb == loop.header)) {
+                    return false;   // a value of the body is needed after the loop
+                }
+            }
+        }
+    }
+    // an inner loop might not end; only a loop with a known trip count is dropped
+    for (const naturalLoop& other : analyses.loops()) {
+        if (other.header != loop.header && loop.members.count(other.header)) {
+            return false;
+        }
+    }
+    // the exit is entered from the header only, so its phis have a single entry
+    const predMap& preds = analyses.predecessors();
+    return preds.at(loop.exits[0]).size() == 1;
+}
+
+unsigned replaceLoopExitValues(AnalysisManager& analyses, blockWorklist& dirty) {
+    LLVMValueRef function = analyses.function();
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(LLVMGetModuleContext(LLVMGetGlobalParent(function)));
+    unsigned changes = CHANGED_NOTHING;
+    unsigned replaced = 0, removedLoops = 0, countingLoops = 0;
+
+    for (const naturalLoop& loop : analyses.loops()) {
+        std::vector<addRecurrence> recurrences = findAddRecurrences(loop);
+        loopTripCount tripCount;
+        if (!findTripCount(loop, recurrences, tripCount)) {
+            continue;
+        }
+        countingLoops++;
+        bool removable = isSideEffectFree(loop, analyses);
+
+        // recurrences still used after the loop
+        std::vector<addRecurrence> liveOut;
+        for (const addRecurrence& recurrence : recurrences) {
+            for (LLVMUseRef use = LLVMGetFirstUse(recurrence.phi); use != NULL; use = LLVMGetNextUse(use)) {
+                if (!loop.members.count(LLVMGetInstructionParent(LLVMGetUser(use)))) {
+                    liveOut.push_back(recurrence);
+                    break;
+                }
+            }
+        }
+        // a header phi that is not a recurrence keeps the loop
+        for (LLVMValueRef phi = LLVMGetFirstInstruction(loop.header); removable && phi != NULL && LLVMIsAPHINode(phi);
+             phi = LLVMGetNextInstruction(phi)) {
+            bool isRecurrence = false;
+            for (const addRecurrence& recurrence : recurrences) {
+                isRecurrence = isRecurrence || recurrence.phi == phi;
+            }
+            for (LLVMUseRef use = LLVMGetFirstUse(phi); !isRecurrence && use != NULL; use = LLVMGetNextUse(use)) {
+                if (!loop.members.count(LLVMGetInstructionParent(LLVMGetUser(use)))) {
+                    removable = false;
+                }
+            }
+        }
+        if (liveOut.empty() && !removable) {
+            continue;
+        }
+
+        // the operands are invariant, so they are all available at the end of the preheader
+        LLVMPositionBuilderBefore(builder, LLVMGetBasicBlockTerminator(loop.preheader));
+        if (!liveOut.empty()) {
+            LLVMValueRef trips = buildTripCount(builder, tripCount);
+            for (const addRecurrence& recurrence : liveOut) {
+                replaced += replaceUsesOutside(loop, recurrence.phi, buildExitValue(builder, recurrence, trips), dirty);
+            }
+            dirty.push(loop.preheader);
+            changes |= CHANGED_VALUES;
+        }
+
+        if (removable) {
+            // the exit's single entry phis now read values from outside the loop
+            LLVMBasicBlockRef exit = loop.exits[0];
+            LLVMValueRef phi = LLVMGetFirstInstruction(exit);
+            while (phi != NULL && LLVMIsAPHINode(phi)) {
+                LLVMValueRef nextPhi = LLVMGetNextInstruction(phi);
+                LLVMReplaceAllUsesWith(phi, LLVMGetIncomingValue(phi, 0));
+                LLVMInstructionEraseFromParent(phi);
+                phi = nextPhi;
+            }
+            LLVMSetSuccessor(LLVMGetBasicBlockTerminator(loop.preheader), 0, exit);
+            removePhiEntries(loop.header, loop.preheader);
+            dirty.push(loop.preheader);
+            dirty.push(exit);
+            removedLoops++;
+            changes |= CHANGED_VALUES | CHANGED_CFG;
+            break;  // the loops are stale now
+        }
+    }
+    LLVMDisposeBuilder(builder);
+
+    printf("SCEV: %u counting loops, %u uses replaced by exit values, %u loops removed\n",
+           countingLoops, replaced, removedLoops);
+    return changes;
+}
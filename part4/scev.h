@@ -0,0 +1,49 @@
+/*
+*   Purpose: This is the .h file for the scalar evolution analysis of counting loops. An add recurrence is a
+*   header phi that starts at some value and has the same loop-invariant step added on every iteration,
+*   like b in while (b < i) { b = b + 20; }. When the loop test compares such a phi with a loop-invariant
+*   bound, the number of iterations and the value each recurrence leaves the loop with have a closed form.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#ifndef SCEV_H
+#define SCEV_H
+
+#include <llvm-c/Core.h>
+#include <vector>
+#include "llvm_parser.h"
+
+typedef struct {
+    LLVMValueRef phi;       // header phi
+    LLVMValueRef start;     // value coming from the preheader
+    LLVMValueRef step;      // loop-invariant value added on every iteration
+    LLVMValueRef next;      // the add (or sub) feeding the back edge
+} addRecurrence;
+
+typedef struct {
+    addRecurrence counter;  // recurrence the loop test compares
+    LLVMValueRef bound;     // loop-invariant value it is compared with
+    LLVMIntPredicate predicate; // counter predicate bound holds while the loop keeps going
+} loopTripCount;
+
+// Function to find the add recurrences of a loop's header
+std::vector<addRecurrence> findAddRecurrences(const naturalLoop& loop);
+
+// Function to find the test of a loop in the cond/true shape of a while statement: the header is the only
+// block leaving the loop and compares a recurrence with a constant step to an invariant bound, signed.
+// Returns false if the loop is not of that shape.
+bool findTripCount(const naturalLoop& loop, const std::vector<addRecurrence>& recurrences, loopTripCount& tripCount);
+
+/**
+ *
+ * Replaces the uses after a counting loop of its recurrences by their exit value, start + trips * step,
+ * computed in the preheader. A loop without side effects then has nothing left to do and is skipped: the
+ * preheader branches straight to the exit. As in C, the recurrences are taken not to overflow. Loops are
+ * done innermost first; after a loop was removed the pass stops, since the loops are no longer valid.
+ *
+ * returns: the irChange kinds made
+ */
+unsigned replaceLoopExitValues(AnalysisManager& analyses, blockWorklist& dirty);
+
+#endif // SCEV_H
@@ -2,7 +2,7 @@
 *   MiniC Compiler - Semantic Analysis
 *
 *   Purpose: This file is the implementation of the Semantic Analysis for the MiniC compiler. It runs through the AST and
-*   to perform semantic checks and constuct a stack of symbol tables. The purpose of the semantic checks is to ensure proper scope
+*   to perform semantic checks and maintain a scoped symbol table. The purpose of the semantic checks is to ensure proper scope
 *   and declaration of variables. In other words, it ensures that the input file abides by two rules: a variable is declared before it is used
 *   and there is only one declaration of the variable in a scope. 
 *
@@ -12,31 +12,64 @@
 
 #include <stdio.h>
 #include <vector>
-#include <stack>
 #include "ast.h"
 #include "semantic_analysis.h"
-#include <algorithm>
 
-using SymbolTable = vector<std::string>;  // symbol table data structure 
+void ScopedSymbolTable::enterScope(){
+    scopeMarks.push_back(bindings.size());
+}
+
+void ScopedSymbolTable::exitScope(){
+    // undo every binding made in the scope, innermost last
+    size_t mark = scopeMarks.back();
+    scopeMarks.pop_back();
+    while (bindings.size() > mark) {
+        const binding& b = bindings.back();
+        innermost[b.name] = b.shadowed;
+        bindings.pop_back();
+    }
+}
+
+int32_t ScopedSymbolTable::declare(symbolId name){
+    if (name >= innermost.size()) {
+        innermost.resize(symbolCount() > name ? symbolCount() : name + 1, -1);
+    }
+    int32_t prev = innermost[name];
+    if (prev != -1 && bindings[prev].depth == scopeMarks.size()) {
+        return -1;
+    }
+    uint32_t slot = nextSlot++;
+    bindings.push_back({name, (uint32_t)scopeMarks.size(), prev, slot});
+    innermost[name] = (int32_t)bindings.size() - 1;
+    return (int32_t)slot;
+}
 
-bool visitNode(astNode* node, stack<SymbolTable>& symbolTableStack);
+int32_t ScopedSymbolTable::lookup(symbolId name) const{
+    if (name >= innermost.size() || innermost[name] == -1) {
+        return -1;
+    }
+    return (int32_t)bindings[innermost[name]].slot;
+}
 
-bool visitNode(astNode* node, stack<SymbolTable>& symbolTableStack){
+bool visitNode(astNode* node, ScopedSymbolTable& symbols){
     //checking if node passed is a null pointer
     if(node == nullptr){
         fprintf(stderr, "Error: node is null\n");
         return false;
     }
-    // if the node is a block statement node and is body of a function: 
-    // get the top symbol table from the stack and use it as the curr_sym_table 
-    // visit all nodes in the statement list of block statement 
-    // pop top of the stack
+    // every error is reported, and the children are still visited so all of them are
+    bool ok = true;
+
+    // if the node is a function node: 
+    // start numbering slots from 0, open a scope for the function and add the parameter to it
+    // visit all nodes in the statement list of the body block in that same scope
+    // close the scope and record how many slots the function needs
     if (node->type == ast_func) {
             astNode* blockNode = node->func.body;
-            SymbolTable curr_sym_table;
-            symbolTableStack.push(curr_sym_table);
+            symbols.startFunction();
+            symbols.enterScope();
             if (node->func.param != nullptr) {
-                curr_sym_table.push_back(node->func.param->var.name);
+                node->func.param->var.slot = symbols.declare(node->func.param->var.name);
             }
             if (blockNode->stmt.block.stmt_list != nullptr) {
                 for (astNode* stmt : *(blockNode->stmt.block.stmt_list)) {
@@ -45,102 +78,68 @@ bool visitNode(astNode* node, stack<SymbolTable>& symbolTableStack){
                         fprintf(stderr, "Statement node is null\n");
                         continue;
                     }
-                    visitNode(stmt, symbolTableStack);
+                    ok = visitNode(stmt, symbols) && ok;
                 }
             }
-            symbolTableStack.pop();
+            symbols.exitScope();
+            node->func.num_slots = symbols.slotCount();
     }
-        // if the node is a function node: 
-        // create a new symbol table curr_sym_table and push it to the symbol table stack
-        // if func node has a parameter add parameter to curr_sym_table
-        // visit the body node of the function node
-        // pop top of the stack
-    //     else {
-    //         SymbolTable curr_sym_table;
-    //         symbolTableStack.push(curr_sym_table);
-    //         if (node->func.param != nullptr) {
-    //             curr_sym_table.push_back(node->func.param->var.name);
-    //         }
-    //         // checking to make sure function body is not a null pointer
-    //         if (node->func.body == nullptr) {
-    //             fprintf(stderr, "Function body node is null.\n");
-    //             return false;
-    //         } else {
-    //             visitNode(node->func.body, symbolTableStack);
-    //         }
-    //         symbolTableStack.pop();
-    //     }
-    // }
-
 
     // if the node is a block statement node: 
-    // create a new symbol table curr_sym_table and push it to the symbol table stack
+    // open a new scope
     // visit all nodes in the statement list of block statement 
-    // pop top of the stack
+    // close the scope
     if (node->type == ast_stmt && node->stmt.type == ast_block){
-        SymbolTable curr_sym_table;
-        symbolTableStack.push(curr_sym_table);
+        symbols.enterScope();
         if(node->stmt.block.stmt_list != NULL){
             for (astNode* stmt : *(node->stmt.block.stmt_list)) {
                 // handling possible errors where the stmt is a null pointer
                 if(stmt == nullptr){
                     fprintf(stderr, "Statement node is null.\n");
+                    symbols.exitScope();
                     return false;
                 }
-                visitNode(stmt, symbolTableStack);
+                ok = visitNode(stmt, symbols) && ok;
             }
         }
-        symbolTableStack.pop();
+        symbols.exitScope();
     }
 
-    // if the node is a declaration statement, check if the variable is in the symbol table 
-    // at the top of the stack. If it does, then emit an error message. 
-    // Otherwise, add the variable to the symbol table at the top of the stack.
+    // if the node is a declaration statement, check if the variable is already declared in
+    // the innermost scope. If it is, then emit an error message. 
+    // Otherwise, add the variable to the innermost scope and record its slot.
     if(node->type == ast_stmt && node->stmt.type == ast_decl){
-        if (!symbolTableStack.empty()) {
-            //find symbol table at top of stack
-            SymbolTable& curr_table = symbolTableStack.top();
-            char* declName = node->stmt.decl.name;
+        if (symbols.depth() > 0) {
+            symbolId declName = node->stmt.decl.name;
             // making sure declName is not null
-            if(declName == NULL){
+            if(declName == SYM_NONE){
                 fprintf(stderr, "Declaration name is null.\n");
                 return false;
             }
-            //iterate through symbol table
-            if (std::find(curr_table.begin(),curr_table.end(), declName) != curr_table.end()){
-                printf("Error: Variable has already been declared.'%s'\n", declName); 
+            int32_t slot = symbols.declare(declName);
+            if (slot < 0){
+                printf("Error: Variable has already been declared.'%s'\n", symbolName(declName)); 
                 return false;
             }
-            else{
-                curr_table.push_back(declName);
-            }
+            node->stmt.decl.slot = slot;
         }
     }
 
-    // if the node is a variable node, check if it appears in one of the symbol tables on the stack. 
-    // If it does not, then emit an error message with name of the variable.
+    // if the node is a variable node, check if it is declared in any open scope and bind it
+    // to that declaration's slot. If it does not, then emit an error message with name of the variable.
     if(node->type == ast_var) {
-        char* varName = node->var.name;
+        symbolId varName = node->var.name;
         // checking to make sure variable name isn't null
-        if(varName == NULL){
+        if(varName == SYM_NONE){
             fprintf(stderr, "varName is null\n");
             return false;
         }
-        bool ifFound = false;  // bool to keep track of whether or not variable name has beem foumd
-        stack<SymbolTable> curr_stack = symbolTableStack;  //initializing empty stack and copying current stack to it
-        while(!curr_stack.empty()) {
-            SymbolTable& tempTable = curr_stack.top();
-            // iterating through every symbol table in stack
-            if(std::find(tempTable.begin(), tempTable.end(), varName) != tempTable.end()) {
-                ifFound = true;
-                break;
-            }
-            curr_stack.pop();
-        }
-        if (!ifFound) {
-            printf("Error: Variable has not been declared. '%s'\n", varName);
+        int32_t slot = symbols.lookup(varName);
+        if (slot < 0) {
+            printf("Error: Variable has not been declared. '%s'\n", symbolName(varName));
             return false;
         }
+        node->var.slot = slot;
     }
 
     //for all other node types, visit all the child nodes of the current node
@@ -148,48 +147,109 @@ bool visitNode(astNode* node, stack<SymbolTable>& symbolTableStack){
             // program nodes
         if (node->type == ast_prog) {
             // children
-            visitNode(node->prog.ext1, symbolTableStack);
-            visitNode(node->prog.ext2, symbolTableStack);
-            visitNode(node->prog.func, symbolTableStack);
+            ok = visitNode(node->prog.ext1, symbols) && ok;
+            ok = visitNode(node->prog.ext2, symbols) && ok;
+            ok = visitNode(node->prog.func, symbols) && ok;
         }
         // statement nodes
         else if (node->type == ast_stmt) {
             switch (node->stmt.type) {
                 case ast_call:
-                    visitNode(node->stmt.call.param, symbolTableStack);
+                    // read() has no parameter
+                    if (node->stmt.call.param != NULL) {
+                        ok = visitNode(node->stmt.call.param, symbols) && ok;
+                    }
                     break;
                 case ast_ret:
-                    visitNode(node->stmt.ret.expr, symbolTableStack);
+                    // a bare return has no expression
+                    if (node->stmt.ret.expr != NULL) {
+                        ok = visitNode(node->stmt.ret.expr, symbols) && ok;
+                    }
                     break;
                 case ast_while:
-                    visitNode(node->stmt.whilen.cond, symbolTableStack);
-                    visitNode(node->stmt.whilen.body, symbolTableStack);
+                    ok = visitNode(node->stmt.whilen.cond, symbols) && ok;
+                    ok = visitNode(node->stmt.whilen.body, symbols) && ok;
                     break;
                 case ast_if:
-                    visitNode(node->stmt.ifn.cond, symbolTableStack);
-                    visitNode(node->stmt.ifn.if_body, symbolTableStack);
+                    ok = visitNode(node->stmt.ifn.cond, symbols) && ok;
+                    ok = visitNode(node->stmt.ifn.if_body, symbols) && ok;
                     if (node->stmt.ifn.else_body != NULL) {
-                        visitNode(node->stmt.ifn.else_body, symbolTableStack);
+                        ok = visitNode(node->stmt.ifn.else_body, symbols) && ok;
                     }
                     break;
                 case ast_asgn:
-                    visitNode(node->stmt.asgn.rhs, symbolTableStack);
-                    visitNode(node->stmt.asgn.lhs, symbolTableStack);
+                    ok = visitNode(node->stmt.asgn.rhs, symbols) && ok;
+                    ok = visitNode(node->stmt.asgn.lhs, symbols) && ok;
+                    break;
+                default:
                     break;
             }
         }
         // expr nodes
         else if (node->type == ast_rexpr) {
-            visitNode(node->rexpr.lhs, symbolTableStack);
-            visitNode(node->rexpr.rhs, symbolTableStack);
+            ok = visitNode(node->rexpr.lhs, symbols) && ok;
+            ok = visitNode(node->rexpr.rhs, symbols) && ok;
         }
         else if (node->type == ast_bexpr) {
-            visitNode(node->bexpr.lhs, symbolTableStack);
-            visitNode(node->bexpr.rhs, symbolTableStack);
+            ok = visitNode(node->bexpr.lhs, symbols) && ok;
+            ok = visitNode(node->bexpr.rhs, symbols) && ok;
         }
         else if (node->type == ast_uexpr) {
-            visitNode(node->uexpr.expr, symbolTableStack);
+            ok = visitNode(node->uexpr.expr, symbols) && ok;
+        }
+    }
+    return ok;
+}
+
+bool visitCompactAst(compactAst& ast){
+    // Each open scope remembers the node index where its block ends
+    ScopedSymbolTable symbols;
+    vector<nodeIndex> scopeEnds;
+    nodeIndex funcBody = NO_NODE;
+    bool success = true;
+
+    for (nodeIndex i = 0; i < compactSize(ast); i++) {
+        // leaving the index range of a block closes its scope
+        while (!scopeEnds.empty() && i >= scopeEnds.back()) {
+            symbols.exitScope();
+            scopeEnds.pop_back();
+        }
+
+        // function: open a scope holding the parameter; the body block shares it
+        if (ast.kind[i] == ast_func) {
+            symbols.startFunction();
+            symbols.enterScope();
+            scopeEnds.push_back(ast.end[i]);
+            funcBody = ast.c[i];
+            if (ast.b[i] != NO_NODE) {
+                nodeIndex param = ast.b[i];
+                ast.b[param] = symbols.declare(ast.a[param]);
+                i = param;  // skip the parameter's var node, it is a declaration not a use
+            }
+        }
+        // block statement: open a new scope until the end of its subtree
+        else if (isCompactStmt(ast, i, ast_block) && i != funcBody) {
+            symbols.enterScope();
+            scopeEnds.push_back(ast.end[i]);
+        }
+        // declaration: the innermost scope may not declare the name already
+        else if (isCompactStmt(ast, i, ast_decl)) {
+            int32_t slot = symbols.declare(ast.a[i]);
+            if (slot < 0) {
+                printf("Error: Variable has already been declared.'%s'\n", symbolName(ast.a[i]));
+                success = false;
+            }
+            ast.b[i] = (uint32_t)slot;
+        }
+        // variable use: must be declared in some open scope
+        else if (ast.kind[i] == ast_var) {
+            int32_t slot = symbols.lookup(ast.a[i]);
+            if (slot < 0) {
+                printf("Error: Variable has not been declared. '%s'\n", symbolName(ast.a[i]));
+                success = false;
+            }
+            ast.b[i] = (uint32_t)slot;
         }
     }
-    return true;
+    return success;
 }
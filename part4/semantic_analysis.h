@@ -10,28 +10,77 @@
 
 #include <string>
 #include <vector>
-#include <stack>
 #include "ast.h"
+#include "compact_ast.h"
 
-//using SymbolTable = vector<astNode*>;
-
-//using SymbolTable = vector<std::string>;
 /*
-* C++ STL vector used as the primary data structure to store symbols. 
+* Scoped symbol table. Each interned name maps (by symbol ID, so the "hash"
+* is a direct index) to the head of a chain of its bindings, innermost first.
+* The bindings vector doubles as an undo log: leaving a scope pops the
+* bindings made in it and restores the chains they shadowed. Declaring and
+* looking up a name are O(1) no matter how deeply scopes are nested, and
+* nothing is copied on lookup.
+*
+* Every declaration also gets a slot: a dense number, unique within the
+* current function, that the IR builder uses to index its variable storage.
 */
-using SymbolTable = vector<std::string>;
+class ScopedSymbolTable {
+public:
+    // Restarts slot numbering for a new function
+    void startFunction() { nextSlot = 0; }
+
+    void enterScope();
+    void exitScope();
+
+    // Adds name to the innermost scope and returns its new slot,
+    // or -1 if the name is already declared in that scope
+    int32_t declare(symbolId name);
+
+    // Slot of the innermost visible declaration of name, or -1 if it is not declared
+    int32_t lookup(symbolId name) const;
+
+    // Number of open scopes
+    size_t depth() const { return scopeMarks.size(); }
+
+    // Number of slots handed out in the current function
+    uint32_t slotCount() const { return nextSlot; }
+
+private:
+    struct binding {
+        symbolId name;
+        uint32_t depth;     // scope the binding was made in
+        int32_t shadowed;   // previous binding of the same name, or -1
+        uint32_t slot;
+    };
+    std::vector<int32_t> innermost;    // per symbol ID: index into bindings, or -1
+    std::vector<binding> bindings;     // every live binding, in declaration order
+    std::vector<size_t> scopeMarks;    // bindings.size() when each open scope was entered
+    uint32_t nextSlot = 0;
+};
 
 /**
  * 
  * This function traverses the AST nodes and performs semantic analysis. It helps to check 
  * to ensure that variables are declared before they are used and there is only one 
- * declaration of a variable in any given scope. 
+ * declaration of a variable in any given scope. In the same pass it resolves names:
+ * every decl and var node gets the slot of its declaration, and every func node the
+ * number of slots it needs.
  *
  * @param node Pointer to the current AST node being visited.
- * @param symbolTableStack Reference to the stack of symbol tables.
+ * @param symbols Reference to the scoped symbol table.
  * returns: boolean that is true if function runs successfully 
  */
-bool visitNode(astNode* node, stack<SymbolTable>& symbolTableStack);
+bool visitNode(astNode* node, ScopedSymbolTable& symbols);
+
+/**
+ *
+ * Same checks and name resolution as visitNode, done over the compact AST. Nodes are in preorder, so this is a
+ * single linear sweep over the node arrays instead of a recursive walk.
+ *
+ * @param ast The compact AST of the whole program.
+ * returns: boolean that is true if no semantic errors were found
+ */
+bool visitCompactAst(compactAst& ast);
 
 
 #endif
\ No newline at end of file
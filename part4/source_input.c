@@ -0,0 +1,118 @@
+/*
+*   Purpose: This file loads the miniC source for the lexer. Regular files are memory mapped so that
+*   flex can scan them in place with yy_scan_buffer instead of copying them through yyin with fread.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#include "source_input.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Reads everything from fd into a malloc'd buffer with two trailing NULs (used for pipes)
+static bool readSourceBuffer(int fd, sourceBuffer* src) {
+    size_t capacity = 4096;
+    size_t length = 0;
+    char* base = (char*)malloc(capacity);
+    if (base == NULL) {
+        return false;
+    }
+    while (true) {
+        if (capacity - length < 2) {
+            capacity *= 2;
+            char* grown = (char*)realloc(base, capacity);
+            if (grown == NULL) {
+                free(base);
+                return false;
+            }
+            base = grown;
+        }
+        ssize_t n = read(fd, base + length, capacity - length - 2);
+        if (n < 0) {
+            free(base);
+            return false;
+        }
+        if (n == 0) {
+            break;
+        }
+        length += n;
+    }
+    base[length] = '\0';
+    base[length + 1] = '\0';
+
+    src->base = base;
+    src->length = length;
+    src->mapped = 0;
+    return true;
+}
+
+// Maps a regular file so that it is followed by at least two zero bytes
+static bool mapSourceBuffer(int fd, size_t length, sourceBuffer* src) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t mapped = (length + 2 + page - 1) & ~(page - 1);
+
+    // Reserve a zero-filled region big enough for the file plus the NULs, then map
+    // the file over the start of it. The tail of the last file page is zero-filled
+    // by the kernel and anything past it is still the anonymous zero mapping.
+    // Pages are private and writable because flex temporarily NUL-terminates yytext.
+    void* base = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        return false;
+    }
+    if (length > 0) {
+        void* file = mmap(base, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0);
+        if (file == MAP_FAILED) {
+            munmap(base, mapped);
+            return false;
+        }
+        madvise(base, length, MADV_SEQUENTIAL);
+    }
+
+    src->base = (char*)base;
+    src->length = length;
+    src->mapped = mapped;
+    return true;
+}
+
+bool openSourceBuffer(const char* path, sourceBuffer* src) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "File open error\n");
+        return false;
+    }
+
+    struct stat st;
+    bool loaded = false;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        loaded = mapSourceBuffer(fd, (size_t)st.st_size, src);
+    }
+    // Fall back to reading for pipes and for files that could not be mapped
+    if (!loaded) {
+        loaded = readSourceBuffer(fd, src);
+    }
+    close(fd);
+
+    if (!loaded) {
+        fprintf(stderr, "Failed to load source file %s\n", path);
+    }
+    return loaded;
+}
+
+void closeSourceBuffer(sourceBuffer* src) {
+    if (src->base == NULL) {
+        return;
+    }
+    if (src->mapped != 0) {
+        munmap(src->base, src->mapped);
+    } else {
+        free(src->base);
+    }
+    src->base = NULL;
+    src->length = 0;
+    src->mapped = 0;
+}
@@ -0,0 +1,36 @@
+/*
+*   Purpose: This is the .h file for loading the miniC source file that the lexer scans.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#ifndef SOURCE_INPUT_H
+#define SOURCE_INPUT_H
+
+#include <cstddef>
+
+/*
+* The whole source file in memory, followed by the two NUL bytes flex needs
+* to scan a buffer in place. Regular files are mmap'd; anything else (pipes,
+* character devices) is read into a heap buffer.
+*/
+typedef struct {
+    char* base;     // start of the source text
+    size_t length;  // number of source bytes, not counting the two NULs
+    size_t mapped;  // size of the mapping, 0 if base was malloc'd
+} sourceBuffer;
+
+// Loads the file at path into src. Returns false and prints an error on failure.
+bool openSourceBuffer(const char* path, sourceBuffer* src);
+
+// Releases the memory behind src. Identifier views into it are invalid afterwards.
+void closeSourceBuffer(sourceBuffer* src);
+
+/*
+* Implemented in lex.l. Creates a scanner (release it with yylex_destroy) and
+* points it at src without copying, so the ID views handed to the parser stay
+* valid for as long as src is open.
+*/
+bool scanSourceBuffer(sourceBuffer* src, void** scanner);
+
+#endif // SOURCE_INPUT_H
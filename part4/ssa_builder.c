@@ -0,0 +1,225 @@
+/*
+*   Purpose: This file keeps the local variables of the function being lowered by the llvm builder.
+*   SSA mode follows Braun et al., "Simple and Efficient Construction of Static Single Assignment Form":
+*   each slot remembers its current value per basic block, a read in a block without a local definition
+*   looks through the predecessors, and a phi is created where they meet. Blocks whose predecessors are
+*   not all known yet (loop headers) get incomplete phis that are filled in when the block is sealed.
+*   Phis that end up merging a single value are replaced by that value.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#include <stdio.h>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+#include "ssa_builder.h"
+
+static LLVMValueRef readVariable(localVars& vars, uint32_t slot, LLVMBasicBlockRef bb);
+
+void beginLocals(localVars& vars, LLVMValueRef func, uint32_t num_slots, bool ssa) {
+    LLVMContextRef llvm = LLVMGetModuleContext(LLVMGetGlobalParent(func));
+    vars.ssa_mode = ssa;
+    vars.int32Type = LLVMInt32TypeInContext(llvm);
+    vars.entry_bb = LLVMGetEntryBasicBlock(func);
+    vars.slot_names.assign(num_slots, "");
+    vars.slot_allocas.assign(num_slots, NULL);
+    vars.last_alloca = NULL;
+    vars.current_def.assign(num_slots, std::unordered_map<LLVMBasicBlockRef, LLVMValueRef>());
+    if (vars.phi_builder == NULL) {
+        vars.phi_builder = LLVMCreateBuilderInContext(llvm);
+    }
+}
+
+void declareLocal(localVars& vars, uint32_t slot, const char* name) {
+    vars.slot_names[slot] = name;
+    if (vars.ssa_mode) {
+        return;  // a slot that is read before it is written is undef
+    }
+
+    // Put the alloca right after the previous one so all of them stay at the top of the entry block
+    LLVMBuilderRef allocBuilder = LLVMCreateBuilderInContext(LLVMGetTypeContext(vars.int32Type));
+    LLVMValueRef before = vars.last_alloca ? LLVMGetNextInstruction(vars.last_alloca) : LLVMGetFirstInstruction(vars.entry_bb);
+    if (before != NULL) {
+        LLVMPositionBuilderBefore(allocBuilder, before);
+    } else {
+        LLVMPositionBuilderAtEnd(allocBuilder, vars.entry_bb);
+    }
+    vars.slot_allocas[slot] = LLVMBuildAlloca(allocBuilder, vars.int32Type, name);
+    vars.last_alloca = vars.slot_allocas[slot];
+    LLVMDisposeBuilder(allocBuilder);
+}
+
+// Follows the chain of trivial phis that were replaced to the value that is left
+static LLVMValueRef resolve(localVars& vars, LLVMValueRef value) {
+    auto it = vars.replaced_phis.find(value);
+    while (it != vars.replaced_phis.end()) {
+        value = it->second;
+        it = vars.replaced_phis.find(value);
+    }
+    return value;
+}
+
+// Function to create an empty phi for slot at the top of bb
+static LLVMValueRef newPhi(localVars& vars, uint32_t slot, LLVMBasicBlockRef bb) {
+    LLVMValueRef first = LLVMGetFirstInstruction(bb);
+    if (first != NULL) {
+        LLVMPositionBuilderBefore(vars.phi_builder, first);
+    } else {
+        LLVMPositionBuilderAtEnd(vars.phi_builder, bb);
+    }
+    return LLVMBuildPhi(vars.phi_builder, vars.int32Type, vars.slot_names[slot].c_str());
+}
+
+// If phi only merges one value (besides itself) replace it with that value. Returns what is left.
+static LLVMValueRef tryRemoveTrivialPhi(localVars& vars, LLVMValueRef phi) {
+    LLVMValueRef same = NULL;
+    for (unsigned i = 0; i < LLVMCountIncoming(phi); i++) {
+        LLVMValueRef op = resolve(vars, LLVMGetIncomingValue(phi, i));
+        if (op == same || op == phi) {
+            continue;
+        }
+        if (same != NULL) {
+            return phi;  // merges at least two values
+        }
+        same = op;
+    }
+    if (same == NULL) {
+        same = LLVMGetUndef(vars.int32Type);  // unreachable or read before any write
+    }
+
+    // Remember the phis using this one, they may become trivial too
+    std::vector<LLVMValueRef> phiUsers;
+    for (LLVMUseRef use = LLVMGetFirstUse(phi); use; use = LLVMGetNextUse(use)) {
+        LLVMValueRef user = LLVMGetUser(use);
+        if (user != phi && LLVMIsAPHINode(user) && vars.replaced_phis.find(user) == vars.replaced_phis.end()) {
+            phiUsers.push_back(user);
+        }
+    }
+
+    // The phi itself is erased in endLocals, values read before now may still refer to it
+    LLVMReplaceAllUsesWith(phi, same);
+    vars.replaced_phis[phi] = same;
+
+    for (LLVMValueRef user : phiUsers) {
+        if (vars.replaced_phis.find(user) == vars.replaced_phis.end()) {
+            tryRemoveTrivialPhi(vars, user);
+        }
+    }
+    return resolve(vars, same);
+}
+
+// Function to give phi one incoming value per predecessor of its block
+static LLVMValueRef addPhiOperands(localVars& vars, uint32_t slot, LLVMValueRef phi) {
+    LLVMBasicBlockRef bb = LLVMGetInstructionParent(phi);
+    for (LLVMBasicBlockRef pred : vars.block_preds[bb]) {
+        LLVMValueRef value = readVariable(vars, slot, pred);
+        LLVMAddIncoming(phi, &value, &pred, 1);
+    }
+    return tryRemoveTrivialPhi(vars, phi);
+}
+
+static void writeVariable(localVars& vars, uint32_t slot, LLVMBasicBlockRef bb, LLVMValueRef value) {
+    vars.current_def[slot][bb] = value;
+}
+
+// Value of slot at the top of bb, which has no definition of it yet
+static LLVMValueRef readVariableRecursive(localVars& vars, uint32_t slot, LLVMBasicBlockRef bb) {
+    LLVMValueRef value;
+    const std::vector<LLVMBasicBlockRef>& preds = vars.block_preds[bb];
+    if (vars.sealed_blocks.find(bb) == vars.sealed_blocks.end()) {
+        // more predecessors may still come: leave the phi empty until bb is sealed
+        value = newPhi(vars, slot, bb);
+        vars.incomplete_phis[bb].push_back({slot, value});
+    } else if (preds.empty()) {
+        value = LLVMGetUndef(vars.int32Type);
+    } else if (preds.size() == 1) {
+        value = readVariable(vars, slot, preds[0]);
+    } else {
+        // record the phi first so a loop back to bb finds it instead of recursing forever
+        LLVMValueRef phi = newPhi(vars, slot, bb);
+        writeVariable(vars, slot, bb, phi);
+        value = addPhiOperands(vars, slot, phi);
+    }
+    writeVariable(vars, slot, bb, value);
+    return value;
+}
+
+static LLVMValueRef readVariable(localVars& vars, uint32_t slot, LLVMBasicBlockRef bb) {
+    auto it = vars.current_def[slot].find(bb);
+    if (it != vars.current_def[slot].end()) {
+        return resolve(vars, it->second);
+    }
+    return readVariableRecursive(vars, slot, bb);
+}
+
+LLVMValueRef readLocal(localVars& vars, LLVMBuilderRef builder, uint32_t slot) {
+    if (!vars.ssa_mode) {
+        return LLVMBuildLoad2(builder, vars.int32Type, vars.slot_allocas[slot], "");
+    }
+    return readVariable(vars, slot, LLVMGetInsertBlock(builder));
+}
+
+void writeLocal(localVars& vars, LLVMBuilderRef builder, uint32_t slot, LLVMValueRef value) {
+    if (!vars.ssa_mode) {
+        LLVMBuildStore(builder, value, vars.slot_allocas[slot]);
+        return;
+    }
+    writeVariable(vars, slot, LLVMGetInsertBlock(builder), value);
+}
+
+void branchTo(localVars& vars, LLVMBuilderRef builder, LLVMBasicBlockRef target) {
+    vars.block_preds[target].push_back(LLVMGetInsertBlock(builder));
+    LLVMBuildBr(builder, target);
+}
+
+void condBranchTo(localVars& vars, LLVMBuilderRef builder, LLVMValueRef cond, LLVMBasicBlockRef trueBB, LLVMBasicBlockRef falseBB) {
+    LLVMBasicBlockRef from = LLVMGetInsertBlock(builder);
+    vars.block_preds[trueBB].push_back(from);
+    vars.block_preds[falseBB].push_back(from);
+    LLVMBuildCondBr(builder, cond, trueBB, falseBB);
+}
+
+void sealBlock(localVars& vars, LLVMBasicBlockRef bb) {
+    if (vars.ssa_mode) {
+        auto it = vars.incomplete_phis.find(bb);
+        if (it != vars.incomplete_phis.end()) {
+            std::vector<std::pair<uint32_t, LLVMValueRef>> phis = std::move(it->second);
+            vars.incomplete_phis.erase(it);
+            for (auto& p : phis) {
+                addPhiOperands(vars, p.first, p.second);
+            }
+        }
+    }
+    vars.sealed_blocks.insert(bb);
+}
+
+void endLocals(localVars& vars) {
+    // Point any use made after a phi was found trivial at its final value, then drop the phis
+    for (auto& r : vars.replaced_phis) {
+        LLVMReplaceAllUsesWith(r.first, resolve(vars, r.first));
+    }
+    for (auto& r : vars.replaced_phis) {
+        LLVMInstructionEraseFromParent(r.first);
+    }
+    if (!vars.incomplete_phis.empty()) {
+        fprintf(stderr, "Warning: %zu blocks were never sealed\n", vars.incomplete_phis.size());
+    }
+
+    vars.slot_names.clear();
+    vars.slot_allocas.clear();
+    vars.current_def.clear();
+    vars.block_preds.clear();
+    vars.sealed_blocks.clear();
+    vars.incomplete_phis.clear();
+    vars.replaced_phis.clear();
+}
+
+void disposeLocals(localVars& vars) {
+    endLocals(vars);
+    if (vars.phi_builder != NULL) {
+        LLVMDisposeBuilder(vars.phi_builder);
+        vars.phi_builder = NULL;
+    }
+}
@@ -0,0 +1,68 @@
+/*
+*   Purpose: This is the .h file for the local variables of the function being lowered by the llvm builder.
+*   In memory mode every variable slot is an alloca that is read with a load and written with a store.
+*   In SSA mode the current value of each slot is tracked per basic block and phi nodes are inserted
+*   on the fly, so locals never touch memory.
+*   Author: Carly Retterer
+*   Date: 30 May 2024
+*/
+
+#ifndef SSA_BUILDER_H
+#define SSA_BUILDER_H
+
+#include <llvm-c/Core.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+// State of the function being lowered. Each compilation has its own, see compilation_context.h.
+typedef struct {
+    bool ssa_mode;
+    LLVMTypeRef int32Type;
+    LLVMBasicBlockRef entry_bb;
+    std::vector<std::string> slot_names;
+
+    // Memory mode: one alloca per slot, kept together at the top of the entry block
+    std::vector<LLVMValueRef> slot_allocas;
+    LLVMValueRef last_alloca;
+
+    // SSA mode
+    std::vector<std::unordered_map<LLVMBasicBlockRef, LLVMValueRef>> current_def;   // per slot: block -> value
+    std::unordered_map<LLVMBasicBlockRef, std::vector<LLVMBasicBlockRef>> block_preds;
+    std::unordered_set<LLVMBasicBlockRef> sealed_blocks;
+    std::unordered_map<LLVMBasicBlockRef, std::vector<std::pair<uint32_t, LLVMValueRef>>> incomplete_phis;
+    std::unordered_map<LLVMValueRef, LLVMValueRef> replaced_phis;                  // trivial phi -> its value
+    LLVMBuilderRef phi_builder;
+} localVars;
+
+// Starts a new function with num_slots variable slots. func must already have its entry block.
+void beginLocals(localVars& vars, LLVMValueRef func, uint32_t num_slots, bool ssa);
+
+// Makes slot usable: an alloca in the entry block in memory mode, just a name for its phis in SSA mode
+void declareLocal(localVars& vars, uint32_t slot, const char* name);
+
+// Current value of slot at the builder's insertion point
+LLVMValueRef readLocal(localVars& vars, LLVMBuilderRef builder, uint32_t slot);
+
+// Makes value the current value of slot at the builder's insertion point
+void writeLocal(localVars& vars, LLVMBuilderRef builder, uint32_t slot, LLVMValueRef value);
+
+/*
+* All control flow of the function has to go through these two so the
+* predecessors of every block are known while the IR is still being built.
+*/
+void branchTo(localVars& vars, LLVMBuilderRef builder, LLVMBasicBlockRef target);
+void condBranchTo(localVars& vars, LLVMBuilderRef builder, LLVMValueRef cond, LLVMBasicBlockRef trueBB, LLVMBasicBlockRef falseBB);
+
+// Tells the builder bb will get no more predecessors; completes the phis that were waiting on it
+void sealBlock(localVars& vars, LLVMBasicBlockRef bb);
+
+// Finishes the function: removes the phis that turned out to be trivial and clears all state
+void endLocals(localVars& vars);
+
+// Releases what the state holds across functions
+void disposeLocals(localVars& vars);
+
+#endif // SSA_BUILDER_H
@@ -0,0 +1,28 @@
+extern void print(int);
+extern int read();
+
+int func(int n){
+	int d;
+	int i;
+	int j;
+	int k;
+
+	d = 0;
+	i = 0;
+	while (i < n){
+		d = d + i;
+		if (d > 50){
+			d = d - 50;
+		}
+		i = i + 1;
+	}
+	j = 0;
+	k = 2;
+	while (j < n){
+		k = k * 2;
+		print(j);
+		j = j + 3;
+	}
+
+	return n + 1;
+}
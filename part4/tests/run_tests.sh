@@ -0,0 +1,35 @@
+#!/bin/sh
+#
+#   Purpose: Regression tests for the optimizer and the backend. Every program in tests/ is compiled
+#   with each of the modes below, linked with runtime.c and run on each of the arguments below; what it
+#   prints must match tests/<name>.expected, and each run gets 10 seconds. The programs cover the loops
+#   scalar evolution deletes or rewrites the exit values of, and the branches and loops SCCP and
+#   aggressive dead code elimination remove.
+#   Usage: tests/run_tests.sh ./compiler (from part4)
+#   Author: Carly Retterer
+#   Date: 30 May 2024
+
+COMPILER=${1:-./compiler}
+ARGS="-5 0 1 7 10 37"
+failed=0
+
+for test in tests/*.c; do
+    for mode in "" "-ssa" "-ssa -regalloc=graph"; do
+        if ! $COMPILER $mode -o test_output.s $test > /dev/null || ! gcc -o program test_output.s runtime.c; then
+            echo "FAIL $test $mode: did not compile"
+            failed=1
+            continue
+        fi
+        for n in $ARGS; do
+            timeout 10 ./program $n
+        done > test_output.txt
+        if diff ${test%.c}.expected test_output.txt > /dev/null; then
+            echo "PASS $test $mode"
+        else
+            echo "FAIL $test $mode"
+            failed=1
+        fi
+    done
+done
+
+exit $failed
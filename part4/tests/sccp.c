@@ -0,0 +1,26 @@
+extern void print(int);
+extern int read();
+
+int func(int n){
+	int b;
+	int i;
+	int c;
+
+	b = 4;
+	i = 0;
+	c = b * 3;
+	while (i < n){
+		if (b > 10){
+			b = b + 1;
+		}
+		else {
+			c = c - 1;
+		}
+		i = i + 1;
+	}
+	if (c > b){
+		print(c);
+	}
+
+	return b;
+}
@@ -0,0 +1,20 @@
+extern void print(int);
+extern int read();
+
+int func(int n){
+	int a;
+	int i;
+
+	i = 0;
+	while (i < 10){
+		if (a > 3){
+			i = i + 1;
+		}
+		else {
+			i = i + 2;
+		}
+	}
+	print(i);
+
+	return i + n;
+}
@@ -0,0 +1,16 @@
+extern void print(int);
+extern int read();
+
+int func(int n){
+	int i;
+	int s;
+
+	i = n;
+	s = 7;
+	while (i >= 5){
+		i = i - 3;
+		s = s + 3;
+	}
+
+	return i - s;
+}
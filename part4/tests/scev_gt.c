@@ -0,0 +1,16 @@
+extern void print(int);
+extern int read();
+
+int func(int n){
+	int i;
+	int s;
+
+	i = n;
+	s = 100;
+	while (i > 0){
+		i = i - 4;
+		s = s - 1;
+	}
+
+	return i + s;
+}
@@ -0,0 +1,16 @@
+extern void print(int);
+extern int read();
+
+int func(int n){
+	int i;
+	int s;
+
+	i = 1;
+	s = 0;
+	while (i <= n){
+		i = i + 2;
+		s = s + 5;
+	}
+
+	return i * s;
+}
@@ -0,0 +1,16 @@
+extern void print(int);
+extern int read();
+
+int func(int n){
+	int i;
+	int s;
+
+	i = 0;
+	s = 3;
+	while (i < n){
+		i = i + 3;
+		s = s + 2;
+	}
+
+	return i + s;
+}
@@ -15,26 +15,35 @@
 #include <vector>
 #include <stack>
 #include "semantic_analysis.h"
-
-extern int yylex();
-extern int yylex_destroy();
-extern int yywrap();
-int yyerror(const char *);
-extern FILE * yyin;
-using SymbolTable = vector<std::string>;
-astNode* rootNode = NULL;
+#include "source_input.h"
 
 %}
 
+/* Reentrant parser: the scanner and the compilation the tree belongs to are passed in */
+%define api.pure full
+%lex-param {void *scanner}
+%parse-param {void *scanner} {CompilationContext *ctx}
+
+%code requires {
+#include "ast.h"
+#include "compilation_context.h"
+}
+
+%code {
+extern int yylex(YYSTYPE *yylval_param, void *scanner);
+extern int yylex_destroy(void *scanner);
+int yyerror(void *scanner, CompilationContext *ctx, const char *);
+}
+
 %union{
     int ival;
-    char *sname;
+    strView sview;
     astNode *nptr;
-    vector<astNode*> *svec_ptr;
+    stmtList *svec_ptr;
 }
 
 %token <ival> NUM
-%token <sname> ID
+%token <sview> ID
 %token PLUS MINUS MULT DIV INT
 %token EXTERN VOID IF ELSE WHILE RETURN READ PRINT
 %token EQ GT LT GTE LTE EQUALS
@@ -56,22 +65,19 @@ astNode* rootNode = NULL;
 func : INT ID '(' ')' block_stmt {
     $$ = createFunc($2, NULL, $5);
     if ($$ == NULL) {
-        yyerror("Failed to create function node due to memory allocation failure.");
+        yyerror(scanner, ctx, "Failed to create function node due to memory allocation failure.");
         YYABORT;
     }
     printf("non-parametric function created\n");
-    free($2);
 	}
 
      | INT ID '(' INT ID ')' block_stmt {
     $$ = createFunc($2, createVar($5), $7);
     if ($$ == NULL || $7 == NULL) {
-        yyerror("Failed to create function node with parameters due to memory allocation failure.");
+        yyerror(scanner, ctx, "Failed to create function node with parameters due to memory allocation failure.");
         YYABORT;
     }
     printf("Function with parameters created\n");
-    free($2);
-    free($5);
 }
 
 // program node : can be followed by extern read and extern print
@@ -80,11 +86,11 @@ prog : extern_list extern_list func {
     $$ = createProg($1, $2, $3);
     printf("createProg returned: %p\n", $$);  // Assuming $$ is a pointer
     if ($$ == NULL) {
-        yyerror("Failed to create program node due to memory allocation failure.");
+        yyerror(scanner, ctx, "Failed to create program node due to memory allocation failure.");
         YYABORT;
     }
-    rootNode = $$;
-    if (rootNode == NULL) {
+    ctx->rootNode = $$;
+    if (ctx->rootNode == NULL) {
         fprintf(stderr, "Error: rootNode wasn't initialized at the beginning\n");
     }
 }
@@ -95,28 +101,28 @@ extern_list : EXTERN VOID PRINT '(' INT ')' ';' {$$ = createExtern("print");}
 
 // block stmt code taken from ex given by Vasanta, with modifications for debugging purposes and errors checks
 block_stmt : '{' var_decls stmts '}' {
-    vector<astNode*>* new_vec = new (nothrow) vector<astNode*>();
+    stmtList* new_vec = newStmtList();
     if (!new_vec) {
-        yyerror("Failed to allocate memory for block statement.");
+        yyerror(scanner, ctx, "Failed to allocate memory for block statement.");
         YYABORT;
     }
     new_vec->insert(new_vec->end(), $2->begin(), $2->end());
     new_vec->insert(new_vec->end(), $3->begin(), $3->end());
     $$ = createBlock(new_vec);
     if ($$ == NULL) {
-        delete new_vec;  // Clean up vector if block creation fails
-        yyerror("Failed to create block node due to memory allocation failure.");
+        deleteStmtList(new_vec);  // Clean up vector if block creation fails
+        yyerror(scanner, ctx, "Failed to create block node due to memory allocation failure.");
         YYABORT;
     }
     printNode($$);
-    delete $2;
-    delete $3;
+    deleteStmtList($2);
+    deleteStmtList($3);
     printf("block created\n");
 }
             | '{' stmts '}' {
     $$ = createBlock($2);
     if ($$ == NULL) {
-        yyerror("Failed to create block node due to memory allocation failure.");
+        yyerror(scanner, ctx, "Failed to create block node due to memory allocation failure.");
         YYABORT;
     }
     printNode($$);
@@ -126,17 +132,16 @@ block_stmt : '{' var_decls stmts '}' {
 // var declarations, with code given by Vasanta
 var_decls	 : var_decls decl {$$ = $1;
 														 $$->push_back($2);}
-					 | decl {$$ = new vector<astNode*>();
+					 | decl {$$ = newStmtList();
 									 $$->push_back($1);}
 
 // decl nodes with debugging checks
 decl : INT ID ';' {
     $$ = createDecl($2);
     if ($$ == NULL) {
-        yyerror("Failed to create declaration node due to memory allocation failure.");
+        yyerror(scanner, ctx, "Failed to create declaration node due to memory allocation failure.");
         YYABORT;
     }
-    free($2);
 }
 
 // statement nodes with code given by Vasanta, modified for debugging purposes
@@ -145,9 +150,9 @@ stmts : stmts stmt {
     $$ = $1;
 }
        | stmt {
-    $$ = new (nothrow) vector<astNode*>();
+    $$ = newStmtList();
     if (!$$) {
-        yyerror("Failed to allocate memory for statements.");
+        yyerror(scanner, ctx, "Failed to allocate memory for statements.");
         YYABORT;
     }
     $$->push_back($1);
@@ -164,7 +169,7 @@ stmt 			: IF '(' cond_expr ')' stmt %prec THEN {$$ = createIf($3, $5);}
      				| RETURN '(' expr ')' ';' {$$ = createRet($3);}
                     | RETURN expr ';' {$$ = createRet($2);}
      				| block_stmt {$$ = $1;}
-     				| ID EQUALS expr ';' {astNode* tnptr = createVar($1); $$ = createAsgn(tnptr, $3); free($1);}
+     				| ID EQUALS expr ';' {astNode* tnptr = createVar($1); $$ = createAsgn(tnptr, $3);}
 					| print {$$ = $1;}
      				;
 
@@ -184,44 +189,52 @@ expr			 : term PLUS term {$$ = createBExpr($1, $3, add);}
                      ;
 
 term			 : NUM {$$ = createCnst($1);}
-					 | ID {$$ = createVar($1); free($1);}
+					 | ID {$$ = createVar($1);}
 					 | MINUS term {$$ = createUExpr($2, uminus);}
 
 %%
-int yyerror(const char *s){
+int yyerror(void *scanner, CompilationContext *ctx, const char *s){
 	fprintf(stderr,"%s\n", s);
 	return 0;
 }
+// Stand-alone driver that only parses and checks a file. The compiler's main is in main.cpp, so this one
+// is only built with -DPARSER_MAIN.
+#ifdef PARSER_MAIN
 int main(int argc, char* argv[]){
-    if (argc == 2){
-        yyin = fopen(argv[1], "r");
-        if (yyin == NULL) {
-            fprintf(stderr, "File open error\n");
-            return 1;
-        }
+    // everything the compile changes lives in the context
+    CompilationContext ctx;
+    CompilationScope scope(&ctx);
+
+    // identifiers are views into the source buffer, so stdin is loaded up front as well
+    sourceBuffer source = {};
+    void *scanner = NULL;
+    const char *path = (argc == 2) ? argv[1] : "/dev/stdin";
+    if (!openSourceBuffer(path, &source) || !scanSourceBuffer(&source, &scanner)) {
+        return 1;
     }
 
     #ifdef YYDEBUG
     //yydebug = 1;
     #endif
 
-    yyparse();
+    yyparse(scanner, &ctx);
 
-	if(rootNode == NULL){
+	if(ctx.rootNode == NULL){
 		fprintf(stderr, "Root node is null\n");
 	}
 
     // Call semantic analysis
-    // Initialize the stack of symbol tables to empty
-    stack<SymbolTable> symbolTableStack;
-	if(rootNode!=NULL){
-	    if (!visitNode(rootNode, symbolTableStack)){
+    // Start with no open scopes
+    ScopedSymbolTable symbols;
+	if(ctx.rootNode!=NULL){
+	    if (!visitNode(ctx.rootNode, symbols)){
             fprintf(stderr, "Error: semantic analysis failed!\n");
         }    
-        freeNode(rootNode);
+        freeNode(ctx.rootNode);
 	}    
 
-    if (argc == 2) fclose(yyin);
-    yylex_destroy();
+    yylex_destroy(scanner);
+    closeSourceBuffer(&source);
     return 0;
-}
\ No newline at end of file
+}
+#endif // PARSER_MAIN